@@ -0,0 +1,183 @@
+// Batch view benchmark
+//
+// Renders many small views from random poses over the built-in map in
+// RenderViews() batches, as a server generating views for agents would, and
+// reports views/sec, megapixels/sec and per-view times. A sample of the
+// views is rendered again one at a time with RenderFrame() and must come
+// out identical.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "raycasterEngine.hpp"
+#include "renderTarget.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    const double CAMERA_PLANE_LENGTH = 0.66;
+    const double PI = 3.14159265358979323846;
+    const int CHECKED_VIEWS = 16;
+
+    struct Options {
+        int views;
+        int width;
+        int height;
+        int batches;
+        int threads;
+        CastKernel kernel;
+    };
+
+    void PrintUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--views N] [--width N] [--height N] [--batches N] [--threads N]"
+                  << " [--kernel auto|scalar|sse2|avx2]" << std::endl;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+
+            if (!std::strcmp(argv[i], "--views") && hasValue) {
+                options.views = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--width") && hasValue) {
+                options.width = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--height") && hasValue) {
+                options.height = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--batches") && hasValue) {
+                options.batches = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+                options.threads = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--kernel") && hasValue) {
+                const char *name = argv[++i];
+                const CastKernel kernels[] = {CastKernel::AUTO, CastKernel::SCALAR, CastKernel::SSE2, CastKernel::AVX2};
+                bool found = false;
+
+                for (const CastKernel kernel : kernels) {
+                    if (!std::strcmp(name, GetCastKernelName(kernel))) {
+                        options.kernel = kernel;
+                        found = true;
+                    }
+                }
+
+                if (!found || !IsCastKernelSupported(options.kernel)) {
+                    std::cerr << "Unsupported cast kernel: " << name << std::endl;
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+
+        return options.views > 0 && options.width > 0 && options.height > 0 && options.batches > 0 && options.threads >= 0;
+    }
+
+    // Random pose in an open cell, the same ones on every run
+    CameraPose NextPose(const WorldMap &map, std::uint32_t &state)
+    {
+        while (true) {
+            state = state * 1664525u + 1013904223u;
+            const double x = ((state >> 8) % (map.GetColumns() * 16) + 0.5) / 16;
+            state = state * 1664525u + 1013904223u;
+            const double y = ((state >> 8) % (map.GetRows() * 16) + 0.5) / 16;
+            state = state * 1664525u + 1013904223u;
+            const double angle = (state >> 8) % 3600 * (PI / 1800);
+
+            if (!map.GetCell(static_cast<int>(x), static_cast<int>(y))) {
+                const Point<double> direction{std::cos(angle), std::sin(angle)};
+                return {{x, y}, direction, {direction.y * CAMERA_PLANE_LENGTH, -direction.x * CAMERA_PLANE_LENGTH}};
+            }
+        }
+    }
+
+    double Percentile(const std::vector<double> &sorted, const double percentile)
+    {
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+        return sorted[std::max<std::size_t>(rank, 1) - 1];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options{1024, 64, 48, 20, 1, CastKernel::AUTO};
+
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<RaycasterEngine> engine(new RaycasterEngine);
+    engine->InitHeadless();
+    engine->SetRenderThreadCount(options.threads);
+    engine->SetCastKernel(options.kernel);
+
+    std::vector<std::unique_ptr<MemoryRenderTarget>> targets;
+    std::vector<RaycasterEngine::BatchView> views;
+    std::uint32_t state{2024};
+
+    for (int i{0}; i < options.views; i++) {
+        targets.emplace_back(new MemoryRenderTarget(options.width, options.height));
+        views.push_back({NextPose(engine->GetWorldMap(), state), targets.back()->Lock(), 0});
+    }
+
+    // First batch warms up
+    engine->RenderViews(views);
+
+    double totalTime = 0;
+    std::vector<double> viewTimes;
+    viewTimes.reserve(static_cast<std::size_t>(options.views) * options.batches);
+
+    for (int batch{0}; batch < options.batches; batch++) {
+        const RaycasterEngine::BatchStats stats = engine->RenderViews(views);
+        totalTime += stats.milliseconds;
+
+        for (const RaycasterEngine::BatchView &view : views) {
+            viewTimes.push_back(view.milliseconds);
+        }
+    }
+
+    std::uint64_t combinedChecksum = 14695981039346656037ULL;
+    for (const std::unique_ptr<MemoryRenderTarget> &target : targets) {
+        combinedChecksum = (combinedChecksum ^ target->Checksum()) * 1099511628211ULL;
+    }
+
+    // Batched views must match views drawn on their own
+    int mismatches{0};
+    MemoryRenderTarget single(options.width, options.height);
+
+    for (int i{0}; i < std::min(CHECKED_VIEWS, options.views); i++) {
+        engine->SetPlayerPosition(views[i].pose.position);
+        engine->SetPlayerDirection(views[i].pose.direction);
+        engine->SetCameraPlane(views[i].pose.plane);
+        engine->RenderFrame(single);
+
+        mismatches += single.Checksum() != targets[i]->Checksum();
+    }
+
+    const int threadCount = engine->GetRenderThreadCount();
+    engine->Cleanup();
+
+    std::sort(viewTimes.begin(), viewTimes.end());
+    const double viewCount = static_cast<double>(options.views) * options.batches;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "resolution " << options.width << "x" << options.height << std::endl
+              << "threads " << threadCount << std::endl
+              << "views " << options.views << " x " << options.batches << " batches" << std::endl
+              << "views_per_sec " << viewCount / (totalTime / 1000.0) << std::endl
+              << "mpixels_per_sec " << viewCount * options.width * options.height / (totalTime * 1000.0) << std::endl
+              << "view_p50_ms " << Percentile(viewTimes, 50) << std::endl
+              << "view_p99_ms " << Percentile(viewTimes, 99) << std::endl
+              << "mismatches " << mismatches << std::endl
+              << "checksum " << std::hex << std::setw(16) << std::setfill('0') << combinedChecksum << std::dec << std::endl;
+
+    return mismatches ? 1 : 0;
+}
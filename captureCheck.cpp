@@ -0,0 +1,116 @@
+// Frame capture colour check
+//
+// Writes a Y4M capture of flat frames in black, white and the pure
+// primaries, which the untextured walls are drawn in, reads it back and
+// checks each plane against the BT.601 full range values JPEG gives those
+// colours. The fixed point conversion may be off by one, no more.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "frameCapture.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    // Even, so every chroma sample averages one colour
+    const int FRAME_SIDE = 4;
+
+    struct ColourCase {
+        const char *name;
+        unsigned int pixel;
+        int luma;
+        int blueChroma;
+        int redChroma;
+    };
+
+    const ColourCase COLOUR_CASES[] = {
+        {"black", 0x000000, 0, 128, 128},
+        {"white", 0xFFFFFF, 255, 128, 128},
+        {"red", 0xFF0000, 76, 85, 255},
+        {"green", 0x00FF00, 150, 44, 21},
+        {"blue", 0x0000FF, 29, 255, 107}
+    };
+
+    bool CheckPlane(const ColourCase &colourCase, const char *plane, const unsigned char *bytes,
+                    const int count, const int expected)
+    {
+        for (int i{0}; i < count; i++) {
+            if (std::abs(bytes[i] - expected) > 1) {
+                std::cerr << colourCase.name << " " << plane << " " << static_cast<int>(bytes[i])
+                          << ", expected " << expected << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string path = argc > 1 ? argv[1] : "captureCheck.y4m";
+    const int caseCount = sizeof(COLOUR_CASES) / sizeof(COLOUR_CASES[0]);
+    const int pixels = FRAME_SIDE * FRAME_SIDE;
+    const int chroma = pixels / 4;
+
+    CaptureSettings settings = DEFAULT_CAPTURE_SETTINGS;
+    settings.policy = CapturePolicy::BLOCK;
+
+    FrameCapture capture;
+    if (!capture.Open(path, FRAME_SIDE, FRAME_SIDE, settings)) {
+        std::cerr << "Error opening " << path << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned int> frame(pixels);
+    for (const ColourCase &colourCase : COLOUR_CASES) {
+        frame.assign(pixels, colourCase.pixel);
+        capture.Capture(FrameBuffer{frame.data(), FRAME_SIDE, FRAME_SIDE, FRAME_SIDE});
+    }
+
+    if (!capture.Close()) {
+        std::cerr << "Error writing " << path << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    const std::vector<unsigned char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    std::remove(path.c_str());
+
+    // Stream header line, then "FRAME\n" and the Y, Cb and Cr planes
+    std::size_t offset{0};
+    while (offset < bytes.size() && bytes[offset++] != '\n') {
+    }
+
+    const std::string frameHeader = "FRAME\n";
+    const std::size_t frameSize = frameHeader.size() + pixels + 2 * chroma;
+
+    if (bytes.size() != offset + caseCount * frameSize) {
+        std::cerr << "capture is " << bytes.size() << " bytes, expected " << offset + caseCount * frameSize << std::endl;
+        return 1;
+    }
+
+    int failures{0};
+    for (const ColourCase &colourCase : COLOUR_CASES) {
+        const unsigned char *luma = &bytes[offset + frameHeader.size()];
+
+        if (!CheckPlane(colourCase, "Y", luma, pixels, colourCase.luma) ||
+            !CheckPlane(colourCase, "Cb", luma + pixels, chroma, colourCase.blueChroma) ||
+            !CheckPlane(colourCase, "Cr", luma + pixels + chroma, chroma, colourCase.redChroma)) {
+            failures++;
+        }
+        offset += frameSize;
+    }
+
+    std::cout << "colours " << caseCount << std::endl
+              << "failures " << failures << std::endl;
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,522 @@
+#include "chunkedWorld.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace Raycaster;
+
+namespace
+{
+    const char CHUNK_FILE_MAGIC[4] = {'R', 'C', 'C', 'K'};
+    const std::uint32_t CHUNK_FILE_VERSION{1};
+    const std::size_t CHUNK_FILE_HEADER_SIZE{32};
+
+    // States of chunks that have no buffer: queued by Prefetch(), queued
+    // or loading after being drawn, and failed to load
+    const int CHUNK_PREFETCHED{-1};
+    const int CHUNK_WAITED{-2};
+    const int CHUNK_FAILED{-3};
+
+    std::uint32_t ReadUint32(const unsigned char *bytes) noexcept
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+    }
+
+    void WriteUint32(unsigned char *bytes, const std::uint32_t value) noexcept
+    {
+        for (int i{0}; i < 4; i++) {
+            bytes[i] = (value >> (i * 8)) & 0xFF;
+        }
+    }
+
+    std::uint32_t HashCell(const int x, const int y, const std::uint32_t seed) noexcept
+    {
+        std::uint32_t hash = static_cast<std::uint32_t>(x) * 0x9E3779B1u ^ static_cast<std::uint32_t>(y) * 0x85EBCA77u ^ seed;
+
+        hash ^= hash >> 16;
+        hash *= 0x7FEB352Du;
+        hash ^= hash >> 15;
+        hash *= 0x846CA68Bu;
+        hash ^= hash >> 16;
+
+        return hash;
+    }
+}
+
+bool GeneratedChunkSource::LoadChunk(const int chunkX, const int chunkY, std::uint8_t *cells)
+{
+    for (int i{0}; i < CHUNK_SIZE; i++) {
+        const int x = (chunkX << CHUNK_SHIFT) + i;
+
+        for (int j{0}; j < CHUNK_SIZE; j++) {
+            const int y = (chunkY << CHUNK_SHIFT) + j;
+            std::uint8_t cell{0};
+
+            // Pillars of 2x2 cells on a few blocks
+            const std::uint32_t block = HashCell(x >> 1, y >> 1, m_seed);
+            if ((block & 0xFF) < 12) {
+                cell = 1 + (block >> 8) % 4;
+            }
+
+            // Walls eight cells long along every 32nd line, a quarter of
+            // them present
+            if ((x & 31) == 0 && (HashCell(x >> 5, y >> 3, m_seed ^ 0x5A5A5A5Au) & 3) == 0) {
+                cell = 5;
+            }
+            if ((y & 31) == 0 && (HashCell(x >> 3, y >> 5, m_seed ^ 0xA5A5A5A5u) & 3) == 0) {
+                cell = 6;
+            }
+
+            cells[i * CHUNK_SIZE + j] = cell;
+        }
+    }
+
+    return true;
+}
+
+bool ChunkFile::Open(const std::string &path)
+{
+    m_file.close();
+    m_file.clear();
+    m_file.open(path, std::ios::binary);
+
+    unsigned char header[CHUNK_FILE_HEADER_SIZE];
+
+    if (!m_file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        std::memcmp(header, CHUNK_FILE_MAGIC, sizeof(CHUNK_FILE_MAGIC)) || ReadUint32(header + 4) != CHUNK_FILE_VERSION ||
+        ReadUint32(header + 16) != static_cast<std::uint32_t>(CHUNK_SIZE)) {
+        m_file.close();
+        return false;
+    }
+
+    const std::uint32_t columns = ReadUint32(header + 8);
+    const std::uint32_t rows = ReadUint32(header + 12);
+
+    if (columns < 1 || rows < 1 || columns > static_cast<std::uint32_t>(MAX_WORLD_SIDE) ||
+        rows > static_cast<std::uint32_t>(MAX_WORLD_SIDE)) {
+        m_file.close();
+        return false;
+    }
+
+    m_columns = columns;
+    m_rows = rows;
+
+    return true;
+}
+
+bool ChunkFile::LoadChunk(const int chunkX, const int chunkY, std::uint8_t *cells)
+{
+    const int chunkColumns = (m_columns + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    const int chunkRows = (m_rows + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+
+    if (!m_file.is_open() || chunkX < 0 || chunkY < 0 || chunkX >= chunkColumns || chunkY >= chunkRows) {
+        return false;
+    }
+
+    const std::uint64_t chunk = static_cast<std::uint64_t>(chunkX) * chunkRows + chunkY;
+
+    m_file.clear();
+    m_file.seekg(CHUNK_FILE_HEADER_SIZE + chunk * CHUNK_CELLS);
+
+    return static_cast<bool>(m_file.read(reinterpret_cast<char*>(cells), CHUNK_CELLS));
+}
+
+bool ChunkFile::Write(const std::string &path, const int columns, const int rows, ChunkSource &source)
+{
+    if (columns < 1 || rows < 1 || columns > MAX_WORLD_SIDE || rows > MAX_WORLD_SIDE) {
+        return false;
+    }
+
+    unsigned char header[CHUNK_FILE_HEADER_SIZE] = {};
+    std::memcpy(header, CHUNK_FILE_MAGIC, sizeof(CHUNK_FILE_MAGIC));
+    WriteUint32(header + 4, CHUNK_FILE_VERSION);
+    WriteUint32(header + 8, columns);
+    WriteUint32(header + 12, rows);
+    WriteUint32(header + 16, CHUNK_SIZE);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    const int chunkColumns = (columns + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    const int chunkRows = (rows + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    std::uint8_t cells[CHUNK_CELLS];
+
+    for (int chunkX{0}; chunkX < chunkColumns && file; chunkX++) {
+        for (int chunkY{0}; chunkY < chunkRows && file; chunkY++) {
+            if (!source.LoadChunk(chunkX, chunkY, cells)) {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(cells), CHUNK_CELLS);
+        }
+    }
+
+    return static_cast<bool>(file);
+}
+
+ChunkedWorld::ChunkedWorld(std::unique_ptr<ChunkSource> source, const int columns, const int rows, const std::size_t budgetBytes) :
+    m_source{std::move(source)},
+    m_columns{std::max(1, std::min(columns, MAX_WORLD_SIDE))},
+    m_rows{std::max(1, std::min(rows, MAX_WORLD_SIDE))},
+    m_chunkColumns{(m_columns + CHUNK_SIZE - 1) >> CHUNK_SHIFT},
+    m_chunkRows{(m_rows + CHUNK_SIZE - 1) >> CHUNK_SHIFT},
+    m_regionRows{(m_chunkRows + REGION_SIZE - 1) >> REGION_SHIFT},
+    m_maxBuffers{static_cast<int>(std::max<std::size_t>(1, std::min<std::size_t>(budgetBytes / sizeof(Chunk),
+                                                                                  static_cast<std::size_t>(m_chunkColumns) * m_chunkRows)))},
+    m_frame{0},
+    m_misses{0},
+    m_loads{0},
+    m_evictions{0},
+    m_stopping{false}
+{
+    std::memset(m_unloadedChunk.cells, UNLOADED_CELL, sizeof(m_unloadedChunk.cells));
+
+    for (auto &chunk : m_emptyRegion.chunks) {
+        chunk.store(&m_unloadedChunk);
+    }
+
+    const int regions = ((m_chunkColumns + REGION_SIZE - 1) >> REGION_SHIFT) * m_regionRows;
+    m_regions.reset(new std::atomic<Region*>[regions]);
+
+    for (int i{0}; i < regions; i++) {
+        m_regions[i].store(&m_emptyRegion);
+    }
+
+    m_loadThread = std::thread(&ChunkedWorld::LoadLoop, this);
+}
+
+ChunkedWorld::~ChunkedWorld()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_loaded.notify_all();
+
+    if (m_loadThread.joinable()) {
+        m_loadThread.join();
+    }
+}
+
+bool ChunkedWorld::IsResident(const int x, const int y) const noexcept
+{
+    if (static_cast<unsigned int>(x) >= static_cast<unsigned int>(m_columns) ||
+        static_cast<unsigned int>(y) >= static_cast<unsigned int>(m_rows)) {
+        return false;
+    }
+
+    return GetChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT) != &m_unloadedChunk;
+}
+
+void ChunkedWorld::CopyCells(const int x, const int y, const int columns, const int rows, std::uint8_t *cells, const int stride)
+{
+    // Chunks are only evicted under the lock, and a buffer is only refilled
+    // once evicted
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (int i{0}; i < columns; i++) {
+        for (int j{0}; j < rows; j++) {
+            cells[i * stride + j] = GetCell(x + i, y + j);
+        }
+    }
+}
+
+void ChunkedWorld::Use(const int minX, const int minY, const int maxX, const int maxY)
+{
+    const int firstX = std::max(0, minX) >> CHUNK_SHIFT;
+    const int firstY = std::max(0, minY) >> CHUNK_SHIFT;
+    const int lastX = std::min(m_columns - 1, maxX) >> CHUNK_SHIFT;
+    const int lastY = std::min(m_rows - 1, maxY) >> CHUNK_SHIFT;
+    bool queued{false};
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (int chunkX{firstX}; chunkX <= lastX; chunkX++) {
+            for (int chunkY{firstY}; chunkY <= lastY; chunkY++) {
+                const auto found = m_chunkBuffers.find(GetChunkKey(chunkX, chunkY));
+
+                if (found != m_chunkBuffers.end() && found->second >= 0) {
+                    m_buffers[found->second].lastUsed = m_frame;
+                } else if (found == m_chunkBuffers.end() || found->second == CHUNK_PREFETCHED) {
+                    Request(chunkX, chunkY, true);
+                    m_misses++;
+                    queued = true;
+                }
+            }
+        }
+    }
+
+    if (queued) {
+        m_wake.notify_one();
+    }
+}
+
+void ChunkedWorld::Prefetch(const Point<double> position, const Point<double> direction, const double distance)
+{
+    const double length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+    if (length <= 0.0 || distance <= 0.0) {
+        return;
+    }
+
+    const Point<double> forward{direction.x / length, direction.y / length};
+    // Half a chunk's diagonal, so chunks straddling the limits count
+    const double slack = CHUNK_SIZE * 0.7072;
+    const int firstX = std::max(0, static_cast<int>(std::floor((position.x - distance) / CHUNK_SIZE)));
+    const int firstY = std::max(0, static_cast<int>(std::floor((position.y - distance) / CHUNK_SIZE)));
+    const int lastX = std::min(m_chunkColumns - 1, static_cast<int>(std::floor((position.x + distance) / CHUNK_SIZE)));
+    const int lastY = std::min(m_chunkRows - 1, static_cast<int>(std::floor((position.y + distance) / CHUNK_SIZE)));
+
+    // Nearest first
+    std::vector<std::pair<double, std::uint64_t>> ahead;
+
+    for (int chunkX{firstX}; chunkX <= lastX; chunkX++) {
+        for (int chunkY{firstY}; chunkY <= lastY; chunkY++) {
+            const double dx = (chunkX + 0.5) * CHUNK_SIZE - position.x;
+            const double dy = (chunkY + 0.5) * CHUNK_SIZE - position.y;
+            const double span = std::sqrt(dx * dx + dy * dy);
+
+            if (span <= distance + slack && dx * forward.x + dy * forward.y >= -slack) {
+                ahead.emplace_back(span, GetChunkKey(chunkX, chunkY));
+            }
+        }
+    }
+
+    std::sort(ahead.begin(), ahead.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Prefetches from earlier frames that haven't started loading make
+        // way for those of this one, so turning doesn't pile them up
+        for (auto request = m_requests.begin(); request != m_requests.end();) {
+            const auto found = m_chunkBuffers.find(*request);
+
+            if (found != m_chunkBuffers.end() && found->second == CHUNK_PREFETCHED) {
+                m_chunkBuffers.erase(found);
+                request = m_requests.erase(request);
+            } else {
+                ++request;
+            }
+        }
+
+        for (const auto &chunk : ahead) {
+            Request(static_cast<int>(chunk.second >> 32), static_cast<int>(chunk.second & 0xFFFFFFFF), false);
+        }
+    }
+
+    m_wake.notify_one();
+}
+
+void ChunkedWorld::Preload(const int minX, const int minY, const int maxX, const int maxY)
+{
+    const int firstX = std::max(0, minX) >> CHUNK_SHIFT;
+    const int firstY = std::max(0, minY) >> CHUNK_SHIFT;
+    const int lastX = std::min(m_columns - 1, maxX) >> CHUNK_SHIFT;
+    const int lastY = std::min(m_rows - 1, maxY) >> CHUNK_SHIFT;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (int chunkX{firstX}; chunkX <= lastX; chunkX++) {
+        for (int chunkY{firstY}; chunkY <= lastY; chunkY++) {
+            const auto found = m_chunkBuffers.find(GetChunkKey(chunkX, chunkY));
+
+            if (found == m_chunkBuffers.end() || found->second == CHUNK_PREFETCHED) {
+                Request(chunkX, chunkY, true);
+            }
+        }
+    }
+
+    m_wake.notify_one();
+
+    // Done when every chunk has landed, or the budget is full and only
+    // Update() can make room
+    m_loaded.wait(lock, [&] {
+        if (m_stopping || (m_freeBuffers.empty() && static_cast<int>(m_buffers.size()) >= m_maxBuffers)) {
+            return true;
+        }
+
+        for (int chunkX{firstX}; chunkX <= lastX; chunkX++) {
+            for (int chunkY{firstY}; chunkY <= lastY; chunkY++) {
+                const auto found = m_chunkBuffers.find(GetChunkKey(chunkX, chunkY));
+                if (found != m_chunkBuffers.end() && found->second == CHUNK_WAITED) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    });
+}
+
+void ChunkedWorld::Update()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frame++;
+
+    const int room = static_cast<int>(m_freeBuffers.size()) + m_maxBuffers - static_cast<int>(m_buffers.size());
+    const int wanted = static_cast<int>(m_requests.size()) - room;
+    if (wanted <= 0) {
+        return;
+    }
+
+    // Least recently drawn first, leaving those of the last frame alone.
+    // Only published buffers count: one that is free or still loading
+    // would otherwise be freed twice and refilled while it is drawn.
+    std::vector<int> candidates;
+    for (int buffer{0}; buffer < static_cast<int>(m_buffers.size()); buffer++) {
+        const ChunkBuffer &chunkBuffer = m_buffers[buffer];
+        if (chunkBuffer.lastUsed >= m_frame - 1) {
+            continue;
+        }
+
+        const auto found = m_chunkBuffers.find(GetChunkKey(chunkBuffer.chunkX, chunkBuffer.chunkY));
+        if (found != m_chunkBuffers.end() && found->second == buffer) {
+            candidates.push_back(buffer);
+        }
+    }
+
+    const int evicted = std::min(wanted, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + evicted, candidates.end(), [this](const int a, const int b) {
+        return m_buffers[a].lastUsed < m_buffers[b].lastUsed;
+    });
+
+    for (int i{0}; i < evicted; i++) {
+        ChunkBuffer &buffer = m_buffers[candidates[i]];
+
+        GetChunkEntry(buffer.chunkX, buffer.chunkY).store(&m_unloadedChunk, std::memory_order_relaxed);
+        m_chunkBuffers.erase(GetChunkKey(buffer.chunkX, buffer.chunkY));
+        m_freeBuffers.push_back(candidates[i]);
+    }
+
+    m_evictions += evicted;
+
+    if (evicted) {
+        lock.unlock();
+        m_wake.notify_one();
+    }
+}
+
+ChunkedWorldStats ChunkedWorld::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return {m_maxBuffers, static_cast<int>(m_buffers.size() - m_freeBuffers.size()), m_buffers.size() * sizeof(Chunk),
+            m_misses, m_loads, m_evictions};
+}
+
+std::atomic<const ChunkedWorld::Chunk*>& ChunkedWorld::GetChunkEntry(const int chunkX, const int chunkY)
+{
+    std::atomic<Region*> &entry = m_regions[(chunkX >> REGION_SHIFT) * m_regionRows + (chunkY >> REGION_SHIFT)];
+    Region *region = entry.load(std::memory_order_relaxed);
+
+    // Regions are made the first time one of their chunks loads and kept,
+    // so a lookup never sees one freed
+    if (region == &m_emptyRegion) {
+        m_regionStorage.emplace_back(new Region);
+        region = m_regionStorage.back().get();
+
+        for (auto &chunk : region->chunks) {
+            chunk.store(&m_unloadedChunk, std::memory_order_relaxed);
+        }
+
+        entry.store(region, std::memory_order_release);
+    }
+
+    return region->chunks[(chunkX & (REGION_SIZE - 1)) * REGION_SIZE + (chunkY & (REGION_SIZE - 1))];
+}
+
+std::uint64_t ChunkedWorld::GetChunkKey(const int chunkX, const int chunkY) noexcept
+{
+    return static_cast<std::uint64_t>(chunkX) << 32 | static_cast<std::uint32_t>(chunkY);
+}
+
+void ChunkedWorld::Request(const int chunkX, const int chunkY, const bool urgent)
+{
+    const std::uint64_t key = GetChunkKey(chunkX, chunkY);
+    const auto found = m_chunkBuffers.find(key);
+
+    if (found == m_chunkBuffers.end()) {
+        m_chunkBuffers[key] = urgent ? CHUNK_WAITED : CHUNK_PREFETCHED;
+    } else if (urgent && found->second == CHUNK_PREFETCHED) {
+        // Moved up from behind the prefetches, unless it is loading already
+        found->second = CHUNK_WAITED;
+
+        const auto queued = std::find(m_requests.begin(), m_requests.end(), key);
+        if (queued == m_requests.end()) {
+            return;
+        }
+        m_requests.erase(queued);
+    } else {
+        return;
+    }
+
+    // Chunks already being drawn go ahead of prefetches
+    if (urgent) {
+        m_requests.push_front(key);
+    } else {
+        m_requests.push_back(key);
+    }
+}
+
+void ChunkedWorld::Publish(const int buffer)
+{
+    ChunkBuffer &chunkBuffer = m_buffers[buffer];
+
+    m_chunkBuffers[GetChunkKey(chunkBuffer.chunkX, chunkBuffer.chunkY)] = buffer;
+    chunkBuffer.lastUsed = m_frame;
+    m_loads++;
+
+    // Release, so a thread that sees the chunk sees its cells
+    GetChunkEntry(chunkBuffer.chunkX, chunkBuffer.chunkY).store(chunkBuffer.chunk.get(), std::memory_order_release);
+}
+
+void ChunkedWorld::LoadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_wake.wait(lock, [this] {
+            return m_stopping || (!m_requests.empty() &&
+                                  (!m_freeBuffers.empty() || static_cast<int>(m_buffers.size()) < m_maxBuffers));
+        });
+
+        if (m_stopping) {
+            return;
+        }
+
+        const std::uint64_t key = m_requests.front();
+        m_requests.pop_front();
+
+        int buffer;
+        if (m_freeBuffers.empty()) {
+            buffer = static_cast<int>(m_buffers.size());
+            m_buffers.push_back({std::unique_ptr<Chunk>(new Chunk), 0, 0, 0});
+        } else {
+            buffer = m_freeBuffers.back();
+            m_freeBuffers.pop_back();
+        }
+
+        ChunkBuffer &chunkBuffer = m_buffers[buffer];
+        chunkBuffer.chunkX = static_cast<int>(key >> 32);
+        chunkBuffer.chunkY = static_cast<int>(key & 0xFFFFFFFF);
+        Chunk *chunk = chunkBuffer.chunk.get();
+
+        // The buffer is free, so no lookup reads it while it fills
+        lock.unlock();
+        const bool loaded = m_source->LoadChunk(static_cast<int>(key >> 32), static_cast<int>(key & 0xFFFFFFFF), chunk->cells);
+        lock.lock();
+
+        if (loaded) {
+            Publish(buffer);
+        } else {
+            // Left as walls rather than asked for again every frame
+            m_chunkBuffers[key] = CHUNK_FAILED;
+            m_freeBuffers.push_back(buffer);
+        }
+
+        m_loaded.notify_all();
+    }
+}
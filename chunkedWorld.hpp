@@ -0,0 +1,230 @@
+#ifndef CHUNKED_WORLD_HPP
+#define CHUNKED_WORLD_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "point.hpp"
+
+namespace Raycaster
+{
+    // Chunks are CHUNK_SIZE cells square, cells stored column by column
+    const int CHUNK_SHIFT{6};
+    const int CHUNK_SIZE{1 << CHUNK_SHIFT};
+    const int CHUNK_CELLS{CHUNK_SIZE * CHUNK_SIZE};
+    // Largest world side in cells
+    const int MAX_WORLD_SIDE{1 << 22};
+
+    // Where a ChunkedWorld gets its chunks from. LoadChunk() is only called
+    // on the world's loader thread, one chunk at a time.
+    class ChunkSource
+    {
+    public:
+        virtual ~ChunkSource() {}
+
+        // Fills the CHUNK_CELLS cells of chunk (chunkX, chunkY), column by
+        // column
+        virtual bool LoadChunk(const int chunkX, const int chunkY, std::uint8_t *cells) = 0;
+    };
+
+    // Endless field of pillars and short walls, the same for a seed
+    // whatever order chunks are made in
+    class GeneratedChunkSource : public ChunkSource
+    {
+    public:
+        explicit GeneratedChunkSource(const std::uint32_t seed) : m_seed{seed} {}
+
+        bool LoadChunk(const int chunkX, const int chunkY, std::uint8_t *cells) override;
+
+    private:
+        std::uint32_t m_seed;
+    };
+
+    // Chunks read from a file as they are needed. All header fields are
+    // 32-bit little-endian:
+    //
+    //     0   magic "RCCK"
+    //     4   version (1)
+    //     8   columns
+    //     12  rows
+    //     16  chunk size (64)
+    //
+    // followed, from byte 32, by the cells of every chunk in turn, chunk
+    // (x, y) being chunk x * chunk rows + y.
+    class ChunkFile : public ChunkSource
+    {
+    public:
+        bool Open(const std::string &path);
+
+        int GetColumns() const noexcept { return m_columns; }
+        int GetRows() const noexcept { return m_rows; }
+
+        bool LoadChunk(const int chunkX, const int chunkY, std::uint8_t *cells) override;
+
+        // Writes a world of columns x rows cells taken from source
+        static bool Write(const std::string &path, const int columns, const int rows, ChunkSource &source);
+
+    private:
+        std::ifstream m_file;
+        int m_columns{0};
+        int m_rows{0};
+    };
+
+    struct ChunkedWorldStats {
+        int chunkBuffers;
+        int residentChunks;
+        std::size_t bytes;
+        // Chunks drawn before they were loaded, loads made and chunks
+        // evicted to make room, since the world was created
+        std::uint64_t misses;
+        std::uint64_t loads;
+        std::uint64_t evictions;
+    };
+
+    // World map streamed in fixed-size chunks, for worlds too big to hold in
+    // memory. Chunks are loaded from a ChunkSource on a thread of their own
+    // and kept within a memory budget.
+    //
+    // GetCell() takes no locks: a directory of regions, each a table of
+    // REGION_SIZE x REGION_SIZE chunk pointers, is two pointer loads from a
+    // cell. Chunks that aren't resident point at a shared chunk of
+    // UNLOADED_CELL walls, so rays stop at the edge of what is loaded rather
+    // than checking every step, and the world's outside reads as
+    // UNLOADED_CELL too.
+    //
+    // Like TextureCache, chunks only change hands in Update(), called by
+    // the drawing thread between frames, with no GetCell() running on that
+    // thread. It evicts the chunks least
+    // recently drawn, never one drawn in the frame just finished, to make
+    // room for those waiting. Use() marks the chunks a frame drew from and
+    // queues the missing ones; Prefetch() queues those ahead of the camera.
+    //
+    // GetCell() and IsResident() belong to the drawing thread. Other
+    // threads, such as the game's ticks while a frame draws, read cells
+    // with CopyCells(), which holds the lock Update() evicts under.
+    class ChunkedWorld
+    {
+    public:
+        static const std::uint8_t UNLOADED_CELL{1};
+
+        // At most budgetBytes of chunks are resident at once
+        ChunkedWorld(std::unique_ptr<ChunkSource> source, const int columns, const int rows, const std::size_t budgetBytes);
+        ~ChunkedWorld();
+
+        ChunkedWorld(const ChunkedWorld&) = delete;
+        ChunkedWorld& operator=(const ChunkedWorld&) = delete;
+
+        int GetColumns() const noexcept { return m_columns; }
+        int GetRows() const noexcept { return m_rows; }
+
+        int GetCell(const int x, const int y) const noexcept
+        {
+            if (static_cast<unsigned int>(x) >= static_cast<unsigned int>(m_columns) ||
+                static_cast<unsigned int>(y) >= static_cast<unsigned int>(m_rows)) {
+                return UNLOADED_CELL;
+            }
+
+            return GetChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT)->cells[(x & (CHUNK_SIZE - 1)) * CHUNK_SIZE + (y & (CHUNK_SIZE - 1))];
+        }
+
+        bool IsResident(const int x, const int y) const noexcept;
+
+        // Copies cells [x, x + columns) x [y, y + rows) to cells, column by
+        // column with stride bytes between columns. Safe from any thread:
+        // no chunk is evicted, and so refilled, while it copies.
+        void CopyCells(const int x, const int y, const int columns, const int rows, std::uint8_t *cells, const int stride);
+
+        // Marks the chunks covering cells [minX, maxX] x [minY, maxY] as
+        // drawn in this frame and queues any that aren't resident
+        void Use(const int minX, const int minY, const int maxX, const int maxY);
+        // Queues the chunks within distance cells of position that lie in
+        // front of it along direction, behind those drawn already
+        void Prefetch(const Point<double> position, const Point<double> direction, const double distance);
+        // Queues the chunks covering the cells ahead of everything else and
+        // waits for them, e.g. around a new start position
+        void Preload(const int minX, const int minY, const int maxX, const int maxY);
+
+        // Starts a new frame; see above
+        void Update();
+
+        ChunkedWorldStats GetStats();
+
+    private:
+        struct Chunk {
+            std::uint8_t cells[CHUNK_CELLS];
+        };
+
+        static const int REGION_SHIFT{6};
+        static const int REGION_SIZE{1 << REGION_SHIFT};
+
+        struct Region {
+            std::atomic<const Chunk*> chunks[REGION_SIZE * REGION_SIZE];
+        };
+
+        // Resident chunk and where it is in the world
+        struct ChunkBuffer {
+            std::unique_ptr<Chunk> chunk;
+            int chunkX;
+            int chunkY;
+            std::uint32_t lastUsed;
+        };
+
+        const Chunk* GetChunk(const int chunkX, const int chunkY) const noexcept
+        {
+            const Region *region = m_regions[(chunkX >> REGION_SHIFT) * m_regionRows + (chunkY >> REGION_SHIFT)].load(std::memory_order_acquire);
+            return region->chunks[(chunkX & (REGION_SIZE - 1)) * REGION_SIZE + (chunkY & (REGION_SIZE - 1))].load(std::memory_order_acquire);
+        }
+
+        std::atomic<const Chunk*>& GetChunkEntry(const int chunkX, const int chunkY);
+        static std::uint64_t GetChunkKey(const int chunkX, const int chunkY) noexcept;
+        // Queues a chunk unless it is resident or queued, ahead of the
+        // queue if urgent; m_mutex held
+        void Request(const int chunkX, const int chunkY, const bool urgent);
+        // Makes a loaded buffer visible to GetCell(); m_mutex held
+        void Publish(const int buffer);
+        void LoadLoop();
+
+        std::unique_ptr<ChunkSource> m_source;
+        int m_columns;
+        int m_rows;
+        int m_chunkColumns;
+        int m_chunkRows;
+        int m_regionRows;
+
+        // Read by every lookup of a chunk that isn't resident
+        Chunk m_unloadedChunk;
+        Region m_emptyRegion;
+        std::unique_ptr<std::atomic<Region*>[]> m_regions;
+        std::vector<std::unique_ptr<Region>> m_regionStorage;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_loaded;
+        // Guarded by m_mutex, as is everything below
+        std::vector<ChunkBuffer> m_buffers;
+        std::vector<int> m_freeBuffers;
+        int m_maxBuffers;
+        std::deque<std::uint64_t> m_requests;
+        // Buffer of every resident chunk, or -1 for those queued or loading
+        std::unordered_map<std::uint64_t, int> m_chunkBuffers;
+        std::uint32_t m_frame;
+        std::uint64_t m_misses;
+        std::uint64_t m_loads;
+        std::uint64_t m_evictions;
+        bool m_stopping;
+
+        std::thread m_loadThread;
+    };
+}
+
+#endif // CHUNKED_WORLD_HPP
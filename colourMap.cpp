@@ -0,0 +1,50 @@
+#include "colourMap.hpp"
+
+#include <cmath>
+
+using namespace Raycaster;
+
+namespace
+{
+    // Fades to black over 24 cells, with side walls a little darker
+    const LightSettings DEFAULT_LIGHT_SETTINGS{0x000000, 24, 0, 4};
+}
+
+ColourMap::ColourMap() :
+    ColourMap(DEFAULT_LIGHT_SETTINGS)
+{
+
+}
+
+ColourMap::ColourMap(const LightSettings &settings) :
+    m_settings{settings},
+    m_levelsPerCell{0},
+    m_tables(LIGHT_LEVELS)
+{
+    SetSettings(settings);
+}
+
+void ColourMap::SetSettings(const LightSettings &settings)
+{
+    m_settings = settings;
+    m_levelsPerCell = settings.fogDistance > 0 ? (LIGHT_LEVELS - 1) / settings.fogDistance : 0;
+
+    const int fog[3] = {static_cast<int>((settings.fogColour >> 16) & 0xFF),
+                        static_cast<int>((settings.fogColour >> 8) & 0xFF),
+                        static_cast<int>(settings.fogColour & 0xFF)};
+
+    for (int level{0}; level < LIGHT_LEVELS; level++) {
+        const double fade = level / static_cast<double>(LIGHT_LEVELS - 1);
+        ShadeTable &table = m_tables[level];
+        std::uint32_t *channels[3] = {table.red, table.green, table.blue};
+
+        for (int channel{0}; channel < 3; channel++) {
+            const int shift = 16 - channel * 8;
+
+            for (int value{0}; value < 256; value++) {
+                const int shaded = static_cast<int>(std::lround(value + (fog[channel] - value) * fade));
+                channels[channel][value] = static_cast<std::uint32_t>(shaded) << shift;
+            }
+        }
+    }
+}
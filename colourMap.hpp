@@ -0,0 +1,69 @@
+#ifndef COLOUR_MAP_HPP
+#define COLOUR_MAP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace Raycaster
+{
+    // Level 0 is full brightness, the last is all fog
+    const int LIGHT_LEVELS{32};
+
+    // Every channel value at one light level, already shifted into place,
+    // so shading a 0x00RRGGBB colour is a lookup per channel and two ORs
+    struct ShadeTable {
+        std::uint32_t red[256];
+        std::uint32_t green[256];
+        std::uint32_t blue[256];
+    };
+
+    inline unsigned int ShadeTexel(const unsigned int colour, const ShadeTable &table) noexcept
+    {
+        return table.red[(colour >> 16) & 0xFF] | table.green[(colour >> 8) & 0xFF] | table.blue[colour & 0xFF];
+    }
+
+    struct LightSettings {
+        // Colour everything fades to with distance; black is Doom's
+        // light diminishing
+        unsigned int fogColour;
+        // Distance in map cells at which walls have faded entirely
+        double fogDistance;
+        // Levels added everywhere, darkening the whole map
+        int ambientLevels;
+        // Levels added to walls hit on their side, so corners stand out
+        int sideLevels;
+    };
+
+    // Shade tables for every light level, built once from the settings, in
+    // the manner of Doom's colour maps. Doom's are indexed by palette entry;
+    // texels here are truecolour, which would take 2^24 entries a level, so
+    // the tables go per channel instead.
+    class ColourMap
+    {
+    public:
+        ColourMap();
+        explicit ColourMap(const LightSettings &settings);
+
+        const LightSettings& GetSettings() const noexcept { return m_settings; }
+        // Rebuilds the tables
+        void SetSettings(const LightSettings &settings);
+
+        // Level of a surface seen at distance, in map cells
+        int GetLevel(const double distance, const bool side) const noexcept
+        {
+            const int level = static_cast<int>(std::min(distance * m_levelsPerCell, static_cast<double>(LIGHT_LEVELS))) +
+                              m_settings.ambientLevels + (side ? m_settings.sideLevels : 0);
+            return std::min(std::max(level, 0), LIGHT_LEVELS - 1);
+        }
+
+        const ShadeTable& GetTable(const int level) const noexcept { return m_tables[level]; }
+
+    private:
+        LightSettings m_settings;
+        double m_levelsPerCell;
+        std::vector<ShadeTable> m_tables;
+    };
+}
+
+#endif // COLOUR_MAP_HPP
@@ -0,0 +1,562 @@
+// Headless frame benchmark
+//
+// Replays a scripted camera path over the built-in world map, rendering each
+// frame into a memory buffer, and reports frames/sec, p50/p99 frame times and
+// a checksum of every frame. Identical builds must produce identical
+// checksums, so the output doubles as a rendering regression check.
+//
+// With --pipeline, frames go through a FramePipeline as in the engine's
+// Run(), and frame times are the intervals between presents. --present-ms
+// makes each present block for a while, as an SDL_Flip of a software surface
+// does.
+//
+// With --replay, the camera follows an input log recorded by the game
+// (raycaster --record) instead of the scripted path, one simulation tick per
+// frame, so a recorded session can be benchmarked and checked for
+// identical frames.
+//
+// --edits changes that many cells of the map before every frame, opening
+// walls and closing open cells, the same ones on every run. With
+// --skip-empty the distance field is updated around them, and checksums
+// must match the same run without it. With --pipeline edits are made while
+// the previous frame draws, so which frame first shows them varies.
+//
+// --interlace casts every other column each frame and rebuilds the rest
+// from the previous frame. Checksums then differ from full casts wherever
+// a rebuilt column missed the edge of a wall.
+//
+// --hold keeps the camera still for that many frames at each point of the
+// path, so the engine's column cache keeps hits and pixels from frame to
+// frame; --no-column-cache turns it off, which must not change checksums.
+// How many columns were cast, rebuilt, kept and drawn is reported.
+//
+// --capture writes every presented frame to a file or pipe through a
+// FrameCapture, as raycaster --capture does, and reports how many frames
+// were written and dropped. --capture-block waits for the writer instead
+// of dropping frames. With --capture -, results go to standard error.
+//
+// --textures draws with a texture pack instead of the built-in textures.
+// If it doesn't fit in --texture-cache-mb, textures stream in while frames
+// are drawn and checksums vary from run to run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frameCapture.hpp"
+#include "framePipeline.hpp"
+#include "profiler.hpp"
+#include "raycasterEngine.hpp"
+#include "renderTarget.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    struct Waypoint {
+        double x;
+        double y;
+    };
+
+    // Closed loop through open cells of the built-in map
+    const Waypoint CAMERA_PATH[] = {
+        {9.5, 8.5},
+        {6.5, 8.5},
+        {6.5, 15.5},
+        {17.5, 15.5},
+        {17.5, 4.5},
+        {12.5, 4.5}
+    };
+    const int CAMERA_PATH_LENGTH = sizeof(CAMERA_PATH) / sizeof(CAMERA_PATH[0]);
+    const double CAMERA_PLANE_LENGTH = 0.66;
+    const double PI = 3.14159265358979323846;
+
+    struct Options {
+        int width;
+        int height;
+        int frames;
+        int warmupFrames;
+        int framesPerWaypoint;
+        int threads;
+        CastKernel kernel;
+        int sprites;
+        bool skipEmptySpace;
+        bool pipeline;
+        double presentMs;
+        double targetMs;
+        bool printFrames;
+        std::string tracePath;
+        std::string csvPath;
+        std::string replayPath;
+        bool mipmapping;
+        bool lighting;
+        std::string texturePath;
+        double textureCacheMb;
+        int edits;
+        bool interlace;
+        int holdFrames;
+        bool columnCache;
+        std::string capturePath;
+        CapturePolicy capturePolicy;
+    };
+
+    void PrintUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--width N] [--height N] [--frames N] [--warmup N]"
+                  << " [--frames-per-waypoint N] [--threads N]"
+                  << " [--kernel auto|scalar|sse2|avx2] [--sprites N] [--skip-empty]"
+                  << " [--pipeline] [--present-ms N] [--target-ms N] [--quiet]"
+                  << " [--trace file.json] [--csv file.csv] [--replay file]"
+                  << " [--no-mips] [--lighting] [--textures pack.rctex] [--texture-cache-mb N] [--edits N]"
+                  << " [--interlace] [--hold N] [--no-column-cache]"
+                  << " [--capture file.y4m|file.rgba|-|'|command'] [--capture-block]" << std::endl;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+
+            if (!std::strcmp(argv[i], "--width") && hasValue) {
+                options.width = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--height") && hasValue) {
+                options.height = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--frames") && hasValue) {
+                options.frames = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--warmup") && hasValue) {
+                options.warmupFrames = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--frames-per-waypoint") && hasValue) {
+                options.framesPerWaypoint = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+                options.threads = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--kernel") && hasValue) {
+                const char *name = argv[++i];
+                const CastKernel kernels[] = {CastKernel::AUTO, CastKernel::SCALAR, CastKernel::SSE2, CastKernel::AVX2};
+                bool found = false;
+
+                for (const CastKernel kernel : kernels) {
+                    if (!std::strcmp(name, GetCastKernelName(kernel))) {
+                        options.kernel = kernel;
+                        found = true;
+                    }
+                }
+
+                if (!found || !IsCastKernelSupported(options.kernel)) {
+                    std::cerr << "Unsupported cast kernel: " << name << std::endl;
+                    return false;
+                }
+            } else if (!std::strcmp(argv[i], "--sprites") && hasValue) {
+                options.sprites = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--skip-empty")) {
+                options.skipEmptySpace = true;
+            } else if (!std::strcmp(argv[i], "--pipeline")) {
+                options.pipeline = true;
+            } else if (!std::strcmp(argv[i], "--present-ms") && hasValue) {
+                options.presentMs = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--target-ms") && hasValue) {
+                options.targetMs = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--quiet")) {
+                options.printFrames = false;
+            } else if (!std::strcmp(argv[i], "--trace") && hasValue) {
+                options.tracePath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--csv") && hasValue) {
+                options.csvPath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--replay") && hasValue) {
+                options.replayPath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--no-mips")) {
+                options.mipmapping = false;
+            } else if (!std::strcmp(argv[i], "--lighting")) {
+                options.lighting = true;
+            } else if (!std::strcmp(argv[i], "--textures") && hasValue) {
+                options.texturePath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--texture-cache-mb") && hasValue) {
+                options.textureCacheMb = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--edits") && hasValue) {
+                options.edits = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--interlace")) {
+                options.interlace = true;
+            } else if (!std::strcmp(argv[i], "--hold") && hasValue) {
+                options.holdFrames = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--no-column-cache")) {
+                options.columnCache = false;
+            } else if (!std::strcmp(argv[i], "--capture") && hasValue) {
+                options.capturePath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--capture-block")) {
+                options.capturePolicy = CapturePolicy::BLOCK;
+            } else {
+                return false;
+            }
+        }
+
+        return options.width > 0 && options.height > 0 && options.frames > 0 &&
+               options.warmupFrames >= 0 && options.framesPerWaypoint > 0 && options.threads >= 0 && options.sprites >= 0 &&
+               options.edits >= 0 && options.holdFrames > 0 && options.presentMs >= 0 && options.targetMs >= 0;
+    }
+
+    // Memory frame whose Present() blocks like a window system would
+    class ScreenTarget : public MemoryRenderTarget
+    {
+    public:
+        ScreenTarget(const int width, const int height, const double presentMs) :
+            MemoryRenderTarget(width, height),
+            m_presentTime{static_cast<long long>(presentMs * 1000)}
+        {
+        }
+
+        void Present() override
+        {
+            if (m_presentTime.count()) {
+                std::this_thread::sleep_for(m_presentTime);
+            }
+        }
+
+    private:
+        std::chrono::microseconds m_presentTime;
+    };
+
+    // Scatters sprites over open cells, the same ones on every run
+    void AddSprites(RaycasterEngine &engine, const int count)
+    {
+        const WorldMap &map = engine.GetWorldMap();
+        std::uint32_t state{12345};
+
+        for (int i{0}; i < count;) {
+            state = state * 1664525u + 1013904223u;
+            const int x = (state >> 8) % map.GetColumns();
+            const int y = (state >> 20) % map.GetRows();
+
+            if (!map.GetCell(x, y)) {
+                engine.GetSprites().push_back({{x + 0.5, y + 0.5}, i % 3});
+                i++;
+            }
+        }
+    }
+
+    // Toggles cells inside the map's outer wall, the same ones on every run
+    void EditMap(RaycasterEngine &engine, const int count, std::uint32_t &state, std::vector<MapEdit> &edits)
+    {
+        const WorldMap &map = engine.GetWorldMap();
+        edits.clear();
+
+        for (int i{0}; i < count; i++) {
+            state = state * 1664525u + 1013904223u;
+            const int x = 1 + (state >> 8) % (map.GetColumns() - 2);
+            const int y = 1 + (state >> 20) % (map.GetRows() - 2);
+
+            edits.push_back({x, y, static_cast<std::uint8_t>(map.GetCell(x, y) ? 0 : 1 + i % 3)});
+        }
+
+        engine.EditMap(edits);
+    }
+
+    // Places the camera for a frame: position is interpolated between
+    // waypoints and the view turns one full revolution per waypoint leg
+    CameraPose SetCameraForFrame(RaycasterEngine &engine, const int frame, const int framesPerWaypoint)
+    {
+        const int leg = (frame / framesPerWaypoint) % CAMERA_PATH_LENGTH;
+        const double t = (frame % framesPerWaypoint) / static_cast<double>(framesPerWaypoint);
+        const Waypoint &from = CAMERA_PATH[leg];
+        const Waypoint &to = CAMERA_PATH[(leg + 1) % CAMERA_PATH_LENGTH];
+
+        const double angle = PI + 2 * PI * t;
+        const RaycasterEngine::Point<double> direction{std::cos(angle), std::sin(angle)};
+
+        engine.SetPlayerPosition({from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t});
+        engine.SetPlayerDirection(direction);
+        engine.SetCameraPlane({direction.y * CAMERA_PLANE_LENGTH, -direction.x * CAMERA_PLANE_LENGTH});
+
+        return {engine.GetPlayerPosition(), engine.GetPlayerDirection(), engine.GetCameraPlane()};
+    }
+
+    double Percentile(const std::vector<double> &sorted, const double percentile)
+    {
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+        return sorted[std::max<std::size_t>(rank, 1) - 1];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options{800, 600, 600, 30, 100, 1, CastKernel::AUTO, 0, false, false, 0, 0, true, "", "", "", true, false, "", 64, 0, false, 1, true, "", CapturePolicy::DROP};
+
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // Frames captured to standard output would be mixed with the results
+    // and the engine's messages, so those go to standard error
+    if (options.capturePath == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    std::unique_ptr<RaycasterEngine> engine(new RaycasterEngine);
+    engine->InitHeadless();
+    engine->SetRenderThreadCount(options.threads);
+    engine->SetCastKernel(options.kernel);
+    engine->SetEmptySpaceSkipping(options.skipEmptySpace);
+    engine->SetMipmapping(options.mipmapping);
+    engine->SetLighting(options.lighting);
+    engine->SetInterlacing(options.interlace);
+    engine->SetColumnCaching(options.columnCache);
+    AddSprites(*engine, options.sprites);
+
+    if (!options.texturePath.empty() &&
+        !engine->LoadTextures(options.texturePath, static_cast<std::size_t>(options.textureCacheMb * (1 << 20)))) {
+        std::cerr << "Error loading texture pack " << options.texturePath << std::endl;
+        engine->Cleanup();
+        return 1;
+    }
+
+    // A replay measures one frame per recorded tick
+    if (!options.replayPath.empty()) {
+        if (!engine->LoadReplay(options.replayPath) || !engine->GetReplayTickCount()) {
+            std::cerr << "Error loading input log " << options.replayPath << std::endl;
+            engine->Cleanup();
+            return 1;
+        }
+        options.frames = static_cast<int>(engine->GetReplayTickCount());
+    }
+
+    if (options.targetMs > 0) {
+        ResolutionSettings settings = engine->GetResolutionController().GetSettings();
+        settings.targetMs = options.targetMs;
+        engine->GetResolutionController().SetSettings(settings);
+        engine->SetDynamicResolution(true);
+    }
+
+    ScreenTarget target(options.width, options.height, options.presentMs);
+
+    // Raw RGBA for .rgba files, Y4M for anything else
+    FrameCapture capture;
+    if (!options.capturePath.empty()) {
+        CaptureSettings settings = DEFAULT_CAPTURE_SETTINGS;
+        const std::string &path = options.capturePath;
+        const bool isRGBA = path.size() >= 5 && !path.compare(path.size() - 5, 5, ".rgba");
+        settings.format = isRGBA ? CaptureFormat::RGBA : CaptureFormat::Y4M;
+        settings.policy = options.capturePolicy;
+
+        if (!capture.Open(path, options.width, options.height, settings)) {
+            std::cerr << "Error opening capture output " << path << std::endl;
+            engine->Cleanup();
+            return 1;
+        }
+    }
+
+    // Runs on the pipeline's draw thread when there is one
+    double scaleTotal{0};
+    std::uint64_t columnsCast{0};
+    std::uint64_t columnsReprojected{0};
+    std::uint64_t columnsCached{0};
+    std::uint64_t columnsDrawn{0};
+    int framesCopied{0};
+    int drawn{0};
+    const auto drawFrame = [&](RenderTarget &frame, const CameraPose &pose) {
+        const bool measured = drawn++ >= options.warmupFrames;
+
+        if (measured) {
+            scaleTotal += engine->GetResolutionController().GetScale();
+        }
+        engine->RenderFrame(frame, pose);
+
+        if (measured) {
+            const RaycasterEngine::ColumnStats stats = engine->GetColumnStats();
+            columnsCast += stats.castColumns;
+            columnsReprojected += stats.reprojectedColumns;
+            columnsCached += stats.cachedColumns;
+            columnsDrawn += stats.drawnColumns;
+            framesCopied += stats.copiedFrame;
+        }
+    };
+
+    std::unique_ptr<FramePipeline> pipeline;
+    if (options.pipeline) {
+        engine->SetMapDoubleBuffering(true);
+        pipeline.reset(new FramePipeline(options.width, options.height, 2, drawFrame));
+    }
+
+    std::uint32_t editState{54321};
+    std::vector<MapEdit> edits;
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+    std::uint64_t combinedChecksum = 14695981039346656037ULL;
+    int presented{0};
+    auto lastPresent = std::chrono::steady_clock::now();
+
+    // Records a frame once it is presented; the warmup frames go unmeasured
+    const auto framePresented = [&](const std::chrono::steady_clock::time_point start) {
+        const int frame = presented++ - options.warmupFrames;
+
+        if (frame < 0) {
+            // Stage stats cover the measured frames only
+            if (frame == -1) {
+                ClearProfile();
+            }
+
+            lastPresent = std::chrono::steady_clock::now();
+            return;
+        }
+
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        frameTimes.push_back(milliseconds);
+
+        const std::uint64_t checksum = target.Checksum();
+        combinedChecksum = (combinedChecksum ^ checksum) * 1099511628211ULL;
+
+        if (options.printFrames) {
+            std::cout << "frame " << frame << " " << std::fixed << std::setprecision(3) << milliseconds
+                      << " ms checksum " << std::hex << std::setw(16) << std::setfill('0') << checksum
+                      << std::dec << std::setfill(' ') << std::endl;
+        }
+
+        // The next interval starts after the checksum, which isn't part of
+        // the frame
+        lastPresent = std::chrono::steady_clock::now();
+    };
+
+    for (int i{0}; i < options.warmupFrames + options.frames; i++) {
+        const int frame = i < options.warmupFrames ? i : i - options.warmupFrames;
+        CameraPose pose;
+
+        if (engine->IsReplaying()) {
+            // Warmup frames are drawn from the start of the recording
+            if (i >= options.warmupFrames) {
+                engine->StepReplay();
+            }
+            pose = {engine->GetPlayerPosition(), engine->GetPlayerDirection(), engine->GetCameraPlane()};
+        } else {
+            pose = SetCameraForFrame(*engine, frame / options.holdFrames, options.framesPerWaypoint);
+        }
+
+        if (options.edits) {
+            EditMap(*engine, options.edits, editState, edits);
+        }
+
+        if (pipeline) {
+            // Presents lag one frame behind, so each is timed from the last
+            pipeline->Submit(pose);
+
+            if (pipeline->IsFull()) {
+                PROFILE_SCOPE(PRESENT);
+                pipeline->PresentOldest(target, &capture);
+                framePresented(lastPresent);
+            }
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        {
+            PROFILE_SCOPE(FRAME);
+            drawFrame(target, pose);
+        }
+        {
+            PROFILE_SCOPE(PRESENT);
+            target.Present();
+        }
+        framePresented(start);
+
+        // After the checksum, as the handoff leaves target with another
+        // buffer's pixels
+        if (capture.IsOpen()) {
+            PROFILE_SCOPE(CAPTURE);
+            capture.Capture(target);
+        }
+    }
+
+    while (pipeline && pipeline->PresentOldest(target, &capture)) {
+        framePresented(lastPresent);
+    }
+    pipeline.reset();
+
+    const bool captureOpen = capture.IsOpen();
+    const bool captureWritten = capture.Close();
+    const CaptureStats captureStats = capture.GetStats();
+
+    const int threadCount = engine->GetRenderThreadCount();
+    const TextureCacheStats textureStats = engine->GetTextureCache().GetStats();
+    engine->Cleanup();
+
+    double totalTime = 0;
+    for (const double frameTime : frameTimes) {
+        totalTime += frameTime;
+    }
+
+    std::vector<double> sorted(frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "resolution " << options.width << "x" << options.height << std::endl
+              << "threads " << threadCount << std::endl
+              << "pipeline " << (options.pipeline ? "on" : "off") << std::endl
+              << "kernel " << GetCastKernelName(options.kernel == CastKernel::AUTO ? GetBestCastKernel() : options.kernel) << std::endl
+              << "frames " << options.frames << std::endl
+              << "fps " << options.frames / (totalTime / 1000.0) << std::endl
+              << "p50_ms " << Percentile(sorted, 50) << std::endl
+              << "p99_ms " << Percentile(sorted, 99) << std::endl;
+
+    if (options.targetMs > 0) {
+        std::cout << "mean_scale " << scaleTotal / options.frames << std::endl;
+    }
+
+    std::cout << "cast_columns " << columnsCast << std::endl
+              << "reprojected_columns " << columnsReprojected << std::endl
+              << "cached_columns " << columnsCached << std::endl
+              << "drawn_columns " << columnsDrawn << std::endl
+              << "copied_frames " << framesCopied << std::endl;
+
+    std::cout << "checksum " << std::hex << std::setw(16) << std::setfill('0') << combinedChecksum << std::dec << std::endl;
+
+    if (captureOpen) {
+        std::cout << "capture_frames " << captureStats.captured << std::endl
+                  << "capture_written " << captureStats.written << std::endl
+                  << "capture_dropped " << captureStats.dropped << std::endl
+                  << "capture_mb " << captureStats.bytes / static_cast<double>(1 << 20) << std::endl;
+    }
+
+    if (!options.texturePath.empty()) {
+        std::cout << "texture_slots " << textureStats.slots << std::endl
+                  << "texture_cache_mb " << textureStats.bytes / static_cast<double>(1 << 20) << std::endl
+                  << "texture_misses " << textureStats.misses << std::endl
+                  << "texture_loads " << textureStats.loads << std::endl
+                  << "texture_evictions " << textureStats.evictions << std::endl;
+    }
+
+    // Per-stage times are summed over threads' chunks, so they are per chunk
+    // rather than per frame for the threaded stages
+    if (PROFILING_ENABLED) {
+        for (int i{0}; i < PROFILE_STAGES; i++) {
+            const ProfileStats stats = GetProfileStats(static_cast<ProfileStage>(i));
+            if (stats.count) {
+                std::cout << "stage " << GetProfileStageName(static_cast<ProfileStage>(i)) << " count " << stats.count
+                          << " mean_ms " << stats.meanMs << " p50_ms " << stats.p50Ms << " p99_ms " << stats.p99Ms
+                          << " max_ms " << stats.maxMs << std::endl;
+            }
+        }
+    }
+
+    if (captureOpen && !captureWritten) {
+        std::cerr << "Error writing capture " << options.capturePath << std::endl;
+        return 1;
+    }
+
+    if (!options.tracePath.empty() && !WriteProfileTrace(options.tracePath)) {
+        std::cerr << "Error writing trace " << options.tracePath << std::endl;
+        return 1;
+    }
+
+    if (!options.csvPath.empty() && !WriteProfileCsv(options.csvPath)) {
+        std::cerr << "Error writing CSV " << options.csvPath << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "frameCapture.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace Raycaster;
+
+namespace
+{
+    inline unsigned char ClampByte(const int value) noexcept
+    {
+        return static_cast<unsigned char>(std::min(std::max(value, 0), 255));
+    }
+
+    // BT.601 full range in 8.8 fixed point, as JPEG uses. Chroma of pure
+    // blue and red rounds to 256, so it is clamped rather than wrapped
+    inline unsigned char GetLuma(const int r, const int g, const int b) noexcept
+    {
+        return ClampByte((77 * r + 150 * g + 29 * b + 128) >> 8);
+    }
+
+    inline unsigned char GetBlueChroma(const int r, const int g, const int b) noexcept
+    {
+        return ClampByte(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+    }
+
+    inline unsigned char GetRedChroma(const int r, const int g, const int b) noexcept
+    {
+        return ClampByte(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+    }
+
+    const char Y4M_FRAME_HEADER[] = "FRAME\n";
+    const std::size_t Y4M_FRAME_HEADER_SIZE{sizeof(Y4M_FRAME_HEADER) - 1};
+}
+
+FrameCapture::FrameCapture() :
+    m_output{nullptr},
+    m_isPipe{false},
+    m_width{0},
+    m_height{0},
+    m_settings(DEFAULT_CAPTURE_SETTINGS),
+    m_stopping{false},
+    m_stats{0, 0, 0, 0, false}
+{
+
+}
+
+FrameCapture::~FrameCapture()
+{
+    Close();
+}
+
+bool FrameCapture::Open(const std::string &path, const int width, const int height, const CaptureSettings &settings)
+{
+    Close();
+
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    if (path == "-") {
+        m_output = stdout;
+    } else if (!path.empty() && path[0] == '|') {
+        m_output = popen(path.c_str() + 1, "w");
+        m_isPipe = m_output != nullptr;
+    } else {
+        m_output = std::fopen(path.c_str(), "wb");
+    }
+
+    if (!m_output) {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_settings = settings;
+    m_stopping = false;
+    m_stats = {0, 0, 0, 0, false};
+
+    const std::size_t pixels = static_cast<std::size_t>(width) * height;
+    const int count = std::max(1, settings.bufferCount);
+
+    m_buffers.assign(count, std::vector<unsigned int>(pixels));
+    m_free.clear();
+    m_queued.clear();
+    for (int i{0}; i < count; i++) {
+        m_free.push_back(i);
+    }
+
+    if (settings.format == CaptureFormat::Y4M) {
+        const std::size_t chroma = static_cast<std::size_t>((width + 1) / 2) * ((height + 1) / 2);
+        m_bytes.resize(Y4M_FRAME_HEADER_SIZE + pixels + 2 * chroma);
+
+        char header[128];
+        const int length = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+                                         width, height, std::max(1, settings.frameRate));
+
+        if (std::fwrite(header, 1, length, m_output) != static_cast<std::size_t>(length)) {
+            m_stats.failed = true;
+        }
+        m_stats.bytes += length;
+    } else {
+        m_bytes.resize(pixels * 4);
+    }
+
+    m_writeThread = std::thread(&FrameCapture::WriteLoop, this);
+    return true;
+}
+
+bool FrameCapture::Close()
+{
+    if (!m_output) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_frameQueued.notify_all();
+    m_writeThread.join();
+
+    bool closed{true};
+    if (m_isPipe) {
+        closed = pclose(m_output) == 0;
+    } else if (m_output == stdout) {
+        closed = std::fflush(m_output) == 0;
+    } else {
+        closed = std::fclose(m_output) == 0;
+    }
+
+    m_output = nullptr;
+    m_isPipe = false;
+    m_stats.failed = m_stats.failed || !closed;
+
+    return !m_stats.failed;
+}
+
+bool FrameCapture::Capture(MemoryRenderTarget &target)
+{
+    if (target.GetWidth() != m_width || target.GetHeight() != m_height) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const int index = TakeFreeBuffer(lock);
+
+    if (index < 0) {
+        return false;
+    }
+
+    // Buffers are all a frame in size, so this is a handoff, not a copy
+    target.SwapPixels(m_buffers[index]);
+    lock.unlock();
+
+    QueueBuffer(index);
+    return true;
+}
+
+bool FrameCapture::Capture(const FrameBuffer &frame)
+{
+    if (!frame.pixels || frame.width != m_width || frame.height != m_height) {
+        return false;
+    }
+
+    int index;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        index = TakeFreeBuffer(lock);
+    }
+
+    if (index < 0) {
+        return false;
+    }
+
+    // A free buffer is only touched by the thread that took it
+    CopyFrame(frame, {m_buffers[index].data(), m_width, m_height, m_width});
+    QueueBuffer(index);
+    return true;
+}
+
+CaptureStats FrameCapture::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+int FrameCapture::TakeFreeBuffer(std::unique_lock<std::mutex> &lock)
+{
+    if (!m_output || m_stats.failed) {
+        m_stats.dropped++;
+        return -1;
+    }
+
+    if (m_settings.policy == CapturePolicy::BLOCK) {
+        m_bufferFreed.wait(lock, [this] { return !m_free.empty() || m_stats.failed; });
+    }
+
+    if (m_free.empty() || m_stats.failed) {
+        m_stats.dropped++;
+        return -1;
+    }
+
+    const int index = m_free.front();
+    m_free.pop_front();
+    return index;
+}
+
+void FrameCapture::QueueBuffer(const int index)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queued.push_back(index);
+        m_stats.captured++;
+    }
+    m_frameQueued.notify_one();
+}
+
+void FrameCapture::WriteLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_frameQueued.wait(lock, [this] { return m_stopping || !m_queued.empty(); });
+
+        // Frames already captured are written before stopping
+        if (m_queued.empty()) {
+            return;
+        }
+
+        const int index = m_queued.front();
+        m_queued.pop_front();
+        const bool failed = m_stats.failed;
+
+        // The buffer is the writer's until it is freed
+        lock.unlock();
+        bool written{false};
+        if (!failed) {
+            ConvertFrame(m_buffers[index]);
+            written = std::fwrite(m_bytes.data(), 1, m_bytes.size(), m_output) == m_bytes.size();
+        }
+        lock.lock();
+
+        if (written) {
+            m_stats.written++;
+            m_stats.bytes += m_bytes.size();
+        } else {
+            m_stats.failed = true;
+        }
+
+        m_free.push_back(index);
+        m_bufferFreed.notify_all();
+    }
+}
+
+void FrameCapture::ConvertFrame(const std::vector<unsigned int> &pixels)
+{
+    const int width = m_width;
+    const int height = m_height;
+    unsigned char *bytes = m_bytes.data();
+
+    if (m_settings.format == CaptureFormat::RGBA) {
+        for (const unsigned int pixel : pixels) {
+            *bytes++ = (pixel >> 16) & 0xFF;
+            *bytes++ = (pixel >> 8) & 0xFF;
+            *bytes++ = pixel & 0xFF;
+            *bytes++ = 0xFF;
+        }
+        return;
+    }
+
+    std::memcpy(bytes, Y4M_FRAME_HEADER, Y4M_FRAME_HEADER_SIZE);
+    unsigned char *luma = bytes + Y4M_FRAME_HEADER_SIZE;
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    unsigned char *blue = luma + static_cast<std::size_t>(width) * height;
+    unsigned char *red = blue + static_cast<std::size_t>(chromaWidth) * chromaHeight;
+
+    for (std::size_t i{0}; i < pixels.size(); i++) {
+        const unsigned int pixel = pixels[i];
+        luma[i] = GetLuma((pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF);
+    }
+
+    // Chroma from the average of each 2x2 block, repeating the last row
+    // and column of frames of odd size
+    for (int y{0}; y < chromaHeight; y++) {
+        const unsigned int *top = &pixels[static_cast<std::size_t>(2 * y) * width];
+        const unsigned int *bottom = 2 * y + 1 < height ? top + width : top;
+
+        for (int x{0}; x < chromaWidth; x++) {
+            const int left = 2 * x;
+            const int right = std::min(left + 1, width - 1);
+            const unsigned int block[4] = {top[left], top[right], bottom[left], bottom[right]};
+            int r{0};
+            int g{0};
+            int b{0};
+
+            for (const unsigned int pixel : block) {
+                r += (pixel >> 16) & 0xFF;
+                g += (pixel >> 8) & 0xFF;
+                b += pixel & 0xFF;
+            }
+
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+
+            blue[y * chromaWidth + x] = GetBlueChroma(r, g, b);
+            red[y * chromaWidth + x] = GetRedChroma(r, g, b);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "renderTarget.hpp"
+
+namespace Raycaster
+{
+    enum class CaptureFormat {
+        // YUV4MPEG2, 4:2:0 full range, which video tools read directly
+        Y4M,
+        // Bytes R, G, B, A for every pixel, rows top to bottom, no header
+        RGBA
+    };
+
+    // What Capture() does when every buffer is waiting to be written
+    enum class CapturePolicy {
+        // Drops the frame, so drawing never waits on the disk
+        DROP,
+        // Waits for the writer, so every frame is kept
+        BLOCK
+    };
+
+    struct CaptureSettings {
+        CaptureFormat format;
+        CapturePolicy policy;
+        // Frames that can wait to be written
+        int bufferCount;
+        // Frame rate written in the Y4M header
+        int frameRate;
+    };
+
+    const CaptureSettings DEFAULT_CAPTURE_SETTINGS{CaptureFormat::Y4M, CapturePolicy::DROP, 4, 60};
+
+    struct CaptureStats {
+        // Frames handed to the writer, dropped for want of a buffer, and
+        // written out
+        std::uint64_t captured;
+        std::uint64_t dropped;
+        std::uint64_t written;
+        std::uint64_t bytes;
+        // Set once a write fails; later frames are dropped
+        bool failed;
+    };
+
+    // Streams frames to a file or pipe on a writer thread of its own.
+    //
+    // Frames travel in a fixed pool of buffers the size of a frame, passed
+    // between the threads by index like FramePipeline's back buffers.
+    // Capture() swaps a MemoryRenderTarget's pixels with a free buffer, so
+    // the drawing side only trades two vectors under a lock; the writer
+    // converts the frame to the output format and writes it while the
+    // next ones are drawn. Nothing is allocated per frame.
+    class FrameCapture
+    {
+    public:
+        FrameCapture();
+        // Writes out the frames already captured
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        // Starts writing width x height frames to path, which is a file,
+        // "-" for standard output or "|command" for a command's standard
+        // input. Fails if the output can't be opened.
+        bool Open(const std::string &path, const int width, const int height,
+                  const CaptureSettings &settings = DEFAULT_CAPTURE_SETTINGS);
+        // Waits for the frames captured so far to be written and closes
+        // the output. Returns false if any write failed.
+        bool Close();
+        bool IsOpen() const noexcept { return m_output != nullptr; }
+
+        // Hands target's frame to the writer, giving target a free buffer's
+        // pixels in return. Returns false if the frame was dropped, or
+        // isn't the size the capture was opened for.
+        bool Capture(MemoryRenderTarget &target);
+        // Same for any frame, copying it into the free buffer
+        bool Capture(const FrameBuffer &frame);
+
+        CaptureStats GetStats();
+
+    private:
+        // Takes a free buffer, waiting for one under CapturePolicy::BLOCK;
+        // -1 if there is none. m_mutex held.
+        int TakeFreeBuffer(std::unique_lock<std::mutex> &lock);
+        // Queues a filled buffer for the writer
+        void QueueBuffer(const int index);
+        void WriteLoop();
+        // Converts a frame into m_bytes
+        void ConvertFrame(const std::vector<unsigned int> &pixels);
+
+        std::FILE *m_output;
+        bool m_isPipe;
+        int m_width;
+        int m_height;
+        CaptureSettings m_settings;
+
+        std::vector<std::vector<unsigned int>> m_buffers;
+        // Output bytes of one frame, only touched by the writer
+        std::vector<unsigned char> m_bytes;
+
+        std::mutex m_mutex;
+        std::condition_variable m_frameQueued;
+        std::condition_variable m_bufferFreed;
+
+        // Buffer indices free and waiting to be written, oldest first. A
+        // buffer being written is in neither.
+        std::deque<int> m_free;
+        std::deque<int> m_queued;
+        bool m_stopping;
+        CaptureStats m_stats;
+
+        std::thread m_writeThread;
+    };
+}
+
+#endif // FRAME_CAPTURE_HPP
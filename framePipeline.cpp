@@ -0,0 +1,120 @@
+#include "framePipeline.hpp"
+
+#include <algorithm>
+
+#include "profiler.hpp"
+
+using namespace Raycaster;
+
+FramePipeline::FramePipeline(const int width, const int height, const int bufferCount, const DrawFunction &draw) :
+    m_draw{draw},
+    m_drawing{-1},
+    m_stopping{false}
+{
+    const int count = std::max(1, bufferCount);
+
+    for (int i{0}; i < count; i++) {
+        m_buffers.push_back({std::unique_ptr<MemoryRenderTarget>(new MemoryRenderTarget(width, height)), {}});
+        m_free.push_back(i);
+    }
+
+    m_drawThread = std::thread(&FramePipeline::DrawLoop, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_frameSubmitted.notify_all();
+
+    m_drawThread.join();
+}
+
+void FramePipeline::Submit(const CameraPose &pose)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bufferFreed.wait(lock, [this] { return !m_free.empty(); });
+
+    const int index = m_free.front();
+    m_free.pop_front();
+
+    m_buffers[index].pose = pose;
+    m_toDraw.push_back(index);
+
+    lock.unlock();
+    m_frameSubmitted.notify_one();
+}
+
+bool FramePipeline::IsFull()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_free.empty();
+}
+
+bool FramePipeline::PresentOldest(RenderTarget &target, FrameCapture *capture)
+{
+    int index;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_frameDrawn.wait(lock, [this] { return !m_drawn.empty() || (m_toDraw.empty() && m_drawing < 0); });
+
+        if (m_drawn.empty()) {
+            return false;
+        }
+
+        index = m_drawn.front();
+        m_drawn.pop_front();
+    }
+
+    // The back buffer is ours until it is freed, so it is read unlocked
+    // while the draw thread carries on with the next frame
+    const FrameBuffer frame = target.Lock();
+    if (frame.pixels) {
+        CopyFrame(m_buffers[index].target->Lock(), frame);
+        target.Unlock();
+        target.Present();
+    }
+
+    // Every frame is drawn whole, so the buffer it gets back needn't be
+    // cleared
+    if (capture && capture->IsOpen()) {
+        PROFILE_SCOPE(CAPTURE);
+        capture->Capture(*m_buffers[index].target);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(index);
+    }
+    m_bufferFreed.notify_one();
+
+    return frame.pixels != nullptr;
+}
+
+void FramePipeline::DrawLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_frameSubmitted.wait(lock, [this] { return m_stopping || !m_toDraw.empty(); });
+
+        if (m_stopping) {
+            return;
+        }
+
+        m_drawing = m_toDraw.front();
+        m_toDraw.pop_front();
+
+        BackBuffer &buffer = m_buffers[m_drawing];
+        lock.unlock();
+        m_draw(*buffer.target, buffer.pose);
+        lock.lock();
+
+        m_drawn.push_back(m_drawing);
+        m_drawing = -1;
+        m_frameDrawn.notify_one();
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frameCapture.hpp"
+#include "rayCast.hpp"
+#include "renderTarget.hpp"
+
+namespace Raycaster
+{
+    // Draws frames on a thread of its own while the caller presents earlier
+    // ones, so drawing frame N + 1 overlaps presenting frame N.
+    //
+    // Frames are drawn into a fixed set of back buffers which pass between
+    // the stages by index: Submit() takes a free buffer, the draw thread
+    // fills it, PresentOldest() copies it to the screen and frees it. With
+    // every buffer in use Submit() blocks, which bounds how far drawing runs
+    // ahead of the screen. Presenting stays on the calling thread, as SDL
+    // video calls must stay on the thread that set the video mode.
+    class FramePipeline
+    {
+    public:
+        // Draws one frame of pose into target; called on the draw thread
+        typedef std::function<void(RenderTarget &target, const CameraPose &pose)> DrawFunction;
+
+        FramePipeline(const int width, const int height, const int bufferCount, const DrawFunction &draw);
+        // Frames not yet presented are dropped
+        ~FramePipeline();
+
+        FramePipeline(const FramePipeline&) = delete;
+        FramePipeline& operator=(const FramePipeline&) = delete;
+
+        // Queues a frame of pose for drawing, waiting for a free buffer
+        void Submit(const CameraPose &pose);
+        // True when every buffer holds a frame, so Submit() would wait
+        bool IsFull();
+
+        // Waits for the oldest submitted frame to be drawn, copies it into
+        // target and presents it. Returns false if there is no frame or
+        // target can't be locked; the frame is dropped either way. With a
+        // capture open, the back buffer is then handed to it and gets a
+        // free capture buffer in its place.
+        bool PresentOldest(RenderTarget &target, FrameCapture *capture = nullptr);
+
+    private:
+        struct BackBuffer {
+            std::unique_ptr<MemoryRenderTarget> target;
+            CameraPose pose;
+        };
+
+        void DrawLoop();
+
+        std::vector<BackBuffer> m_buffers;
+        DrawFunction m_draw;
+
+        std::mutex m_mutex;
+        std::condition_variable m_frameSubmitted;
+        std::condition_variable m_frameDrawn;
+        std::condition_variable m_bufferFreed;
+
+        // Buffer indices in each stage, oldest first. A buffer being drawn
+        // or presented is in none of them.
+        std::deque<int> m_free;
+        std::deque<int> m_toDraw;
+        std::deque<int> m_drawn;
+        int m_drawing;
+        bool m_stopping;
+
+        std::thread m_drawThread;
+    };
+}
+
+#endif // FRAME_PIPELINE_HPP
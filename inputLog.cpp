@@ -0,0 +1,189 @@
+#include "inputLog.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace Raycaster;
+
+namespace
+{
+    const char LOG_MAGIC[4] = {'R', 'C', 'I', 'N'};
+    const std::uint32_t LOG_VERSION{1};
+    const std::size_t LOG_HEADER_SIZE{80};
+    // Varints longer than this don't fit a 64-bit run length
+    const int MAX_VARINT_BYTES{10};
+    // Longest session and fastest tick rate a log may hold, so a corrupt
+    // header can't make Load() allocate gigabytes: at most 43 MB of ticks
+    const std::uint64_t MAX_LOG_SECONDS{12 * 60 * 60};
+    const std::uint32_t MAX_TICK_RATE{1000};
+
+    bool IsValidLength(const std::uint32_t tickRate, const std::uint64_t tickCount) noexcept
+    {
+        return tickRate && tickRate <= MAX_TICK_RATE && tickCount <= MAX_LOG_SECONDS * tickRate;
+    }
+
+    std::uint64_t ReadUint(const unsigned char *bytes, const int size) noexcept
+    {
+        std::uint64_t value{0};
+        for (int i{0}; i < size; i++) {
+            value |= static_cast<std::uint64_t>(bytes[i]) << (i * 8);
+        }
+        return value;
+    }
+
+    void WriteUint(unsigned char *bytes, const std::uint64_t value, const int size) noexcept
+    {
+        for (int i{0}; i < size; i++) {
+            bytes[i] = (value >> (i * 8)) & 0xFF;
+        }
+    }
+
+    double ReadDouble(const unsigned char *bytes) noexcept
+    {
+        const std::uint64_t bits = ReadUint(bytes, 8);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void WriteDouble(unsigned char *bytes, const double value) noexcept
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        WriteUint(bytes, bits, 8);
+    }
+
+    void WriteRun(std::vector<unsigned char> &bytes, const std::uint8_t buttons, std::uint64_t length)
+    {
+        bytes.push_back(buttons);
+
+        do {
+            const unsigned char low = length & 0x7F;
+            length >>= 7;
+            bytes.push_back(length ? (low | 0x80) : low);
+        } while (length);
+    }
+}
+
+InputLog::InputLog() :
+    m_header{0, 0, 0, 0, 0, {}}
+{
+
+}
+
+void InputLog::Reset(const InputLogHeader &header)
+{
+    m_header = header;
+    m_ticks.clear();
+}
+
+bool InputLog::Save(const std::string &path) const
+{
+    // Load() would refuse it
+    if (!IsValidLength(m_header.tickRate, m_ticks.size())) {
+        return false;
+    }
+
+    std::vector<unsigned char> bytes(LOG_HEADER_SIZE, 0);
+    std::memcpy(bytes.data(), LOG_MAGIC, sizeof(LOG_MAGIC));
+    WriteUint(&bytes[4], LOG_VERSION, 4);
+    WriteUint(&bytes[8], m_header.tickRate, 4);
+    WriteUint(&bytes[12], m_header.flags, 4);
+    WriteUint(&bytes[16], m_header.mapColumns, 4);
+    WriteUint(&bytes[20], m_header.mapRows, 4);
+    WriteUint(&bytes[24], m_header.mapHash, 4);
+    WriteUint(&bytes[28], m_ticks.size(), 4);
+
+    const double pose[6] = {
+        m_header.start.position.x, m_header.start.position.y,
+        m_header.start.direction.x, m_header.start.direction.y,
+        m_header.start.plane.x, m_header.start.plane.y
+    };
+    for (int i{0}; i < 6; i++) {
+        WriteDouble(&bytes[32 + i * 8], pose[i]);
+    }
+
+    for (std::size_t tick{0}; tick < m_ticks.size();) {
+        std::size_t end = tick + 1;
+        while (end < m_ticks.size() && m_ticks[end] == m_ticks[tick]) {
+            end++;
+        }
+
+        WriteRun(bytes, m_ticks[tick], end - tick);
+        tick = end;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    return static_cast<bool>(file);
+}
+
+bool InputLog::Load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    const std::vector<unsigned char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    if (bytes.size() < LOG_HEADER_SIZE || std::memcmp(bytes.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) ||
+        ReadUint(&bytes[4], 4) != LOG_VERSION) {
+        return false;
+    }
+
+    InputLogHeader header;
+    header.tickRate = static_cast<std::uint32_t>(ReadUint(&bytes[8], 4));
+    header.flags = static_cast<std::uint32_t>(ReadUint(&bytes[12], 4));
+    header.mapColumns = static_cast<std::uint32_t>(ReadUint(&bytes[16], 4));
+    header.mapRows = static_cast<std::uint32_t>(ReadUint(&bytes[20], 4));
+    header.mapHash = static_cast<std::uint32_t>(ReadUint(&bytes[24], 4));
+    const std::uint64_t tickCount = ReadUint(&bytes[28], 4);
+    header.start = {{ReadDouble(&bytes[32]), ReadDouble(&bytes[40])},
+                    {ReadDouble(&bytes[48]), ReadDouble(&bytes[56])},
+                    {ReadDouble(&bytes[64]), ReadDouble(&bytes[72])}};
+
+    if (!IsValidLength(header.tickRate, tickCount)) {
+        return false;
+    }
+
+    // Grown by the runs rather than reserved from the header's count, so a
+    // short file takes no more than it holds
+    std::vector<std::uint8_t> ticks;
+
+    for (std::size_t i{LOG_HEADER_SIZE}; i < bytes.size();) {
+        const std::uint8_t buttons = bytes[i++];
+        std::uint64_t length{0};
+        int shift{0};
+
+        while (true) {
+            if (i >= bytes.size() || shift >= 7 * MAX_VARINT_BYTES) {
+                return false;
+            }
+
+            const unsigned char byte = bytes[i++];
+            length |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+
+        // Runs can't add up to more ticks than the header says
+        if (length > tickCount - ticks.size()) {
+            return false;
+        }
+        ticks.insert(ticks.end(), length, buttons);
+    }
+
+    if (ticks.size() != tickCount) {
+        return false;
+    }
+
+    m_header = header;
+    m_ticks.swap(ticks);
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef INPUT_LOG_HPP
+#define INPUT_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rayCast.hpp"
+
+namespace Raycaster
+{
+    // Buttons held during a simulation tick, one bit each
+    enum InputButton {
+        INPUT_FORWARD = 1 << 0,
+        INPUT_BACKWARD = 1 << 1,
+        INPUT_STRAFE_LEFT = 1 << 2,
+        INPUT_STRAFE_RIGHT = 1 << 3,
+        INPUT_TURN_LEFT = 1 << 4,
+        INPUT_TURN_RIGHT = 1 << 5
+    };
+
+    enum InputLogFlag {
+        INPUT_LOG_CAMERA_ROTATION = 1 << 0
+    };
+
+    // What a recording depends on besides its input
+    struct InputLogHeader {
+        std::uint32_t tickRate;
+        std::uint32_t flags;
+        std::uint32_t mapColumns;
+        std::uint32_t mapRows;
+        // FNV-1a of the map cells, so a replay on another map is caught
+        std::uint32_t mapHash;
+        CameraPose start;
+    };
+
+    // The buttons held on every tick of a session. The simulation only
+    // depends on these and the header, so replaying them from the same
+    // start reproduces the session exactly.
+    //
+    // Files hold a header of 80 bytes, fields little-endian:
+    //
+    //     0   magic "RCIN"
+    //     4   version (1)
+    //     8   tick rate
+    //     12  flags
+    //     16  map columns
+    //     20  map rows
+    //     24  map hash
+    //     28  ticks
+    //     32  start position, direction and camera plane, as 6 doubles
+    //
+    // followed by runs of ticks holding the same buttons: a byte of button
+    // bits and the length of the run as an unsigned LEB128 varint. Buttons
+    // are held for many ticks at a time, so a session takes a few bytes per
+    // key press. Logs hold at most 12 hours at up to 1000 ticks a second.
+    class InputLog
+    {
+    public:
+        InputLog();
+
+        // Empties the log for a new recording
+        void Reset(const InputLogHeader &header);
+        const InputLogHeader& GetHeader() const noexcept { return m_header; }
+
+        void Append(const std::uint8_t buttons) { m_ticks.push_back(buttons); }
+        std::size_t GetTickCount() const noexcept { return m_ticks.size(); }
+        std::uint8_t GetButtons(const std::size_t tick) const noexcept { return m_ticks[tick]; }
+
+        bool Save(const std::string &path) const;
+        // The log is unchanged if loading fails
+        bool Load(const std::string &path);
+
+    private:
+        InputLogHeader m_header;
+        std::vector<std::uint8_t> m_ticks;
+    };
+}
+
+#endif // INPUT_LOG_HPP
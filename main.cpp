@@ -1,11 +1,73 @@
 #include <SDL.h>
+#include <cstring>
 #include <iostream>
 #include "raycasterEngine.hpp"
 
 int main(int argc, char *argv[])
 {
+    const char *mapPath = nullptr;
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    const char *capturePath = nullptr;
+    Raycaster::CaptureSettings captureSettings = Raycaster::DEFAULT_CAPTURE_SETTINGS;
+    bool interlace{false};
+
+    for (int i{1}; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--record") && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--capture") && i + 1 < argc) {
+            capturePath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--capture-block")) {
+            captureSettings.policy = Raycaster::CapturePolicy::BLOCK;
+        } else if (!std::strcmp(argv[i], "--interlace")) {
+            interlace = true;
+        } else if (!mapPath && argv[i][0] != '-') {
+            mapPath = argv[i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [map] [--record file | --replay file] [--interlace]"
+                      << " [--capture file|-|'|command' [--capture-block]]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Frames captured to standard output would be mixed with the engine's
+    // messages, so they go to standard error, before the engine prints any
+    if (capturePath && !std::strcmp(capturePath, "-")) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
     Raycaster::RaycasterEngine engine;
+    engine.SetInterlacing(interlace);
+
+    // Optional map file, otherwise the built-in map is used
+    if (mapPath && !engine.LoadMap(mapPath)) {
+        return 1;
+    }
+
     engine.Init();
+
+    // Replays must run on the map they were recorded on
+    if ((replayPath && !engine.LoadReplay(replayPath)) || (recordPath && !engine.StartRecording(recordPath))) {
+        std::cerr << "Error opening input log " << (replayPath ? replayPath : recordPath) << std::endl;
+        engine.Cleanup();
+        return 1;
+    }
+
+    // Raw RGBA for .rgba files, Y4M for anything else, pipes included
+    if (capturePath) {
+        const std::size_t length = std::strlen(capturePath);
+        const bool isRGBA = length >= 5 && !std::strcmp(capturePath + length - 5, ".rgba");
+        captureSettings.format = isRGBA ? Raycaster::CaptureFormat::RGBA : Raycaster::CaptureFormat::Y4M;
+
+        if (!engine.StartCapture(capturePath, captureSettings)) {
+            std::cerr << "Error opening capture output " << capturePath << std::endl;
+            engine.Cleanup();
+            return 1;
+        }
+    }
+
     engine.Run();
     engine.Cleanup();
     
@@ -0,0 +1,33 @@
+// Map converter
+//
+// Converts a text map to the binary map format, which the engine loads by
+// memory-mapping it. Also accepts a binary map, e.g. to check that it loads.
+
+#include <iostream>
+
+#include "worldMap.hpp"
+
+using namespace Raycaster;
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input map> <output binary map>" << std::endl;
+        return 1;
+    }
+
+    WorldMap map;
+
+    if (!map.Load(argv[1])) {
+        std::cerr << "Error loading map " << argv[1] << std::endl;
+        return 1;
+    }
+
+    if (!map.SaveBinary(argv[2])) {
+        std::cerr << "Error writing map " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::cout << map.GetColumns() << "x" << map.GetRows() << " map written to " << argv[2] << std::endl;
+    return 0;
+}
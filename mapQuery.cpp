@@ -0,0 +1,238 @@
+#include "mapQuery.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Raycaster;
+
+namespace
+{
+    const double NO_CONTACT{std::numeric_limits<double>::infinity()};
+    // Circles stop this far short of a wall, in map cells, so a stopped
+    // circle isn't left overlapping it by rounding
+    const double SWEEP_SKIN{1e-6};
+
+    // Cells outside the map, border included, read as walls
+    inline int GetCell(const MapView &map, const int x, const int y) noexcept
+    {
+        if (x < 0 || y < 0 || x >= map.columns || y >= map.rows) {
+            return 1;
+        }
+
+        return map.cells[x * map.stride + y];
+    }
+
+    inline int GetCell(const MapView &map, const Point<double> position) noexcept
+    {
+        return GetCell(map, static_cast<int>(std::floor(position.x)), static_cast<int>(std::floor(position.y)));
+    }
+
+    inline double GetLength(const Point<double> vector) noexcept
+    {
+        return std::sqrt(vector.x * vector.x + vector.y * vector.y);
+    }
+
+    // Wall the query starts in, at distance 0
+    RayQueryHit GetStartHit(const MapView &map, const Point<double> origin) noexcept
+    {
+        const int cellX = static_cast<int>(std::floor(origin.x));
+        const int cellY = static_cast<int>(std::floor(origin.y));
+
+        return {true, cellX, cellY, GetCell(map, cellX, cellY), false, 0, origin};
+    }
+
+    // Earliest part of movement, 0 to 1, after which a circle at start
+    // touches the square of cell (cellX, cellY), or NO_CONTACT. The circle
+    // touches when its centre enters the square grown by the radius with
+    // rounded corners: the slabs of the grown square give the entry, unless
+    // it is past a corner, where the corner's circle decides.
+    double GetContactTime(const Point<double> start, const Point<double> movement, const double radius,
+                          const int cellX, const int cellY, Point<double> &normal) noexcept
+    {
+        const Point<double> nearest{std::min(std::max(start.x, static_cast<double>(cellX)), cellX + 1.0),
+                                    std::min(std::max(start.y, static_cast<double>(cellY)), cellY + 1.0)};
+        const Point<double> offset{start.x - nearest.x, start.y - nearest.y};
+        const double offsetLength = GetLength(offset);
+
+        if (offsetLength < radius) {
+            // Already touching; only movement further in is stopped
+            if (offset.x * movement.x + offset.y * movement.y >= 0 || !offsetLength) {
+                return NO_CONTACT;
+            }
+
+            normal = {offset.x / offsetLength, offset.y / offsetLength};
+            return 0;
+        }
+
+        double enter{0};
+        double exit{1};
+        Point<double> enterNormal{0, 0};
+        const double starts[2] = {start.x, start.y};
+        const double movements[2] = {movement.x, movement.y};
+        const int cells[2] = {cellX, cellY};
+
+        for (int axis{0}; axis < 2; axis++) {
+            const double low = cells[axis] - radius;
+            const double high = cells[axis] + 1 + radius;
+
+            if (!movements[axis]) {
+                if (starts[axis] < low || starts[axis] > high) {
+                    return NO_CONTACT;
+                }
+                continue;
+            }
+
+            const double lowTime = (low - starts[axis]) / movements[axis];
+            const double highTime = (high - starts[axis]) / movements[axis];
+            const double axisEnter = std::min(lowTime, highTime);
+
+            if (axisEnter > enter) {
+                enter = axisEnter;
+                enterNormal = axis ? Point<double>{0, movements[axis] > 0 ? -1.0 : 1.0}
+                                   : Point<double>{movements[axis] > 0 ? -1.0 : 1.0, 0};
+            }
+            exit = std::min(exit, std::max(lowTime, highTime));
+        }
+
+        if (enter > exit) {
+            return NO_CONTACT;
+        }
+
+        const Point<double> centre{start.x + enter * movement.x, start.y + enter * movement.y};
+        const bool pastX = centre.x < cellX || centre.x > cellX + 1;
+        const bool pastY = centre.y < cellY || centre.y > cellY + 1;
+
+        if (!pastX || !pastY) {
+            normal = enterNormal;
+            return enter;
+        }
+
+        // Solve |start + t * movement - corner| = radius for the first t
+        const Point<double> corner{centre.x < cellX ? cellX : cellX + 1.0, centre.y < cellY ? cellY : cellY + 1.0};
+        const Point<double> fromCorner{start.x - corner.x, start.y - corner.y};
+        const double a = movement.x * movement.x + movement.y * movement.y;
+        const double b = fromCorner.x * movement.x + fromCorner.y * movement.y;
+        const double c = fromCorner.x * fromCorner.x + fromCorner.y * fromCorner.y - radius * radius;
+        const double discriminant = b * b - a * c;
+
+        if (discriminant < 0 || !a) {
+            return NO_CONTACT;
+        }
+
+        const double time = (-b - std::sqrt(discriminant)) / a;
+        if (time < 0 || time > 1) {
+            return NO_CONTACT;
+        }
+
+        normal = {(fromCorner.x + time * movement.x) / radius, (fromCorner.y + time * movement.y) / radius};
+        return time;
+    }
+
+    SweepResult SweepCircle(const MapView &map, const SweepQuery &query) noexcept
+    {
+        SweepResult result{false, 1, {query.position.x + query.movement.x, query.position.y + query.movement.y}, {0, 0}, 0, 0};
+
+        const Point<double> start = query.position;
+        if (GetCell(map, start)) {
+            return {true, 0, start, {0, 0}, static_cast<int>(std::floor(start.x)), static_cast<int>(std::floor(start.y))};
+        }
+
+        // A wall touched at some point of the movement is within reach of
+        // the cell the centre is in at that point, so walking the centre's
+        // cells and testing the walls in reach of each finds every contact.
+        // The walk stops at the first cell entered after the earliest
+        // contact found so far.
+        const double radius = std::max(query.radius, 0.0);
+        const int reach = static_cast<int>(std::ceil(radius));
+        double firstContact{NO_CONTACT};
+        RayWalker walker(start, query.movement);
+        double cellEnter{0};
+
+        while (cellEnter <= std::min(firstContact, 1.0)) {
+            const int centreX = walker.GetCellX();
+            const int centreY = walker.GetCellY();
+
+            for (int x{centreX - reach}; x <= centreX + reach; x++) {
+                for (int y{centreY - reach}; y <= centreY + reach; y++) {
+                    Point<double> normal;
+
+                    if (GetCell(map, x, y)) {
+                        const double time = GetContactTime(start, query.movement, radius, x, y, normal);
+
+                        if (time < firstContact) {
+                            firstContact = time;
+                            result.normal = normal;
+                            result.cellX = x;
+                            result.cellY = y;
+                        }
+                    }
+                }
+            }
+
+            cellEnter = walker.GetNextDistance();
+            walker.Step();
+        }
+
+        if (firstContact <= 1) {
+            const double length = GetLength(query.movement);
+            const double fraction = length ? std::max(0.0, firstContact - SWEEP_SKIN / length) : 0;
+
+            result.hit = true;
+            result.fraction = fraction;
+            result.position = {start.x + fraction * query.movement.x, start.y + fraction * query.movement.y};
+        }
+
+        return result;
+    }
+}
+
+void Raycaster::CastRays(const MapView &map, const RayQuery *queries, const int count, RayQueryHit *hits) noexcept
+{
+    for (int i{0}; i < count; i++) {
+        const RayQuery &query = queries[i];
+        RayQueryHit &result = hits[i];
+
+        if (GetCell(map, query.origin)) {
+            result = GetStartHit(map, query.origin);
+            continue;
+        }
+
+        // The DDA measures in lengths of the direction
+        const double length = GetLength(query.direction);
+        RayHit hit;
+
+        if (!length || !CastRayWithin(map, query.origin, query.direction, query.maxDistance / length, hit)) {
+            result = {false, 0, 0, 0, false, query.maxDistance, {0, 0}};
+            continue;
+        }
+
+        result.hit = true;
+        result.cellX = hit.cellX;
+        result.cellY = hit.cellY;
+        result.cellValue = hit.cellValue;
+        result.sideHit = hit.sideHit;
+        result.distance = hit.perpWallDistance * length;
+        result.point = {query.origin.x + hit.perpWallDistance * query.direction.x,
+                        query.origin.y + hit.perpWallDistance * query.direction.y};
+    }
+}
+
+void Raycaster::TestLineOfSight(const MapView &map, const SightQuery *queries, const int count, std::uint8_t *visible) noexcept
+{
+    for (int i{0}; i < count; i++) {
+        const SightQuery &query = queries[i];
+        RayHit hit;
+
+        // Along from - to, the target is one length of the direction away
+        visible[i] = !GetCell(map, query.from) &&
+                     !CastRayWithin(map, query.from, {query.to.x - query.from.x, query.to.y - query.from.y}, 1, hit);
+    }
+}
+
+void Raycaster::SweepCircles(const MapView &map, const SweepQuery *queries, const int count, SweepResult *results) noexcept
+{
+    for (int i{0}; i < count; i++) {
+        results[i] = SweepCircle(map, queries[i]);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef MAP_QUERY_HPP
+#define MAP_QUERY_HPP
+
+#include <cstdint>
+
+#include "point.hpp"
+#include "rayCast.hpp"
+
+namespace Raycaster
+{
+    // Visibility and collision queries against a map for game logic, traced
+    // with the same DDA as the rendered rays. Each takes an array of queries
+    // and writes one result per query, so a batch can be split into ranges
+    // and answered on several threads; RaycasterEngine does so with its
+    // thread pool. Positions outside the map, or inside a wall, are treated
+    // as blocked.
+
+    struct RayQuery {
+        Point<double> origin;
+        // Needn't be normalised; distances are in map cells regardless
+        Point<double> direction;
+        // Walls further away than this are not reported
+        double maxDistance;
+    };
+
+    struct RayQueryHit {
+        bool hit;
+        int cellX;
+        int cellY;
+        int cellValue;
+        bool sideHit;
+        // Distance from the origin to the wall, in map cells
+        double distance;
+        Point<double> point;
+    };
+
+    // Whether a wall lies between two points
+    struct SightQuery {
+        Point<double> from;
+        Point<double> to;
+    };
+
+    // Circle moved in a straight line from position by movement
+    struct SweepQuery {
+        Point<double> position;
+        Point<double> movement;
+        double radius;
+    };
+
+    struct SweepResult {
+        // Whether the circle touched a wall before the end of the movement
+        bool hit;
+        // Part of the movement made before touching, 0 to 1
+        double fraction;
+        // Where the circle stops
+        Point<double> position;
+        // Unit normal of the wall surface touched, pointing at the circle
+        Point<double> normal;
+        int cellX;
+        int cellY;
+    };
+
+    void CastRays(const MapView &map, const RayQuery *queries, const int count, RayQueryHit *hits) noexcept;
+
+    // Writes 1 where the points can see each other and 0 where they can't
+    void TestLineOfSight(const MapView &map, const SightQuery *queries, const int count, std::uint8_t *visible) noexcept;
+
+    // Stops each circle where it first touches a wall. A circle that starts
+    // overlapping a wall can still move away from it, so movers pushed into
+    // a wall by rounding don't get stuck.
+    void SweepCircles(const MapView &map, const SweepQuery *queries, const int count, SweepResult *results) noexcept;
+}
+
+#endif // MAP_QUERY_HPP
@@ -0,0 +1,37 @@
+#ifndef POINT_HPP
+#define POINT_HPP
+
+#include <cmath>
+
+namespace Raycaster
+{
+    template <typename T>
+    struct Point {
+        T x;
+        T y;
+    };
+
+    // Rotation matrix for a fixed angle, so rotating by it needs no trig
+    struct Rotation {
+        double cosine;
+        double sine;
+    };
+
+    inline Rotation MakeRotation(const double angle) noexcept
+    {
+        return {std::cos(angle), std::sin(angle)};
+    }
+
+    // Same angle in the other direction
+    inline Rotation InvertRotation(const Rotation rotation) noexcept
+    {
+        return {rotation.cosine, -rotation.sine};
+    }
+
+    inline Point<double> Rotate(const Point<double> point, const Rotation rotation) noexcept
+    {
+        return {point.x * rotation.cosine - point.y * rotation.sine, point.x * rotation.sine + point.y * rotation.cosine};
+    }
+}
+
+#endif // POINT_HPP
@@ -0,0 +1,265 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <vector>
+
+using namespace Raycaster;
+
+namespace
+{
+    const char *const STAGE_NAMES[PROFILE_STAGES] = {
+        "frame", "events", "cast", "draw", "floor", "copy", "sprites", "scale", "present", "capture"
+    };
+
+    const std::chrono::steady_clock::time_point PROFILE_ORIGIN = std::chrono::steady_clock::now();
+
+    // Events are kept as two words so a reader can load them while the
+    // owning thread writes: the start time, and the duration shifted left by
+    // 8 bits with the stage in the low byte
+    struct ProfileRing {
+        std::atomic<bool> inUse;
+        // Events ever written. The writer may be overwriting slot
+        // written % PROFILE_RING_CAPACITY, so a reader also drops that one.
+        std::atomic<std::uint64_t> written;
+        std::atomic<std::uint64_t> starts[PROFILE_RING_CAPACITY];
+        std::atomic<std::uint64_t> durations[PROFILE_RING_CAPACITY];
+    };
+
+    std::atomic<ProfileRing*> g_rings[PROFILE_MAX_THREADS];
+    std::atomic<std::uint64_t> g_clearTime{0};
+
+    // Rings outlive their threads and are handed to the next thread that
+    // needs one, so a pool being recreated doesn't use up the slots
+    ProfileRing* ClaimRing() noexcept
+    {
+        for (std::atomic<ProfileRing*> &slot : g_rings) {
+            ProfileRing *ring = slot.load(std::memory_order_acquire);
+            bool expected = false;
+
+            if (ring && ring->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return ring;
+            }
+
+            if (!ring) {
+                std::unique_ptr<ProfileRing> created(new (std::nothrow) ProfileRing);
+                if (!created) {
+                    return nullptr;
+                }
+
+                created->inUse.store(true, std::memory_order_relaxed);
+                created->written.store(0, std::memory_order_relaxed);
+
+                ProfileRing *empty = nullptr;
+                if (slot.compare_exchange_strong(empty, created.get(), std::memory_order_acq_rel)) {
+                    return created.release();
+                }
+            }
+        }
+
+        // More threads than slots; the rest go unrecorded
+        return nullptr;
+    }
+
+    struct RingOwner {
+        ProfileRing *ring;
+        bool claimed;
+
+        ~RingOwner()
+        {
+            if (ring) {
+                ring->inUse.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local RingOwner t_owner{nullptr, false};
+
+    struct ProfileEvent {
+        int thread;
+        ProfileStage stage;
+        std::uint64_t start;
+        std::uint64_t duration;
+    };
+
+    // Copies the events each ring still holds, oldest first per thread
+    std::vector<ProfileEvent> ReadEvents()
+    {
+        std::vector<ProfileEvent> events;
+        const std::uint64_t clearTime = g_clearTime.load(std::memory_order_relaxed);
+
+        for (int thread{0}; thread < PROFILE_MAX_THREADS; thread++) {
+            const ProfileRing *ring = g_rings[thread].load(std::memory_order_acquire);
+            if (!ring) {
+                continue;
+            }
+
+            const std::uint64_t written = ring->written.load(std::memory_order_acquire);
+            const std::uint64_t first = (written > PROFILE_RING_CAPACITY) ? written - PROFILE_RING_CAPACITY : 0;
+            const std::size_t begin = events.size();
+
+            for (std::uint64_t i{first}; i < written; i++) {
+                const std::uint64_t start = ring->starts[i % PROFILE_RING_CAPACITY].load(std::memory_order_relaxed);
+                const std::uint64_t packed = ring->durations[i % PROFILE_RING_CAPACITY].load(std::memory_order_relaxed);
+                events.push_back({thread, static_cast<ProfileStage>(packed & 0xFF), start, packed >> 8});
+            }
+
+            // Events the writer got to while they were being copied are torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const std::uint64_t rewritten = ring->written.load(std::memory_order_relaxed);
+            const std::uint64_t valid = (rewritten + 1 > PROFILE_RING_CAPACITY) ? rewritten + 1 - PROFILE_RING_CAPACITY : 0;
+            const std::size_t torn = static_cast<std::size_t>(std::min(written, std::max(valid, first)) - first);
+
+            events.erase(events.begin() + begin, events.begin() + begin + torn);
+        }
+
+        events.erase(std::remove_if(events.begin(), events.end(), [clearTime](const ProfileEvent &event) {
+            return event.start < clearTime || static_cast<int>(event.stage) >= PROFILE_STAGES;
+        }), events.end());
+
+        return events;
+    }
+
+    double ToMilliseconds(const std::uint64_t nanoseconds) noexcept
+    {
+        return nanoseconds / 1000000.0;
+    }
+
+    double ToMicroseconds(const std::uint64_t nanoseconds) noexcept
+    {
+        return nanoseconds / 1000.0;
+    }
+}
+
+const char* Raycaster::GetProfileStageName(const ProfileStage stage) noexcept
+{
+    const int index = static_cast<int>(stage);
+    return (index >= 0 && index < PROFILE_STAGES) ? STAGE_NAMES[index] : "unknown";
+}
+
+std::uint64_t Raycaster::GetProfileTime() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - PROFILE_ORIGIN).count();
+}
+
+void Raycaster::RecordProfileEvent(const ProfileStage stage, const std::uint64_t start, const std::uint64_t end) noexcept
+{
+    RingOwner &owner = t_owner;
+
+    if (!owner.claimed) {
+        owner.ring = ClaimRing();
+        owner.claimed = true;
+    }
+
+    ProfileRing *ring = owner.ring;
+    if (!ring) {
+        return;
+    }
+
+    // Only this thread writes the ring. The fence orders the writes below
+    // after the count that marks the slot as in use, for readers.
+    const std::uint64_t index = ring->written.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ring->starts[index % PROFILE_RING_CAPACITY].store(start, std::memory_order_relaxed);
+    ring->durations[index % PROFILE_RING_CAPACITY].store(((end - start) << 8) | static_cast<std::uint64_t>(stage), std::memory_order_relaxed);
+    ring->written.store(index + 1, std::memory_order_release);
+}
+
+void Raycaster::ClearProfile() noexcept
+{
+    g_clearTime.store(GetProfileTime(), std::memory_order_relaxed);
+}
+
+ProfileStats Raycaster::GetProfileStats(const ProfileStage stage)
+{
+    ProfileStats stats{0, 0, 0, 0, 0, {}};
+    std::vector<std::uint64_t> durations;
+
+    for (const ProfileEvent &event : ReadEvents()) {
+        if (event.stage == stage) {
+            durations.push_back(event.duration);
+        }
+    }
+
+    if (durations.empty()) {
+        return stats;
+    }
+
+    std::sort(durations.begin(), durations.end());
+
+    std::uint64_t total{0};
+    for (const std::uint64_t duration : durations) {
+        int bucket{0};
+        while (bucket + 1 < PROFILE_HISTOGRAM_BUCKETS && (duration >> (bucket + 1))) {
+            bucket++;
+        }
+
+        stats.histogram[bucket]++;
+        total += duration;
+    }
+
+    const std::size_t count = durations.size();
+    stats.count = count;
+    stats.meanMs = ToMilliseconds(total) / count;
+    stats.p50Ms = ToMilliseconds(durations[(count - 1) * 50 / 100]);
+    stats.p99Ms = ToMilliseconds(durations[(count - 1) * 99 / 100]);
+    stats.maxMs = ToMilliseconds(durations.back());
+    return stats;
+}
+
+bool Raycaster::WriteProfileTrace(const std::string &path)
+{
+    std::vector<ProfileEvent> events = ReadEvents();
+    std::sort(events.begin(), events.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+        return a.start < b.start;
+    });
+
+    std::ofstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    file << "{\"traceEvents\":[";
+
+    for (std::size_t i{0}; i < events.size(); i++) {
+        const ProfileEvent &event = events[i];
+        file << (i ? ",\n" : "\n")
+             << "{\"name\":\"" << GetProfileStageName(event.stage) << "\",\"cat\":\"raycaster\",\"ph\":\"X\""
+             << ",\"ts\":" << ToMicroseconds(event.start) << ",\"dur\":" << ToMicroseconds(event.duration)
+             << ",\"pid\":1,\"tid\":" << event.thread << "}";
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(file);
+}
+
+bool Raycaster::WriteProfileCsv(const std::string &path)
+{
+    std::vector<ProfileEvent> events = ReadEvents();
+    std::sort(events.begin(), events.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+        return a.start < b.start;
+    });
+
+    std::ofstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    file << "thread,stage,start_us,duration_us\n";
+
+    for (const ProfileEvent &event : events) {
+        file << event.thread << "," << GetProfileStageName(event.stage) << ","
+             << ToMicroseconds(event.start) << "," << ToMicroseconds(event.duration) << "\n";
+    }
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,94 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace Raycaster
+{
+    // Hot-path profiler. Build with RAYCASTER_PROFILING defined to record
+    // PROFILE_SCOPE() timings; without it the scopes compile to nothing and
+    // the queries below report no events.
+    //
+    // Each thread records into a ring buffer of its own holding its last
+    // PROFILE_RING_CAPACITY events, so recording takes no lock and never
+    // allocates after a thread's first event. Stats and exports read a
+    // snapshot of every ring, which can run while threads keep recording.
+    enum class ProfileStage {
+        FRAME,
+        EVENTS,
+        CAST,
+        DRAW,
+        FLOOR,
+        COPY,
+        SPRITES,
+        SCALE,
+        PRESENT,
+        CAPTURE,
+        COUNT
+    };
+
+    const int PROFILE_STAGES{static_cast<int>(ProfileStage::COUNT)};
+    const int PROFILE_RING_CAPACITY{4096};
+    const int PROFILE_MAX_THREADS{64};
+    // Bucket i counts durations in [2^i, 2^(i + 1)) nanoseconds
+    const int PROFILE_HISTOGRAM_BUCKETS{32};
+
+    // Over the events still held in the rings, i.e. a rolling window
+    struct ProfileStats {
+        std::uint64_t count;
+        double meanMs;
+        double p50Ms;
+        double p99Ms;
+        double maxMs;
+        std::uint32_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+    };
+
+    const char* GetProfileStageName(const ProfileStage stage) noexcept;
+
+    // Nanoseconds since the process started
+    std::uint64_t GetProfileTime() noexcept;
+    void RecordProfileEvent(const ProfileStage stage, const std::uint64_t start, const std::uint64_t end) noexcept;
+
+    // Drops every event recorded so far from stats and exports
+    void ClearProfile() noexcept;
+    ProfileStats GetProfileStats(const ProfileStage stage);
+
+    // Chrome trace event JSON, for chrome://tracing or Perfetto
+    bool WriteProfileTrace(const std::string &path);
+    // One line per event: thread,stage,start_us,duration_us
+    bool WriteProfileCsv(const std::string &path);
+
+    #ifdef RAYCASTER_PROFILING
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(const ProfileStage stage) noexcept :
+            m_stage{stage},
+            m_start{GetProfileTime()}
+        {
+        }
+
+        ~ProfileScope() { RecordProfileEvent(m_stage, m_start, GetProfileTime()); }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        ProfileStage m_stage;
+        std::uint64_t m_start;
+    };
+
+    const bool PROFILING_ENABLED{true};
+
+    #define PROFILE_SCOPE_NAME(line) profileScope##line
+    #define PROFILE_SCOPE_LINE(stage, line) ::Raycaster::ProfileScope PROFILE_SCOPE_NAME(line){::Raycaster::ProfileStage::stage}
+    #define PROFILE_SCOPE(stage) PROFILE_SCOPE_LINE(stage, __LINE__)
+    #else
+    const bool PROFILING_ENABLED{false};
+
+    #define PROFILE_SCOPE(stage) do {} while (false)
+    #endif
+}
+
+#endif // PROFILER_HPP
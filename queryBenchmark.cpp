@@ -0,0 +1,222 @@
+// Map query benchmark
+//
+// Runs batches of random ray casts, line-of-sight tests and circle sweeps
+// over the built-in map and reports queries/sec for each. The answers are
+// checked along the way: rays and sight lines against unlimited CastRay()
+// hits, and sweeps by making sure no circle ends up overlapping a wall it
+// didn't start in, and that circles stopped short are touching one.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "mapQuery.hpp"
+#include "raycasterEngine.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+    // Tolerance for distances compared between differently ordered sums
+    const double EPSILON = 1e-9;
+
+    struct Options {
+        int queries;
+        int batches;
+        int threads;
+        double radius;
+        bool skipEmptySpace;
+    };
+
+    void PrintUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--queries N] [--batches N] [--threads N] [--radius R] [--skip-empty]" << std::endl;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+
+            if (!std::strcmp(argv[i], "--queries") && hasValue) {
+                options.queries = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--batches") && hasValue) {
+                options.batches = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+                options.threads = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--radius") && hasValue) {
+                options.radius = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--skip-empty")) {
+                options.skipEmptySpace = true;
+            } else {
+                return false;
+            }
+        }
+
+        return options.queries > 0 && options.batches > 0 && options.threads >= 0 && options.radius >= 0;
+    }
+
+    double NextUnit(std::uint32_t &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / 16777216.0;
+    }
+
+    // Random point in an open cell, the same ones on every run
+    RaycasterEngine::Point<double> NextOpenPoint(const WorldMap &map, std::uint32_t &state)
+    {
+        while (true) {
+            const double x = NextUnit(state) * map.GetColumns();
+            const double y = NextUnit(state) * map.GetRows();
+
+            if (!map.GetCell(static_cast<int>(x), static_cast<int>(y))) {
+                return {x, y};
+            }
+        }
+    }
+
+    // Distance from a point to the square of a cell
+    double GetCellDistance(const RaycasterEngine::Point<double> point, const int x, const int y)
+    {
+        const double dx = point.x - std::min(std::max(point.x, static_cast<double>(x)), x + 1.0);
+        const double dy = point.y - std::min(std::max(point.y, static_cast<double>(y)), y + 1.0);
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    // A circle must not end up overlapping a wall it didn't start in, and
+    // one that was stopped short must be touching a wall
+    bool IsSweepWrong(const WorldMap &map, const SweepQuery &query, const SweepResult &result)
+    {
+        const int reach = static_cast<int>(std::ceil(query.radius)) + 1;
+        const int centreX = static_cast<int>(std::floor(result.position.x));
+        const int centreY = static_cast<int>(std::floor(result.position.y));
+        bool touching = false;
+
+        for (int x{centreX - reach}; x <= centreX + reach; x++) {
+            for (int y{centreY - reach}; y <= centreY + reach; y++) {
+                if (!map.GetCell(x, y)) {
+                    continue;
+                }
+
+                const double distance = GetCellDistance(result.position, x, y);
+                if (distance < query.radius - EPSILON && GetCellDistance(query.position, x, y) >= query.radius) {
+                    return true;
+                }
+                touching |= distance < query.radius + 1e-5;
+            }
+        }
+
+        return result.hit && !touching;
+    }
+
+    template <typename Function>
+    double TimeBatches(const int batches, const Function &function)
+    {
+        // First batch warms up
+        function();
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int batch{0}; batch < batches; batch++) {
+            function();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options{4096, 50, 1, 0.2, false};
+
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<RaycasterEngine> engine(new RaycasterEngine);
+    engine->InitHeadless();
+    engine->SetRenderThreadCount(options.threads);
+    engine->SetEmptySpaceSkipping(options.skipEmptySpace);
+
+    const WorldMap &map = engine->GetWorldMap();
+    std::uint32_t state{777};
+
+    std::vector<RayQuery> rays;
+    std::vector<SightQuery> sights;
+    std::vector<SweepQuery> sweeps;
+
+    for (int i{0}; i < options.queries; i++) {
+        const RaycasterEngine::Point<double> origin = NextOpenPoint(map, state);
+        const double angle = NextUnit(state) * 2 * PI;
+        // Unnormalised, to check distances come out in map cells
+        const double scale = 0.5 + NextUnit(state) * 2;
+
+        rays.push_back({origin, {std::cos(angle) * scale, std::sin(angle) * scale}, NextUnit(state) * 12});
+        sights.push_back({origin, NextOpenPoint(map, state)});
+        sweeps.push_back({origin, {std::cos(angle) * scale * 2, std::sin(angle) * scale * 2}, options.radius});
+    }
+
+    const bool parallel = options.threads != 1;
+    std::vector<RayQueryHit> hits;
+    std::vector<std::uint8_t> visible;
+    std::vector<SweepResult> results;
+
+    const double rayTime = TimeBatches(options.batches, [&]() { engine->CastRays(rays, hits, parallel); });
+    const double sightTime = TimeBatches(options.batches, [&]() { engine->TestLineOfSight(sights, visible, parallel); });
+    const double sweepTime = TimeBatches(options.batches, [&]() { engine->SweepCircles(sweeps, results, parallel); });
+
+    int mismatches{0};
+    int rayHits{0};
+    int visibleCount{0};
+    int sweepHits{0};
+    const MapView view = map.GetView();
+
+    for (int i{0}; i < options.queries; i++) {
+        // Rays must report the first wall if it is in range
+        const RayHit full = CastRay(view, rays[i].origin, rays[i].direction);
+        const double length = std::sqrt(rays[i].direction.x * rays[i].direction.x + rays[i].direction.y * rays[i].direction.y);
+        const double fullDistance = full.perpWallDistance * length;
+
+        if (hits[i].hit) {
+            rayHits++;
+            mismatches += hits[i].cellX != full.cellX || hits[i].cellY != full.cellY || std::abs(hits[i].distance - fullDistance) > EPSILON;
+        } else {
+            mismatches += fullDistance < rays[i].maxDistance - EPSILON;
+        }
+
+        // Sight lines are blocked by a wall closer than the target
+        const RaycasterEngine::Point<double> toTarget{sights[i].to.x - sights[i].from.x, sights[i].to.y - sights[i].from.y};
+        const RayHit towards = CastRay(view, sights[i].from, toTarget);
+        if (std::abs(towards.perpWallDistance - 1) > EPSILON) {
+            mismatches += visible[i] != (towards.perpWallDistance > 1);
+        }
+        visibleCount += visible[i];
+
+        sweepHits += results[i].hit;
+        mismatches += IsSweepWrong(map, sweeps[i], results[i]);
+    }
+
+    const int threadCount = engine->GetRenderThreadCount();
+    engine->Cleanup();
+
+    const double queryCount = static_cast<double>(options.queries) * options.batches;
+
+    std::cout << std::fixed << std::setprecision(0)
+              << "threads " << threadCount << std::endl
+              << "queries " << options.queries << " x " << options.batches << " batches" << std::endl
+              << "rays_per_sec " << queryCount / rayTime << std::endl
+              << "sight_tests_per_sec " << queryCount / sightTime << std::endl
+              << "sweeps_per_sec " << queryCount / sweepTime << std::endl
+              << "ray_hits " << rayHits << std::endl
+              << "visible " << visibleCount << std::endl
+              << "sweep_hits " << sweepHits << std::endl
+              << "mismatches " << mismatches << std::endl;
+
+    return mismatches ? 1 : 0;
+}
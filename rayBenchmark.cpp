@@ -0,0 +1,205 @@
+// Ray cast benchmark
+//
+// Measures the cost per ray of the cast kernels against view distance, with
+// and without the empty-space distance field. Each map is a square room
+// holding the same grid of pillars at every size; rays are cast from random
+// open points in random directions, so the mean ray length grows with the
+// room size. Every hit cast with the distance field is compared with the
+// plain DDA hit.
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "rayCast.hpp"
+#include "worldMap.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    const int DEFAULT_ROOM_SIZES[] = {16, 64, 256, 1024, 4096};
+    const double CAMERA_PLANE_LENGTH = 0.66;
+    const double PI = 3.14159265358979323846;
+
+    struct Options {
+        int screenWidth;
+        int poses;
+        int pillarsPerSide;
+        CastKernel kernel;
+        std::vector<int> roomSizes;
+    };
+
+    void PrintUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--width N] [--poses N] [--pillars N]"
+                  << " [--kernel auto|scalar|sse2|avx2] [--size N]..." << std::endl;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+
+            if (!std::strcmp(argv[i], "--width") && hasValue) {
+                options.screenWidth = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--poses") && hasValue) {
+                options.poses = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--pillars") && hasValue) {
+                options.pillarsPerSide = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--size") && hasValue) {
+                options.roomSizes.push_back(std::atoi(argv[++i]));
+            } else if (!std::strcmp(argv[i], "--kernel") && hasValue) {
+                const char *name = argv[++i];
+                const CastKernel kernels[] = {CastKernel::AUTO, CastKernel::SCALAR, CastKernel::SSE2, CastKernel::AVX2};
+                bool found = false;
+
+                for (const CastKernel kernel : kernels) {
+                    if (!std::strcmp(name, GetCastKernelName(kernel))) {
+                        options.kernel = kernel;
+                        found = true;
+                    }
+                }
+
+                if (!found || !IsCastKernelSupported(options.kernel)) {
+                    std::cerr << "Unsupported cast kernel: " << name << std::endl;
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+
+        if (options.roomSizes.empty()) {
+            options.roomSizes.assign(std::begin(DEFAULT_ROOM_SIZES), std::end(DEFAULT_ROOM_SIZES));
+        }
+
+        for (const int size : options.roomSizes) {
+            if (size < 2) {
+                return false;
+            }
+        }
+
+        return options.screenWidth > 0 && options.poses > 0 && options.pillarsPerSide >= 0;
+    }
+
+    // Small deterministic generator so every run casts the same rays
+    double NextRandom(std::uint64_t &state)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (state >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Room of size x size cells with pillarsPerSide x pillarsPerSide evenly
+    // spaced single-cell pillars
+    void BuildRoom(WorldMap &map, const int size, const int pillarsPerSide)
+    {
+        map.Create(size, size);
+
+        for (int i{0}; i < pillarsPerSide; i++) {
+            for (int j{0}; j < pillarsPerSide; j++) {
+                const int x = (2 * i + 1) * size / (2 * pillarsPerSide);
+                const int y = (2 * j + 1) * size / (2 * pillarsPerSide);
+                map.SetCell(x, y, 1 + (i + j) % 3);
+            }
+        }
+    }
+
+    std::vector<CameraPose> GeneratePoses(const WorldMap &map, const int count)
+    {
+        std::vector<CameraPose> poses;
+        std::uint64_t state{0x853c49e6748fea9bULL};
+
+        while (static_cast<int>(poses.size()) < count) {
+            const Point<double> position{NextRandom(state) * map.GetColumns(), NextRandom(state) * map.GetRows()};
+            const double angle = NextRandom(state) * 2 * PI;
+            const Point<double> direction{std::cos(angle), std::sin(angle)};
+
+            if (!map.GetCell(static_cast<int>(position.x), static_cast<int>(position.y))) {
+                poses.push_back({position, direction, {direction.y * CAMERA_PLANE_LENGTH, -direction.x * CAMERA_PLANE_LENGTH}});
+            }
+        }
+
+        return poses;
+    }
+
+    // Casts every pose once and returns the time per ray in nanoseconds
+    double CastPoses(const CastKernel kernel, const MapView &map, const std::vector<CameraPose> &poses,
+                     const int screenWidth, std::vector<RayHit> &hits)
+    {
+        RayTable table{0, {}};
+        UpdateRayTable(table, screenWidth);
+        hits.resize(poses.size() * screenWidth);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i{0}; i < poses.size(); i++) {
+            CastColumns(kernel, map, poses[i], table, 0, screenWidth, &hits[i * screenWidth]);
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() / hits.size();
+    }
+
+    bool IsSameHit(const RayHit &a, const RayHit &b)
+    {
+        return a.cellX == b.cellX && a.cellY == b.cellY && a.cellValue == b.cellValue && a.sideHit == b.sideHit &&
+               !std::memcmp(&a.perpWallDistance, &b.perpWallDistance, sizeof(double)) &&
+               !std::memcmp(&a.wallX, &b.wallX, sizeof(double));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options{800, 200, 6, CastKernel::AUTO, {}};
+
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const CastKernel kernel = (options.kernel == CastKernel::AUTO) ? GetBestCastKernel() : options.kernel;
+    std::cout << "kernel " << GetCastKernelName(kernel) << std::endl
+              << std::setw(8) << "size" << std::setw(14) << "mean_distance"
+              << std::setw(12) << "plain_ns" << std::setw(12) << "skip_ns" << std::setw(10) << "speedup"
+              << std::setw(12) << "mismatches" << std::endl;
+
+    bool allMatch = true;
+
+    for (const int size : options.roomSizes) {
+        WorldMap map;
+        BuildRoom(map, size, options.pillarsPerSide);
+        const std::vector<CameraPose> poses = GeneratePoses(map, options.poses);
+
+        std::vector<RayHit> plainHits;
+        std::vector<RayHit> skipHits;
+
+        // First pass of each warms the caches
+        CastPoses(kernel, map.GetView(), poses, options.screenWidth, plainHits);
+        const double plainTime = CastPoses(kernel, map.GetView(), poses, options.screenWidth, plainHits);
+
+        map.BuildDistanceField();
+        CastPoses(kernel, map.GetView(), poses, options.screenWidth, skipHits);
+        const double skipTime = CastPoses(kernel, map.GetView(), poses, options.screenWidth, skipHits);
+
+        double totalDistance = 0;
+        long mismatches = 0;
+
+        for (std::size_t i{0}; i < plainHits.size(); i++) {
+            totalDistance += plainHits[i].perpWallDistance;
+            mismatches += !IsSameHit(plainHits[i], skipHits[i]);
+        }
+
+        allMatch = allMatch && !mismatches;
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << size << std::setw(14) << totalDistance / plainHits.size()
+                  << std::setw(12) << plainTime << std::setw(12) << skipTime << std::setw(10) << plainTime / skipTime
+                  << std::setw(12) << mismatches << std::endl;
+    }
+
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,811 @@
+#include "rayCast.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+
+#include "chunkedWorld.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RAYCASTER_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace Raycaster;
+
+namespace
+{
+    inline int GetCell(const MapView &map, const int x, const int y) noexcept
+    {
+        return map.cells[x * map.stride + y];
+    }
+
+    inline Point<double> GetColumnRayDirection(const CameraPose &pose, const double cameraOffsetX) noexcept
+    {
+        return {pose.direction.x + pose.plane.x * cameraOffsetX, pose.direction.y + pose.plane.y * cameraOffsetX};
+    }
+
+    // Prepares one axis of the DDA. Every kernel goes through here so the
+    // traversal starts from identical values.
+    inline void SetupAxis(const double position, const double direction,
+                          double &mapCell, double &deltaDistance, double &sideDistance, double &step) noexcept
+    {
+        // Cell on 2D map grid where is the origin of the ray
+        mapCell = static_cast<int>(position);
+
+        // Delta distance is the distance the ray needs to travel to get
+        // from one side to the next side along this axis. Only the ratio
+        // between the axes matters to the DDA, so it is measured in units
+        // of the ray length, which leaves out a sqrt.
+        deltaDistance = std::abs(1 / direction);
+
+        // Distance the ray must travel from its starting position to the
+        // first side, and the direction it travels in (+1 or -1)
+        if (direction < 0) {
+            step = -1;
+            sideDistance = (position - mapCell) * deltaDistance;
+        } else {
+            step = 1;
+            sideDistance = ((mapCell + 1.0f) - position) * deltaDistance;
+        }
+    }
+
+    // Advances a ray to the next cell it enters
+    inline void StepRay(Point<double> &sideDistance, const Point<double> deltaDistance,
+                        Point<double> &mapCell, const Point<double> step, bool &sideHit) noexcept
+    {
+        if (sideDistance.x < sideDistance.y) {
+            sideDistance.x += deltaDistance.x;
+            mapCell.x += step.x;
+            sideHit = false;
+        } else {
+            sideDistance.y += deltaDistance.y;
+            mapCell.y += step.y;
+            sideHit = true;
+        }
+    }
+
+    // Same step without a branch, for runs where the side hit isn't needed.
+    // Adding zero leaves a value unchanged, as side distances are never
+    // negative zero.
+    inline void StepRayBranchless(Point<double> &sideDistance, const Point<double> deltaDistance,
+                                  Point<double> &mapCell, const Point<double> step) noexcept
+    {
+        const bool xSide = sideDistance.x < sideDistance.y;
+
+        sideDistance.x += xSide ? deltaDistance.x : 0.0;
+        sideDistance.y += xSide ? 0.0 : deltaDistance.y;
+        mapCell.x += xSide ? step.x : 0.0;
+        mapCell.y += xSide ? 0.0 : step.y;
+    }
+
+    inline int GetDistance(const MapView &map, const Point<double> mapCell) noexcept
+    {
+        return map.distances[static_cast<int>(mapCell.x) * map.stride + static_cast<int>(mapCell.y)];
+    }
+
+    inline void FinishRay(const Point<double> position, const Point<double> direction, const Point<double> mapCell,
+                          const Point<double> step, const bool sideHit, const int cellValue, RayHit &hit) noexcept
+    {
+        hit.cellX = static_cast<int>(mapCell.x);
+        hit.cellY = static_cast<int>(mapCell.y);
+        hit.cellValue = cellValue;
+        hit.sideHit = sideHit;
+
+        // Check if the ray has hit the side of a wall
+        if (!sideHit) {
+            hit.perpWallDistance = std::abs((mapCell.x - position.x + (1 - step.x) / 2) / direction.x);
+            hit.wallX = position.y + ((mapCell.x - position.x + (1 - step.x) / 2) / direction.x) * direction.y;
+        } else {
+            hit.perpWallDistance = std::abs((mapCell.y - position.y + (1 - step.y) / 2) / direction.y);
+            hit.wallX = position.x + ((mapCell.y - position.y + (1 - step.y) / 2) / direction.y) * direction.x;
+        }
+        hit.wallX -= std::floor(hit.wallX);
+    }
+
+    // Meets the ray with the face of previous's row (or column) of cells
+    // turned towards position. readCell gives -1 for cells it can't read.
+    // Works the distance and wallX out as FinishRay() does, so a ray
+    // that reaches the same cell gets the same hit as a cast.
+    template <typename CellReader>
+    bool ReprojectOntoFace(const CellReader &readCell, const Point<double> position, const Point<double> direction,
+                           const RayHit &previous, RayHit &hit) noexcept
+    {
+        const bool sideHit = previous.sideHit;
+        const double across = sideHit ? position.y : position.x;
+        const double along = sideHit ? position.x : position.y;
+        const double directionAcross = sideHit ? direction.y : direction.x;
+        const double directionAlong = sideHit ? direction.x : direction.y;
+        const int wall = sideHit ? previous.cellY : previous.cellX;
+
+        // The camera is in line with the cells, so sees no face of them
+        double step;
+        if (across < wall) {
+            step = 1;
+        } else if (across >= wall + 1) {
+            step = -1;
+        } else {
+            return false;
+        }
+
+        // Heading away from the face, or too close to parallel to it to
+        // land on a cell that can be read
+        if (directionAcross * step <= 0) {
+            return false;
+        }
+
+        const double distance = (wall - across + (1 - step) / 2) / directionAcross;
+        const double hitAlong = along + distance * directionAlong;
+        const double cellAlong = std::floor(hitAlong);
+
+        if (std::abs(cellAlong) > static_cast<double>(INT_MAX / 2)) {
+            return false;
+        }
+
+        const int cell = static_cast<int>(cellAlong);
+        const int front = wall - static_cast<int>(step);
+        const int cellValue = sideHit ? readCell(cell, wall) : readCell(wall, cell);
+
+        if (cellValue <= 0 || (sideHit ? readCell(cell, front) : readCell(front, cell))) {
+            return false;
+        }
+
+        hit.cellX = sideHit ? cell : wall;
+        hit.cellY = sideHit ? wall : cell;
+        hit.cellValue = cellValue;
+        hit.sideHit = sideHit;
+        hit.perpWallDistance = std::abs(distance);
+        hit.wallX = hitAlong;
+        hit.wallX -= std::floor(hit.wallX);
+        return true;
+    }
+
+    #ifdef RAYCASTER_X86_KERNELS
+    // The packet kernels repeat the scalar arithmetic lane by lane, with the
+    // operations in the same order. IEEE add, mul and div round the
+    // same way in vector and scalar form, so the hits match the scalar kernel
+    // bit for bit. The exception is a build that lets the compiler fuse the
+    // scalar multiply-adds (e.g. -march=native without -ffp-contract=off):
+    // cells and sides still match, distances and wallX within 1 ulp.
+    //
+    // Cells are tracked as their flat index from the first border cell,
+    // (x + border) * stride + y + border, held in a double. It is exact for
+    // any map that fits in memory, a step is a single add, and it is never
+    // negative, so it splits back into x and y by truncation.
+
+    // Lane masks for every combination of 2 lanes, indexed by a bit per lane
+    alignas(16) const std::int64_t PAIR_MASKS[4][2] = {
+        {0, 0}, {-1, 0}, {0, -1}, {-1, -1}
+    };
+
+    // Side distance to the first cell boundary along one axis, for the
+    // cases where the ray travels towards -1 and +1
+    inline void GetFirstSideOffsets(const double position, double &negative, double &positive) noexcept
+    {
+        const double mapCell = static_cast<int>(position);
+
+        negative = position - mapCell;
+        positive = (mapCell + 1.0f) - position;
+    }
+
+    inline const std::uint8_t* GetFirstCell(const MapView &map) noexcept
+    {
+        return map.cells - (map.border * map.stride + map.border);
+    }
+
+    inline const std::uint8_t* GetFirstDistance(const MapView &map) noexcept
+    {
+        return map.distances - (map.border * map.stride + map.border);
+    }
+
+    inline int GetLastCell(const MapView &map) noexcept
+    {
+        return (map.columns + 2 * map.border) * map.stride - 1;
+    }
+
+    inline double GetStartCell(const MapView &map, const Point<double> position) noexcept
+    {
+        return static_cast<double>(static_cast<int>(position.x) + map.border) * map.stride + static_cast<int>(position.y) + map.border;
+    }
+
+    void StoreHits(const MapView &map, const double *cell, const double *mapX, const double *mapY, const double *sideHit,
+                   const double *perpWallDistance, const double *wallX, const int count, RayHit *hits) noexcept
+    {
+        for (int lane{0}; lane < count; lane++) {
+            RayHit &hit = hits[lane];
+            hit.cellX = static_cast<int>(mapX[lane]) - map.border;
+            hit.cellY = static_cast<int>(mapY[lane]) - map.border;
+            hit.cellValue = GetFirstCell(map)[static_cast<int>(cell[lane])];
+            hit.sideHit = sideHit[lane] != 0;
+            hit.perpWallDistance = perpWallDistance[lane];
+            hit.wallX = wallX[lane];
+        }
+    }
+
+    // SSE2 has no blend, gather or floor. Lanes are selected with
+    // and/andnot/or, cells are fetched per lane, and floor is done by
+    // truncation, which is the same thing for the non-negative map
+    // coordinates involved.
+    struct PairSse2 {
+        __m128d directionX, directionY;
+        __m128d deltaX, deltaY;
+        __m128d cellStepX, cellStepY;
+        __m128d cell, sideX, sideY;
+        __m128d hitCell, sideHit, active;
+    };
+
+    __attribute__((target("sse2"), always_inline))
+    inline __m128d SelectSse2(const __m128d mask, const __m128d a, const __m128d b) noexcept
+    {
+        return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    }
+
+    __attribute__((target("sse2"), always_inline))
+    inline __m128d TruncateSse2(const __m128d value) noexcept
+    {
+        return _mm_cvtepi32_pd(_mm_cvttpd_epi32(value));
+    }
+
+    __attribute__((target("sse2"), always_inline))
+    inline void SetupPairSse2(const MapView &map, const CameraPose &pose, const double *cameraOffsets, PairSse2 &ray) noexcept
+    {
+        const __m128d one = _mm_set1_pd(1);
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d signBit = _mm_set1_pd(-0.0);
+
+        const __m128d cameraOffsetX = _mm_loadu_pd(cameraOffsets);
+        ray.directionX = _mm_add_pd(_mm_set1_pd(pose.direction.x), _mm_mul_pd(_mm_set1_pd(pose.plane.x), cameraOffsetX));
+        ray.directionY = _mm_add_pd(_mm_set1_pd(pose.direction.y), _mm_mul_pd(_mm_set1_pd(pose.plane.y), cameraOffsetX));
+
+        ray.deltaX = _mm_andnot_pd(signBit, _mm_div_pd(one, ray.directionX));
+        ray.deltaY = _mm_andnot_pd(signBit, _mm_div_pd(one, ray.directionY));
+
+        Point<double> negative;
+        Point<double> positive;
+        GetFirstSideOffsets(pose.position.x, negative.x, positive.x);
+        GetFirstSideOffsets(pose.position.y, negative.y, positive.y);
+
+        const __m128d negativeX = _mm_cmplt_pd(ray.directionX, zero);
+        const __m128d negativeY = _mm_cmplt_pd(ray.directionY, zero);
+        ray.sideX = _mm_mul_pd(SelectSse2(negativeX, _mm_set1_pd(negative.x), _mm_set1_pd(positive.x)), ray.deltaX);
+        ray.sideY = _mm_mul_pd(SelectSse2(negativeY, _mm_set1_pd(negative.y), _mm_set1_pd(positive.y)), ray.deltaY);
+        ray.cellStepX = SelectSse2(negativeX, _mm_set1_pd(-map.stride), _mm_set1_pd(map.stride));
+        ray.cellStepY = SelectSse2(negativeY, _mm_set1_pd(-1), one);
+
+        ray.cell = _mm_set1_pd(GetStartCell(map, pose.position));
+        ray.hitCell = ray.cell;
+        ray.sideHit = zero;
+        ray.active = _mm_castsi128_pd(_mm_set1_epi32(-1));
+    }
+
+    // Advances every ray by one cell and records the first wall each one hits
+    __attribute__((target("sse2"), always_inline))
+    inline void StepPairSse2(const MapView &map, const int lastCell, PairSse2 &ray) noexcept
+    {
+        const __m128d xSide = _mm_cmplt_pd(ray.sideX, ray.sideY);
+
+        // Adding zero leaves a lane unchanged, as side distances are never
+        // negative zero
+        ray.sideX = _mm_add_pd(ray.sideX, _mm_and_pd(xSide, ray.deltaX));
+        ray.sideY = _mm_add_pd(ray.sideY, _mm_andnot_pd(xSide, ray.deltaY));
+        ray.cell = _mm_add_pd(ray.cell, SelectSse2(xSide, ray.cellStepX, ray.cellStepY));
+
+        const __m128i index = _mm_cvttpd_epi32(ray.cell);
+        const int cell0 = std::min(std::max(_mm_cvtsi128_si32(index), 0), lastCell);
+        const int cell1 = std::min(std::max(_mm_cvtsi128_si32(_mm_shuffle_epi32(index, 1)), 0), lastCell);
+        const std::uint8_t *cells = GetFirstCell(map);
+        const int empty = (cells[cell0] == 0) | ((cells[cell1] == 0) << 1);
+
+        const __m128d emptyMask = _mm_load_pd(reinterpret_cast<const double*>(PAIR_MASKS[empty]));
+        const __m128d wallHit = _mm_andnot_pd(emptyMask, ray.active);
+
+        ray.hitCell = SelectSse2(wallHit, ray.cell, ray.hitCell);
+        ray.sideHit = SelectSse2(wallHit, _mm_xor_pd(xSide, _mm_castsi128_pd(_mm_set1_epi32(-1))), ray.sideHit);
+        ray.active = _mm_and_pd(ray.active, emptyMask);
+    }
+
+    __attribute__((target("sse2"), always_inline))
+    inline void FinishPairSse2(const MapView &map, const CameraPose &pose, const PairSse2 &ray, RayHit *hits) noexcept
+    {
+        const __m128d stride = _mm_set1_pd(map.stride);
+        const __m128d border = _mm_set1_pd(map.border);
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d one = _mm_set1_pd(1);
+        const __m128d positionX = _mm_set1_pd(pose.position.x);
+        const __m128d positionY = _mm_set1_pd(pose.position.y);
+
+        // Cell within the bordered block; the border is taken off when the
+        // hits are stored
+        const __m128d mapX = TruncateSse2(_mm_div_pd(ray.hitCell, stride));
+        const __m128d mapY = _mm_sub_pd(ray.hitCell, _mm_mul_pd(mapX, stride));
+
+        // (1 - step) / 2
+        const __m128d halfX = _mm_and_pd(_mm_cmplt_pd(ray.directionX, zero), one);
+        const __m128d halfY = _mm_and_pd(_mm_cmplt_pd(ray.directionY, zero), one);
+
+        const __m128d distanceX = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(mapX, border), positionX), halfX);
+        const __m128d distanceY = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(mapY, border), positionY), halfY);
+        const __m128d scale = _mm_div_pd(SelectSse2(ray.sideHit, distanceY, distanceX), SelectSse2(ray.sideHit, ray.directionY, ray.directionX));
+
+        const __m128d perpWallDistance = _mm_andnot_pd(_mm_set1_pd(-0.0), scale);
+        __m128d wallX = SelectSse2(ray.sideHit, _mm_add_pd(positionX, _mm_mul_pd(scale, ray.directionX)),
+                                                _mm_add_pd(positionY, _mm_mul_pd(scale, ray.directionY)));
+        wallX = _mm_sub_pd(wallX, TruncateSse2(wallX));
+
+        alignas(16) double lanes[6][2];
+        _mm_store_pd(lanes[0], ray.hitCell);
+        _mm_store_pd(lanes[1], mapX);
+        _mm_store_pd(lanes[2], mapY);
+        _mm_store_pd(lanes[3], ray.sideHit);
+        _mm_store_pd(lanes[4], perpWallDistance);
+        _mm_store_pd(lanes[5], wallX);
+        StoreHits(map, lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5], 2, hits);
+    }
+
+    // Casts the 4 columns starting at cameraOffsets as two pairs of double lanes
+    __attribute__((target("sse2")))
+    void CastPacketSse2(const MapView &map, const CameraPose &pose, const double *cameraOffsets, RayHit *hits) noexcept
+    {
+        PairSse2 ray0;
+        PairSse2 ray1;
+        SetupPairSse2(map, pose, cameraOffsets, ray0);
+        SetupPairSse2(map, pose, cameraOffsets + 2, ray1);
+
+        const int lastCell = GetLastCell(map);
+
+        while (_mm_movemask_pd(_mm_or_pd(ray0.active, ray1.active))) {
+            StepPairSse2(map, lastCell, ray0);
+            StepPairSse2(map, lastCell, ray1);
+        }
+
+        FinishPairSse2(map, pose, ray0, hits);
+        FinishPairSse2(map, pose, ray1, hits + 2);
+    }
+
+    struct QuadAvx2 {
+        __m256d directionX, directionY;
+        __m256d deltaX, deltaY;
+        __m256d cellStepX, cellStepY;
+        __m256d cell, sideX, sideY;
+        __m256d hitCell, sideHit, active;
+        // Steps left until each lane next reads the distance field
+        __m128i countdown;
+    };
+
+    __attribute__((target("avx2"), always_inline))
+    inline void SetupQuadAvx2(const MapView &map, const CameraPose &pose, const double *cameraOffsets, QuadAvx2 &ray) noexcept
+    {
+        const __m256d one = _mm256_set1_pd(1);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d signBit = _mm256_set1_pd(-0.0);
+
+        const __m256d cameraOffsetX = _mm256_loadu_pd(cameraOffsets);
+        ray.directionX = _mm256_add_pd(_mm256_set1_pd(pose.direction.x), _mm256_mul_pd(_mm256_set1_pd(pose.plane.x), cameraOffsetX));
+        ray.directionY = _mm256_add_pd(_mm256_set1_pd(pose.direction.y), _mm256_mul_pd(_mm256_set1_pd(pose.plane.y), cameraOffsetX));
+
+        ray.deltaX = _mm256_andnot_pd(signBit, _mm256_div_pd(one, ray.directionX));
+        ray.deltaY = _mm256_andnot_pd(signBit, _mm256_div_pd(one, ray.directionY));
+
+        Point<double> negative;
+        Point<double> positive;
+        GetFirstSideOffsets(pose.position.x, negative.x, positive.x);
+        GetFirstSideOffsets(pose.position.y, negative.y, positive.y);
+
+        const __m256d negativeX = _mm256_cmp_pd(ray.directionX, zero, _CMP_LT_OQ);
+        const __m256d negativeY = _mm256_cmp_pd(ray.directionY, zero, _CMP_LT_OQ);
+        ray.sideX = _mm256_mul_pd(_mm256_blendv_pd(_mm256_set1_pd(positive.x), _mm256_set1_pd(negative.x), negativeX), ray.deltaX);
+        ray.sideY = _mm256_mul_pd(_mm256_blendv_pd(_mm256_set1_pd(positive.y), _mm256_set1_pd(negative.y), negativeY), ray.deltaY);
+        ray.cellStepX = _mm256_blendv_pd(_mm256_set1_pd(map.stride), _mm256_set1_pd(-map.stride), negativeX);
+        ray.cellStepY = _mm256_blendv_pd(one, _mm256_set1_pd(-1), negativeY);
+
+        ray.cell = _mm256_set1_pd(GetStartCell(map, pose.position));
+        ray.hitCell = ray.cell;
+        ray.sideHit = zero;
+        ray.active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+        ray.countdown = _mm_setzero_si128();
+
+        if (map.distances) {
+            const int startDistance = GetFirstDistance(map)[static_cast<int>(GetStartCell(map, pose.position))];
+            ray.countdown = _mm_set1_epi32(std::max(1, startDistance));
+        }
+    }
+
+    // Advances every ray by one cell and records the first wall each one
+    // hits. With SKIP_EMPTY a lane only reads the distance field when its
+    // countdown runs out, and the read is left out altogether while every
+    // lane is crossing open space.
+    template <bool SKIP_EMPTY>
+    __attribute__((target("avx2"), always_inline))
+    inline void StepQuadAvx2(const MapView &map, const __m128i lastCell, QuadAvx2 &ray) noexcept
+    {
+        const __m256d xSide = _mm256_cmp_pd(ray.sideX, ray.sideY, _CMP_LT_OQ);
+
+        ray.sideX = _mm256_add_pd(ray.sideX, _mm256_and_pd(xSide, ray.deltaX));
+        ray.sideY = _mm256_add_pd(ray.sideY, _mm256_andnot_pd(xSide, ray.deltaY));
+        ray.cell = _mm256_add_pd(ray.cell, _mm256_blendv_pd(ray.cellStepY, ray.cellStepX, xSide));
+
+        const __m128i index = _mm_max_epi32(_mm_min_epi32(_mm256_cvttpd_epi32(ray.cell), lastCell), _mm_setzero_si128());
+
+        if (SKIP_EMPTY) {
+            const __m128i zero = _mm_setzero_si128();
+            ray.countdown = _mm_sub_epi32(ray.countdown, _mm_set1_epi32(1));
+
+            const __m128i lookup = _mm_cmpeq_epi32(ray.countdown, zero);
+            if (_mm_testz_si128(lookup, lookup)) {
+                return;
+            }
+
+            const __m128i words = _mm_i32gather_epi32(reinterpret_cast<const int*>(GetFirstDistance(map)), index, 1);
+            const __m128i distances = _mm_and_si128(words, _mm_set1_epi32(0xFF));
+            const __m128i wall = _mm_and_si128(lookup, _mm_cmpeq_epi32(distances, zero));
+
+            // A lane that hits a wall never counts down to another read
+            const __m128i nextCountdown = _mm_blendv_epi8(distances, _mm_set1_epi32(INT_MAX), wall);
+            ray.countdown = _mm_blendv_epi8(ray.countdown, nextCountdown, lookup);
+
+            const __m256d wallHit = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(wall));
+            ray.hitCell = _mm256_blendv_pd(ray.hitCell, ray.cell, wallHit);
+            ray.sideHit = _mm256_blendv_pd(ray.sideHit, _mm256_xor_pd(xSide, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))), wallHit);
+            ray.active = _mm256_andnot_pd(wallHit, ray.active);
+            return;
+        }
+
+        // Cells are bytes; gather the word starting at each one and keep its
+        // low byte. The map block has slack for the word at the last cell.
+        const __m128i words = _mm_i32gather_epi32(reinterpret_cast<const int*>(GetFirstCell(map)), index, 1);
+        const __m128i cells = _mm_and_si128(words, _mm_set1_epi32(0xFF));
+        const __m256d emptyMask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(cells, _mm_setzero_si128())));
+        const __m256d wallHit = _mm256_andnot_pd(emptyMask, ray.active);
+
+        ray.hitCell = _mm256_blendv_pd(ray.hitCell, ray.cell, wallHit);
+        ray.sideHit = _mm256_blendv_pd(ray.sideHit, _mm256_xor_pd(xSide, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))), wallHit);
+        ray.active = _mm256_and_pd(ray.active, emptyMask);
+    }
+
+    __attribute__((target("avx2"), always_inline))
+    inline void FinishQuadAvx2(const MapView &map, const CameraPose &pose, const QuadAvx2 &ray, RayHit *hits) noexcept
+    {
+        const __m256d stride = _mm256_set1_pd(map.stride);
+        const __m256d border = _mm256_set1_pd(map.border);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d one = _mm256_set1_pd(1);
+        const __m256d positionX = _mm256_set1_pd(pose.position.x);
+        const __m256d positionY = _mm256_set1_pd(pose.position.y);
+
+        // Cell within the bordered block; the border is taken off when the
+        // hits are stored
+        const __m256d mapX = _mm256_round_pd(_mm256_div_pd(ray.hitCell, stride), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        const __m256d mapY = _mm256_sub_pd(ray.hitCell, _mm256_mul_pd(mapX, stride));
+
+        // (1 - step) / 2
+        const __m256d halfX = _mm256_and_pd(_mm256_cmp_pd(ray.directionX, zero, _CMP_LT_OQ), one);
+        const __m256d halfY = _mm256_and_pd(_mm256_cmp_pd(ray.directionY, zero, _CMP_LT_OQ), one);
+
+        const __m256d distanceX = _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(mapX, border), positionX), halfX);
+        const __m256d distanceY = _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(mapY, border), positionY), halfY);
+        const __m256d scale = _mm256_div_pd(_mm256_blendv_pd(distanceX, distanceY, ray.sideHit),
+                                            _mm256_blendv_pd(ray.directionX, ray.directionY, ray.sideHit));
+
+        const __m256d perpWallDistance = _mm256_andnot_pd(_mm256_set1_pd(-0.0), scale);
+        __m256d wallX = _mm256_blendv_pd(_mm256_add_pd(positionY, _mm256_mul_pd(scale, ray.directionY)),
+                                         _mm256_add_pd(positionX, _mm256_mul_pd(scale, ray.directionX)), ray.sideHit);
+        wallX = _mm256_sub_pd(wallX, _mm256_floor_pd(wallX));
+
+        alignas(32) double lanes[6][4];
+        _mm256_store_pd(lanes[0], ray.hitCell);
+        _mm256_store_pd(lanes[1], mapX);
+        _mm256_store_pd(lanes[2], mapY);
+        _mm256_store_pd(lanes[3], ray.sideHit);
+        _mm256_store_pd(lanes[4], perpWallDistance);
+        _mm256_store_pd(lanes[5], wallX);
+        StoreHits(map, lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5], 4, hits);
+    }
+
+    // Casts the 8 columns starting at cameraOffsets as two quads of double lanes
+    template <bool SKIP_EMPTY>
+    __attribute__((target("avx2")))
+    void CastPacketAvx2(const MapView &map, const CameraPose &pose, const double *cameraOffsets, RayHit *hits) noexcept
+    {
+        QuadAvx2 ray0;
+        QuadAvx2 ray1;
+        SetupQuadAvx2(map, pose, cameraOffsets, ray0);
+        SetupQuadAvx2(map, pose, cameraOffsets + 4, ray1);
+
+        const __m128i lastCell = _mm_set1_epi32(GetLastCell(map));
+
+        while (_mm256_movemask_pd(_mm256_or_pd(ray0.active, ray1.active))) {
+            StepQuadAvx2<SKIP_EMPTY>(map, lastCell, ray0);
+            StepQuadAvx2<SKIP_EMPTY>(map, lastCell, ray1);
+        }
+
+        FinishQuadAvx2(map, pose, ray0, hits);
+        FinishQuadAvx2(map, pose, ray1, hits + 4);
+    }
+    #endif
+
+    int GetPacketLanes(const CastKernel kernel) noexcept
+    {
+        switch (kernel) {
+            case CastKernel::SSE2:
+                return 4;
+            case CastKernel::AVX2:
+                return 8;
+            default:
+                return 1;
+        }
+    }
+
+    bool CpuSupports(const CastKernel kernel) noexcept
+    {
+        #ifdef RAYCASTER_X86_KERNELS
+        __builtin_cpu_init();
+
+        switch (kernel) {
+            case CastKernel::SSE2:
+                return __builtin_cpu_supports("sse2");
+            case CastKernel::AVX2:
+                return __builtin_cpu_supports("avx2");
+            default:
+                break;
+        }
+        #endif
+
+        return kernel == CastKernel::AUTO || kernel == CastKernel::SCALAR;
+    }
+
+    // The SSE2 kernel is left to explicit selection: without a gather it
+    // does more work per step than the scalar loop and measures slower.
+    CastKernel DetectBestCastKernel() noexcept
+    {
+        return CpuSupports(CastKernel::AVX2) ? CastKernel::AVX2 : CastKernel::SCALAR;
+    }
+}
+
+RayHit Raycaster::CastRay(const MapView &map, const Point<double> position, const Point<double> direction) noexcept
+{
+    Point<double> mapCell;
+    Point<double> deltaDistance;
+    Point<double> sideDistance;
+    Point<double> step;
+
+    SetupAxis(position.x, direction.x, mapCell.x, deltaDistance.x, sideDistance.x, step.x);
+    SetupAxis(position.y, direction.y, mapCell.y, deltaDistance.y, sideDistance.y, step.y);
+
+    bool wallHit = false;
+    bool sideHit = false;
+
+    if (!map.distances) {
+        // Perform DDA algorithm
+        while (!wallHit) {
+            StepRay(sideDistance, deltaDistance, mapCell, step, sideHit);
+            wallHit = GetCell(map, static_cast<int>(mapCell.x), static_cast<int>(mapCell.y));
+        }
+    } else {
+        // Same steps, but only some cells are read. Every cell within
+        // chessboard distance d - 1 of a cell d from the nearest wall is
+        // open, and a step moves one cell, so the d - 1 steps after reading
+        // a cell can't hit anything.
+        int freeSteps = std::max(0, GetDistance(map, mapCell) - 1);
+
+        while (!wallHit) {
+            for (; freeSteps > 0; freeSteps--) {
+                StepRayBranchless(sideDistance, deltaDistance, mapCell, step);
+            }
+
+            StepRay(sideDistance, deltaDistance, mapCell, step, sideHit);
+
+            const int distance = GetDistance(map, mapCell);
+            wallHit = !distance;
+            freeSteps = distance - 1;
+        }
+    }
+
+    RayHit hit;
+    FinishRay(position, direction, mapCell, step, sideHit,
+              GetCell(map, static_cast<int>(mapCell.x), static_cast<int>(mapCell.y)), hit);
+    return hit;
+}
+
+bool Raycaster::CastRayWithin(const MapView &map, const Point<double> position, const Point<double> direction,
+                              const double maxDistance, RayHit &hit) noexcept
+{
+    Point<double> mapCell;
+    Point<double> deltaDistance;
+    Point<double> sideDistance;
+    Point<double> step;
+
+    SetupAxis(position.x, direction.x, mapCell.x, deltaDistance.x, sideDistance.x, step.x);
+    SetupAxis(position.y, direction.y, mapCell.y, deltaDistance.y, sideDistance.y, step.y);
+
+    bool wallHit = false;
+    bool sideHit = false;
+
+    // The smaller side distance is how far along the ray the next cell
+    // starts, so the ray stops before entering a cell past the limit
+    if (!map.distances) {
+        while (!wallHit) {
+            if (std::min(sideDistance.x, sideDistance.y) > maxDistance) {
+                return false;
+            }
+
+            StepRay(sideDistance, deltaDistance, mapCell, step, sideHit);
+            wallHit = GetCell(map, static_cast<int>(mapCell.x), static_cast<int>(mapCell.y));
+        }
+    } else {
+        int freeSteps = std::max(0, GetDistance(map, mapCell) - 1);
+
+        while (!wallHit) {
+            for (; freeSteps > 0; freeSteps--) {
+                StepRayBranchless(sideDistance, deltaDistance, mapCell, step);
+            }
+
+            if (std::min(sideDistance.x, sideDistance.y) > maxDistance) {
+                return false;
+            }
+
+            StepRay(sideDistance, deltaDistance, mapCell, step, sideHit);
+
+            const int distance = GetDistance(map, mapCell);
+            wallHit = !distance;
+            freeSteps = distance - 1;
+        }
+    }
+
+    FinishRay(position, direction, mapCell, step, sideHit,
+              GetCell(map, static_cast<int>(mapCell.x), static_cast<int>(mapCell.y)), hit);
+    return true;
+}
+
+RayHit Raycaster::CastRay(const ChunkedWorld &world, const Point<double> position, const Point<double> direction) noexcept
+{
+    Point<double> mapCell;
+    Point<double> deltaDistance;
+    Point<double> sideDistance;
+    Point<double> step;
+
+    SetupAxis(position.x, direction.x, mapCell.x, deltaDistance.x, sideDistance.x, step.x);
+    SetupAxis(position.y, direction.y, mapCell.y, deltaDistance.y, sideDistance.y, step.y);
+
+    bool sideHit = false;
+    int cellValue = 0;
+
+    // Chunks that aren't loaded read as walls, so this always stops
+    while (!cellValue) {
+        StepRay(sideDistance, deltaDistance, mapCell, step, sideHit);
+        cellValue = world.GetCell(static_cast<int>(mapCell.x), static_cast<int>(mapCell.y));
+    }
+
+    RayHit hit;
+    FinishRay(position, direction, mapCell, step, sideHit, cellValue, hit);
+    return hit;
+}
+
+RayWalker::RayWalker(const Point<double> position, const Point<double> direction) noexcept
+{
+    SetupAxis(position.x, direction.x, m_mapCell.x, m_deltaDistance.x, m_sideDistance.x, m_step.x);
+    SetupAxis(position.y, direction.y, m_mapCell.y, m_deltaDistance.y, m_sideDistance.y, m_step.y);
+}
+
+void RayWalker::Step() noexcept
+{
+    StepRayBranchless(m_sideDistance, m_deltaDistance, m_mapCell, m_step);
+}
+
+void Raycaster::UpdateRayTable(RayTable &table, const int screenWidth)
+{
+    if (table.screenWidth == screenWidth && static_cast<int>(table.cameraOffsets.size()) == screenWidth) {
+        return;
+    }
+
+    table.screenWidth = screenWidth;
+    table.cameraOffsets.resize(screenWidth);
+
+    for (int column{0}; column < screenWidth; column++) {
+        // Calculate camera offset on x axis
+        // This value is always between 1 and -1
+        table.cameraOffsets[column] = 2 * column / static_cast<double>(screenWidth) - 1;
+    }
+}
+
+void Raycaster::CastColumns(const CastKernel kernel, const MapView &map, const CameraPose &pose,
+                            const RayTable &table, const int firstColumn, const int lastColumn, RayHit *hits) noexcept
+{
+    CastKernel selected = (kernel == CastKernel::AUTO) ? GetBestCastKernel() : kernel;
+    if (!IsCastKernelSupported(selected)) {
+        selected = CastKernel::SCALAR;
+    }
+
+    const double *cameraOffsets = table.cameraOffsets.data();
+    const int lanes = GetPacketLanes(selected);
+    int column = firstColumn;
+
+    #ifdef RAYCASTER_X86_KERNELS
+    if (selected == CastKernel::AVX2) {
+        for (; column + lanes <= lastColumn; column += lanes) {
+            if (map.distances) {
+                CastPacketAvx2<true>(map, pose, cameraOffsets + column, hits + (column - firstColumn));
+            } else {
+                CastPacketAvx2<false>(map, pose, cameraOffsets + column, hits + (column - firstColumn));
+            }
+        }
+    } else if (selected == CastKernel::SSE2) {
+        // Reads every cell; its per-lane loads gain little from skipping
+        for (; column + lanes <= lastColumn; column += lanes) {
+            CastPacketSse2(map, pose, cameraOffsets + column, hits + (column - firstColumn));
+        }
+    }
+    #endif
+
+    // Scalar kernel, and columns left over after the last full packet
+    for (; column < lastColumn; column++) {
+        hits[column - firstColumn] = CastRay(map, pose.position, GetColumnRayDirection(pose, cameraOffsets[column]));
+    }
+}
+
+void Raycaster::CastColumns(const ChunkedWorld &world, const CameraPose &pose,
+                            const RayTable &table, const int firstColumn, const int lastColumn, RayHit *hits) noexcept
+{
+    for (int column{firstColumn}; column < lastColumn; column++) {
+        hits[column - firstColumn] = CastRay(world, pose.position, GetColumnRayDirection(pose, table.cameraOffsets[column]));
+    }
+}
+
+bool Raycaster::ReprojectHit(const MapView &map, const Point<double> position, const Point<double> direction,
+                             const RayHit &previous, RayHit &hit) noexcept
+{
+    const auto readCell = [&map](const int x, const int y) {
+        const bool readable = x >= -map.border && x < map.columns + map.border && y >= -map.border && y < map.rows + map.border;
+        return readable ? GetCell(map, x, y) : -1;
+    };
+
+    return ReprojectOntoFace(readCell, position, direction, previous, hit);
+}
+
+bool Raycaster::ReprojectHit(const ChunkedWorld &world, const Point<double> position, const Point<double> direction,
+                             const RayHit &previous, RayHit &hit) noexcept
+{
+    const auto readCell = [&world](const int x, const int y) {
+        return world.GetCell(x, y);
+    };
+
+    return ReprojectOntoFace(readCell, position, direction, previous, hit);
+}
+
+CastKernel Raycaster::GetBestCastKernel() noexcept
+{
+    static const CastKernel BEST_KERNEL = DetectBestCastKernel();
+    return BEST_KERNEL;
+}
+
+bool Raycaster::IsCastKernelSupported(const CastKernel kernel) noexcept
+{
+    static const bool SSE2_SUPPORTED = CpuSupports(CastKernel::SSE2);
+    static const bool AVX2_SUPPORTED = CpuSupports(CastKernel::AVX2);
+
+    switch (kernel) {
+        case CastKernel::SSE2:
+            return SSE2_SUPPORTED;
+        case CastKernel::AVX2:
+            return AVX2_SUPPORTED;
+        default:
+            return true;
+    }
+}
+
+const char* Raycaster::GetCastKernelName(const CastKernel kernel) noexcept
+{
+    switch (kernel) {
+        case CastKernel::AUTO:
+            return "auto";
+        case CastKernel::SCALAR:
+            return "scalar";
+        case CastKernel::SSE2:
+            return "sse2";
+        case CastKernel::AVX2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
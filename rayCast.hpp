@@ -0,0 +1,128 @@
+#ifndef RAY_CAST_HPP
+#define RAY_CAST_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "point.hpp"
+
+namespace Raycaster
+{
+    class ChunkedWorld;
+
+    // Implementation used to trace a row of screen columns. The packet
+    // kernels trace 4 (SSE2) or 8 (AVX2) adjacent columns at once and give
+    // the same hits as the scalar kernel; see rayCast.cpp for the precision
+    // guarantees.
+    enum class CastKernel {
+        AUTO, SCALAR, SSE2, AVX2
+    };
+
+    // Read-only view of a world map; cell (x, y) is cells[x * stride + y].
+    // The map is surrounded by border cells of walls, so cells from -border
+    // to columns + border - 1 (and likewise for rows) can be read and every
+    // ray cast from inside the map stops.
+    //
+    // distances is optional and laid out like cells. It holds each cell's
+    // chessboard distance to the nearest wall, 0 for walls and capped at 255;
+    // rays use it to cross open space without reading every cell.
+    struct MapView {
+        const std::uint8_t *cells;
+        int columns;
+        int rows;
+        int stride;
+        int border;
+        const std::uint8_t *distances;
+    };
+
+    struct CameraPose {
+        Point<double> position;
+        Point<double> direction;
+        Point<double> plane;
+    };
+
+    // Per-column values that depend only on the screen width, so they are
+    // worked out once per resolution rather than every frame. The field of
+    // view is the length of the pose's camera plane and needs no rebuild.
+    struct RayTable {
+        int screenWidth;
+        // Position of each column across the camera plane, from -1 to 1
+        std::vector<double> cameraOffsets;
+    };
+
+    // Walks the cells a ray passes through one at a time, taking the same
+    // steps as the cast kernels, for queries that need more than the first
+    // wall hit. position must be inside the map.
+    class RayWalker
+    {
+    public:
+        RayWalker(const Point<double> position, const Point<double> direction) noexcept;
+
+        int GetCellX() const noexcept { return static_cast<int>(m_mapCell.x); }
+        int GetCellY() const noexcept { return static_cast<int>(m_mapCell.y); }
+        // How far along the ray the next cell starts, in lengths of direction
+        double GetNextDistance() const noexcept { return m_sideDistance.x < m_sideDistance.y ? m_sideDistance.x : m_sideDistance.y; }
+
+        // Moves to the next cell
+        void Step() noexcept;
+
+    private:
+        Point<double> m_mapCell;
+        Point<double> m_deltaDistance;
+        Point<double> m_sideDistance;
+        Point<double> m_step;
+    };
+
+    // Rebuilds the table if it was built for another width
+    void UpdateRayTable(RayTable &table, const int screenWidth);
+
+    struct RayHit {
+        int cellX;
+        int cellY;
+        int cellValue;
+        bool sideHit;
+        // Distance to the wall measured along the view direction
+        double perpWallDistance;
+        // Where the wall was hit, in [0, 1) across the cell face
+        double wallX;
+    };
+
+    // Traces a single ray from position, which must be inside the map
+    RayHit CastRay(const MapView &map, const Point<double> position, const Point<double> direction) noexcept;
+
+    // Traces like CastRay(), but gives up and returns false once the ray
+    // has gone maxDistance lengths of direction without entering a wall
+    bool CastRayWithin(const MapView &map, const Point<double> position, const Point<double> direction,
+                       const double maxDistance, RayHit &hit) noexcept;
+
+    // Traces the rays for columns [firstColumn, lastColumn) of a view as
+    // wide as the table, writing hits[column - firstColumn]
+    void CastColumns(const CastKernel kernel, const MapView &map, const CameraPose &pose,
+                     const RayTable &table, const int firstColumn, const int lastColumn, RayHit *hits) noexcept;
+
+    // Same for a streamed world, position inside it. Chunks that aren't
+    // loaded stop rays like walls. There is no distance field or packet
+    // kernel: every cell is looked up through the chunk directory.
+    RayHit CastRay(const ChunkedWorld &world, const Point<double> position, const Point<double> direction) noexcept;
+    void CastColumns(const ChunkedWorld &world, const CameraPose &pose,
+                     const RayTable &table, const int firstColumn, const int lastColumn, RayHit *hits) noexcept;
+
+    // Finds where a ray meets the wall previous was cast against without
+    // walking the map, to rebuild a column from an earlier frame's hit.
+    // The ray is met with the face of previous's row of cells turned
+    // towards position, so it may land on a cell beside previous's; that
+    // cell must be a wall with open space in front. Hits on the same cell
+    // are the same as a cast's. Walls in front of the face aren't looked
+    // for, so callers check against rays cast nearby.
+    bool ReprojectHit(const MapView &map, const Point<double> position, const Point<double> direction,
+                      const RayHit &previous, RayHit &hit) noexcept;
+    bool ReprojectHit(const ChunkedWorld &world, const Point<double> position, const Point<double> direction,
+                      const RayHit &previous, RayHit &hit) noexcept;
+
+    // Fastest kernel for this CPU, picked on first use
+    CastKernel GetBestCastKernel() noexcept;
+    bool IsCastKernelSupported(const CastKernel kernel) noexcept;
+    const char* GetCastKernelName(const CastKernel kernel) noexcept;
+}
+
+#endif // RAY_CAST_HPP
@@ -1,6 +1,10 @@
 #include "raycasterEngine.hpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
 
 #define DEBUG_MODE
 
@@ -8,383 +12,1529 @@ using namespace Raycaster;
 
 const int RaycasterEngine::BACKGROUND_COLOUR = 0x000000;
 const float RaycasterEngine::WALL_SIDE_COLOUR_MULTIPLIER = .75;
-const float RaycasterEngine::MOVEMENT_SPEED = .4;
-const float RaycasterEngine::TURN_ANGLE = .08;
+// Per simulation tick: 5 cells and 3 radians a second
+const float RaycasterEngine::MOVEMENT_SPEED = 5.0 / SIMULATION_RATE;
+const float RaycasterEngine::TURN_ANGLE = 3.0 / SIMULATION_RATE;
 const float RaycasterEngine::ROTATE_CAMERA_ANGLE = .0008;
+const float RaycasterEngine::PLAYER_RADIUS = .2;
+// Two ticks of turning at the keyboard, six of walking
+const float RaycasterEngine::INTERLACE_MAX_TURN = .1;
+const float RaycasterEngine::INTERLACE_MAX_MOVE = .5;
+const char *const RaycasterEngine::PROFILE_TRACE_PATH = "raycaster_trace.json";
+
+namespace
+{
+    // Grows region to take in added
+    inline void AddRegion(MapRegion &region, const MapRegion &added) noexcept
+    {
+        if (added.maxX < added.minX) {
+            return;
+        }
+
+        if (region.maxX < region.minX) {
+            region = added;
+            return;
+        }
+
+        region = {std::min(region.minX, added.minX), std::min(region.minY, added.minY),
+                  std::max(region.maxX, added.maxX), std::max(region.maxY, added.maxY)};
+    }
+
+    inline bool IsSamePose(const CameraPose &a, const CameraPose &b) noexcept
+    {
+        return a.position.x == b.position.x && a.position.y == b.position.y &&
+               a.direction.x == b.direction.x && a.direction.y == b.direction.y &&
+               a.plane.x == b.plane.x && a.plane.y == b.plane.y;
+    }
+
+    inline bool IsSameSprites(const std::vector<Sprite> &a, const std::vector<Sprite> &b) noexcept
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const Sprite &x, const Sprite &y) {
+            return x.position.x == y.position.x && x.position.y == y.position.y && x.texture == y.texture;
+        });
+    }
+
+    // Whether the segment from start to end touches the cells of region,
+    // widened by a little for rounding in where rays end
+    bool SegmentTouchesRegion(const Point<double> start, const Point<double> end, const MapRegion &region) noexcept
+    {
+        const double margin = 1e-3;
+        const double starts[2] = {start.x, start.y};
+        const double ends[2] = {end.x, end.y};
+        const double lows[2] = {region.minX - margin, region.minY - margin};
+        const double highs[2] = {region.maxX + 1 + margin, region.maxY + 1 + margin};
+        double enter{0};
+        double leave{1};
+
+        // Clips the segment to the region one axis at a time
+        for (int axis{0}; axis < 2; axis++) {
+            const double length = ends[axis] - starts[axis];
+
+            if (length == 0) {
+                if (starts[axis] < lows[axis] || starts[axis] > highs[axis]) {
+                    return false;
+                }
+                continue;
+            }
+
+            double low = (lows[axis] - starts[axis]) / length;
+            double high = (highs[axis] - starts[axis]) / length;
+            if (low > high) {
+                std::swap(low, high);
+            }
+
+            enter = std::max(enter, low);
+            leave = std::min(leave, high);
+        }
+
+        return enter <= leave;
+    }
+
+    // Hits on the same face of the same row or column of cells
+    inline bool IsOnSameFace(const RayHit &a, const RayHit &b) noexcept
+    {
+        return a.sideHit == b.sideHit && (a.sideHit ? a.cellY == b.cellY : a.cellX == b.cellX);
+    }
+
+    // Whether a hit moved into a column is in view given the hits cast
+    // either side of it, null at the edges of the screen
+    inline bool IsReprojectionVisible(const RayHit &hit, const RayHit *left, const RayHit *right) noexcept
+    {
+        const bool leftAgrees = !left || IsOnSameFace(hit, *left);
+        const bool rightAgrees = !right || IsOnSameFace(hit, *right);
+
+        return (leftAgrees && rightAgrees) ||
+               (leftAgrees && right->perpWallDistance >= hit.perpWallDistance) ||
+               (rightAgrees && left->perpWallDistance >= hit.perpWallDistance);
+    }
+}
+
+const std::uint8_t RaycasterEngine::DEFAULT_WORLD_MAP[WORLD_MAP_COLS][WORLD_MAP_ROWS] =
+{
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 3, 0, 3, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 3, 0, 3, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 1},
+    {1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 1},
+    {1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 0, 0, 0, 2, 2, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 2, 2, 0, 2, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 2, 2, 0, 2, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 2, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
+};
 
 RaycasterEngine::RaycasterEngine() :
     m_playerPosition{9, 8},
     m_playerDirection{-1, 0},
     m_cameraPlane{0, 0.66},
+    m_screen{nullptr},
+    m_castKernel{CastKernel::AUTO},
     m_isRunning{true},
     m_rotateCamera{true},
     m_texturesEnabled{true},
-    m_curFrameTime{0},
-    m_prevFrameTime{0},
-    m_movementSpeed{MOVEMENT_SPEED},
-    m_rotateSpeed{TURN_ANGLE}
+    m_skipEmptySpace{false},
+    m_dynamicResolution{false},
+    m_mipmapping{true},
+    m_lighting{true},
+    m_interlacing{false},
+    m_columnCaching{true},
+    m_columnStats{0, 0, 0, 0, false},
+    m_drawVersion{0},
+    m_drawnMapChanges{0, 0, -1, -1},
+    m_lastFrameKept{false},
+    m_heldButtons{0},
+    m_previousPose{},
+    m_isRecording{false},
+    m_isReplaying{false},
+    m_replayTick{0},
+    m_rotations{},
+    m_nextRotation{0}
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine constructor" << std::endl;
+    #endif
+
+    // Turns and the camera auto-rotate use fixed angles, so their
+    // rotations are worked out once here rather than on every turn and are
+    // never replaced. The other slots start empty: NaN matches no angle
+    m_rotations[0] = {TURN_ANGLE, MakeRotation(TURN_ANGLE)};
+    m_rotations[1] = {ROTATE_CAMERA_ANGLE, MakeRotation(ROTATE_CAMERA_ANGLE)};
+    for (int i{PINNED_ROTATIONS}; i < ROTATION_CACHE_SIZE; i++) {
+        m_rotations[i] = {std::numeric_limits<float>::quiet_NaN(), {1, 0}};
+    }
+    m_nextRotation = PINNED_ROTATIONS;
+
+    BuildFlatColours();
+
+    m_worldMap.Create(WORLD_MAP_COLS, WORLD_MAP_ROWS);
+
+    for (int x{0}; x < WORLD_MAP_COLS; x++) {
+        for (int y{0}; y < WORLD_MAP_ROWS; y++) {
+            m_worldMap.SetCell(x, y, DEFAULT_WORLD_MAP[x][y]);
+        }
+    }
+}
+
+RaycasterEngine::~RaycasterEngine()
+{
+
+}
+
+void RaycasterEngine::Init()
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine::Init()" << std::endl;
+    #endif
+
+    SDL_Init(SDL_INIT_EVERYTHING);
+    m_screen = SDL_SetVideoMode(PROJ_PLANE_WIDTH, PROJ_PLANE_HEIGHT, 32, SDL_SWSURFACE/* | SDL_FULLSCREEN*/);
+    SDL_WM_SetCaption("Raycaster Engine", NULL);
+    SDL_EnableKeyRepeat(100, SDL_DEFAULT_REPEAT_INTERVAL);
+
+    m_windowTarget.reset(new SurfaceRenderTarget(m_screen));
+
+    // Unless LoadTextures() was called first
+    if (!m_textureCache) {
+        GenerateTextures();
+    }
+}
+
+void RaycasterEngine::InitHeadless()
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine::InitHeadless()" << std::endl;
+    #endif
+
+    m_rotateCamera = false;
+    m_lighting = false;
+
+    if (!m_textureCache) {
+        GenerateTextures();
+    }
+}
+
+bool RaycasterEngine::LoadMap(const std::string &path)
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine::LoadMap(): " << path << std::endl;
+    #endif
+
+    WorldMap map;
+
+    if (!map.Load(path)) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::LoadMap(): Error loading map " << path << std::endl;
+        #endif
+        return false;
+    }
+
+    m_worldMap = std::move(map);
+    m_view.hitsCurrent = false;
+
+    if (m_skipEmptySpace) {
+        m_worldMap.BuildDistanceField();
+    }
+
+    if (m_drawnMap) {
+        CopyDrawnMap();
+    }
+
+    // Start in the first open cell if the current position isn't one
+    if (IsPlayerInWall()) {
+        for (int x{0}; x < m_worldMap.GetColumns(); x++) {
+            for (int y{0}; y < m_worldMap.GetRows(); y++) {
+                if (!m_worldMap.GetCell(x, y)) {
+                    SetPlayerPosition({x + 0.5, y + 0.5});
+                    return true;
+                }
+            }
+        }
+
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::LoadMap(): Map has no open cells" << std::endl;
+        #endif
+    }
+
+    return true;
+}
+
+void RaycasterEngine::EditMap(const std::vector<MapEdit> &edits)
+{
+    if (edits.empty()) {
+        return;
+    }
+
+    const MapRegion changed = m_worldMap.ApplyEdits(edits.data(), static_cast<int>(edits.size()));
+
+    if (!m_drawnMap) {
+        AddRegion(m_drawnMapChanges, changed);
+    } else {
+        std::lock_guard<std::mutex> lock(m_mapEditMutex);
+        m_pendingMapEdits.insert(m_pendingMapEdits.end(), edits.begin(), edits.end());
+    }
+}
+
+void RaycasterEngine::SetMapCell(const int x, const int y, const std::uint8_t value)
+{
+    EditMap({{x, y, value}});
+}
+
+void RaycasterEngine::SetMapDoubleBuffering(const bool enable)
+{
+    if (!enable) {
+        // Edits still pending for the drawn map weren't added to its changes
+        m_drawnMap.reset();
+        m_view.hitsCurrent = false;
+    } else if (!m_drawnMap) {
+        m_drawnMap.reset(new WorldMap);
+        CopyDrawnMap();
+    }
+}
+
+void RaycasterEngine::ApplyMapEdits()
+{
+    if (!m_drawnMap) {
+        return;
+    }
+
+    // Swapped rather than copied, so both lists keep their capacity and
+    // a steady stream of edits allocates nothing
+    {
+        std::lock_guard<std::mutex> lock(m_mapEditMutex);
+        m_drawnMapEdits.swap(m_pendingMapEdits);
+    }
+
+    if (!m_drawnMapEdits.empty()) {
+        AddRegion(m_drawnMapChanges, m_drawnMap->ApplyEdits(m_drawnMapEdits.data(), static_cast<int>(m_drawnMapEdits.size())));
+        m_drawnMapEdits.clear();
+    }
+}
+
+void RaycasterEngine::CopyDrawnMap()
+{
+    std::lock_guard<std::mutex> lock(m_mapEditMutex);
+    m_pendingMapEdits.clear();
+    m_drawnMap->CopyFrom(m_worldMap);
+    m_view.hitsCurrent = false;
+}
+
+void RaycasterEngine::SetStreamedWorld(const std::shared_ptr<ChunkedWorld> &world)
+{
+    m_streamedWorld = world;
+    m_view.hitsCurrent = false;
+
+    if (!world) {
+        return;
+    }
+
+    // Wait for the chunks around the player so the first frame isn't
+    // drawn inside unloaded walls
+    const int x = static_cast<int>(std::floor(GetPlayerPosition().x));
+    const int y = static_cast<int>(std::floor(GetPlayerPosition().y));
+    world->Preload(x - CHUNK_SIZE, y - CHUNK_SIZE, x + CHUNK_SIZE, y + CHUNK_SIZE);
+}
+
+bool RaycasterEngine::LoadTextures(const std::string &path, const std::size_t cacheBytes)
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine::LoadTextures(): " << path << std::endl;
+    #endif
+
+    std::shared_ptr<TexturePack> pack(new TexturePack);
+
+    if (!pack->Load(path) || !pack->GetTextureCount()) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::LoadTextures(): Error loading texture pack " << path << std::endl;
+        #endif
+        return false;
+    }
+
+    m_textureCache.reset(new TextureCache(pack, cacheBytes));
+    m_drawVersion++;
+    return true;
+}
+
+void RaycasterEngine::GenerateTextures()
+{
+    std::vector<unsigned int> textures[NUMBER_OF_TEXTURES];
+
+    for (std::vector<unsigned int> &texture : textures) {
+        texture.resize(TEXTURE_WIDTH * TEXTURE_HEIGHT);
+    }
+
+    for (int x{0}; x < TEXTURE_WIDTH; x++) {
+        for (int y{0}; y < TEXTURE_HEIGHT; y++) {
+            // XOR
+            int xorColour = (x * 256 / TEXTURE_WIDTH) ^ (y * 256 / TEXTURE_HEIGHT);
+            textures[0][TEXTURE_WIDTH * y + x] = xorColour + 256 * xorColour + 65536 + xorColour;
+            // Red with black rectangles
+            textures[1][TEXTURE_WIDTH * y + x] = 65536 * 192 * (x % 16 && y % 16);
+            // Vertical plasma lines
+            textures[2][TEXTURE_WIDTH * y + x] = static_cast<int>(128.f + (128.f * sin(x / 8.f)));
+        }
+    }
+
+    std::shared_ptr<TexturePack> pack(new TexturePack);
+
+    for (const std::vector<unsigned int> &texture : textures) {
+        pack->Add(TEXTURE_WIDTH, TEXTURE_HEIGHT, texture.data());
+    }
+
+    m_textureCache.reset(new TextureCache(pack, DEFAULT_TEXTURE_CACHE_BYTES));
+    m_drawVersion++;
+}
+
+void RaycasterEngine::BuildFlatColours()
+{
+    for (int cell{0}; cell < 256; cell++) {
+        // Colours are 0x00RRGGBB, the same layout as the textures, so flat
+        // shading works without an SDL video surface
+        unsigned int colour;
+
+        switch (cell) {
+            case 1:
+                colour = 0xFF0000;
+                break;
+            case 2:
+                colour = 0x00FF00;
+                break;
+            default:
+                colour = 0x0000FF;
+                break;
+        }
+
+        m_flatColours[0][cell] = colour;
+
+        // Each channel scaled on its own, so none spills into the next
+        unsigned int sideColour{0};
+        for (int shift{0}; shift < 24; shift += 8) {
+            sideColour |= static_cast<unsigned int>(((colour >> shift) & 0xFF) * WALL_SIDE_COLOUR_MULTIPLIER) << shift;
+        }
+        m_flatColours[1][cell] = sideColour;
+    }
+}
+
+void RaycasterEngine::UpdateTextures(const Point<double> position)
+{
+    m_textureCache->Update();
+
+    if (m_textureCache->HoldsAll() || !GetTexturesEnabled()) {
+        return;
+    }
+
+    const int centreX = static_cast<int>(std::floor(position.x));
+    const int centreY = static_cast<int>(std::floor(position.y));
+    const int count = m_textureCache->GetTextureCount();
+
+    for (int x{centreX - TEXTURE_PREFETCH_RADIUS}; x <= centreX + TEXTURE_PREFETCH_RADIUS; x++) {
+        for (int y{centreY - TEXTURE_PREFETCH_RADIUS}; y <= centreY + TEXTURE_PREFETCH_RADIUS; y++) {
+            const int cell = m_streamedWorld ? m_streamedWorld->GetCell(x, y) : GetDrawnMap().GetCell(x, y);
+
+            if (cell) {
+                m_textureCache->Prefetch((cell - 1) % count);
+            }
+        }
+    }
+}
+
+void RaycasterEngine::Cleanup()
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine::Cleanup()" << std::endl;
+    #endif
+
+    m_windowTarget.reset();
+    m_threadPool.reset();
+}
+
+void RaycasterEngine::Run()
+{
+    #ifdef DEBUG_MODE
+    std::cout << "RaycasterEngine::Run()" << std::endl;
+    #endif
+
+    FramePipeline pipeline(m_windowTarget->GetWidth(), m_windowTarget->GetHeight(), PRESENT_BUFFER_COUNT,
+                           [this](RenderTarget &target, const CameraPose &pose) {
+        RenderFrame(target, pose);
+    });
+
+    const double tickSeconds = 1.0 / SIMULATION_RATE;
+    double unsimulated{0};
+    Uint32 lastTime = SDL_GetTicks();
+
+    m_previousPose = {GetPlayerPosition(), GetPlayerDirection(), GetCameraPlane()};
+
+    // Ticks may edit the map while the draw thread draws
+    SetMapDoubleBuffering(true);
+
+    while (IsRunning()) {
+        PROFILE_SCOPE(FRAME);
+
+        {
+            PROFILE_SCOPE(EVENTS);
+            HandleEvents();
+        }
+
+        // The simulation runs in fixed ticks however fast frames are drawn.
+        // Time beyond a few ticks a frame is dropped, so a slow frame
+        // slows the game down rather than making the next frame slower.
+        const Uint32 now = SDL_GetTicks();
+        unsimulated += (now - lastTime) / 1000.0;
+        lastTime = now;
+
+        for (int tick{0}; tick < MAX_TICKS_PER_FRAME && unsimulated >= tickSeconds && IsRunning(); tick++) {
+            if (!m_isReplaying) {
+                StepSimulation(m_heldButtons);
+            } else if (!StepReplay()) {
+                Quit();
+            }
+
+            unsimulated -= tickSeconds;
+        }
+        unsimulated = std::min(unsimulated, tickSeconds);
+
+        //std::cout << "x: " << GetPlayerPosition().x << "    y: " << GetPlayerPosition().y << std::endl << "x: " << GetPlayerDirection().x << "    y: " << GetPlayerDirection().y << std::endl << std::endl;
+
+        // Frames show the camera part way between the last two ticks, so
+        // motion is smooth at any frame rate. The draw thread gets a copy
+        // of the pose, so the next ticks can run while it draws.
+        pipeline.Submit(GetInterpolatedPose(unsimulated / tickSeconds));
+
+        // Present the previous frame while this one is drawn
+        if (pipeline.IsFull()) {
+            PROFILE_SCOPE(PRESENT);
+            pipeline.PresentOldest(*m_windowTarget, &m_capture);
+        }
+    }
+
+    if (m_capture.IsOpen() && !StopCapture()) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::Run(): Error writing frame capture" << std::endl;
+        #endif
+    }
+
+    if (m_isRecording && !StopRecording()) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::Run(): Error writing input log " << m_recordPath << std::endl;
+        #endif
+    }
+
+    SDL_Quit();
+}
+
+void RaycasterEngine::StepSimulation(const std::uint8_t buttons)
+{
+    m_previousPose = {GetPlayerPosition(), GetPlayerDirection(), GetCameraPlane()};
+
+    if (m_isRecording) {
+        m_inputLog.Append(buttons);
+    }
+
+    if (buttons & INPUT_FORWARD) {
+        MovePlayer(MovementDirection::FORWARD, MOVEMENT_SPEED);
+    }
+    if (buttons & INPUT_BACKWARD) {
+        MovePlayer(MovementDirection::BACKWARD, MOVEMENT_SPEED);
+    }
+    if (buttons & INPUT_STRAFE_LEFT) {
+        StrafePlayer(MovementDirection::LEFT, MOVEMENT_SPEED);
+    }
+    if (buttons & INPUT_STRAFE_RIGHT) {
+        StrafePlayer(MovementDirection::RIGHT, MOVEMENT_SPEED);
+    }
+    if (buttons & INPUT_TURN_LEFT) {
+        TurnPlayer(MovementDirection::LEFT, TURN_ANGLE);
+    }
+    if (buttons & INPUT_TURN_RIGHT) {
+        TurnPlayer(MovementDirection::RIGHT, TURN_ANGLE);
+    }
+
+    if (m_rotateCamera) {
+        RotateCamera(MovementDirection::RIGHT, ROTATE_CAMERA_ANGLE);
+    }
+}
+
+CameraPose RaycasterEngine::GetInterpolatedPose(const double alpha) const noexcept
+{
+    const CameraPose &from = m_previousPose;
+    const CameraPose to{GetPlayerPosition(), GetPlayerDirection(), GetCameraPlane()};
+
+    const auto lerp = [alpha](const Point<double> a, const Point<double> b) {
+        return Point<double>{a.x + (b.x - a.x) * alpha, a.y + (b.y - a.y) * alpha};
+    };
+
+    // Blending two directions shortens them a little, so they are scaled
+    // back to the lengths of the latest tick's to keep the field of view
+    const auto rescale = [](const Point<double> vector, const Point<double> like) {
+        const double length = std::sqrt(vector.x * vector.x + vector.y * vector.y);
+        const double wanted = std::sqrt(like.x * like.x + like.y * like.y);
+        return length ? Point<double>{vector.x * wanted / length, vector.y * wanted / length} : like;
+    };
+
+    return {lerp(from.position, to.position),
+            rescale(lerp(from.direction, to.direction), to.direction),
+            rescale(lerp(from.plane, to.plane), to.plane)};
+}
+
+bool RaycasterEngine::StartRecording(const std::string &path)
+{
+    m_inputLog.Reset({SIMULATION_RATE, m_rotateCamera ? static_cast<std::uint32_t>(INPUT_LOG_CAMERA_ROTATION) : 0u,
+                      static_cast<std::uint32_t>(m_worldMap.GetColumns()), static_cast<std::uint32_t>(m_worldMap.GetRows()),
+                      GetMapHash(), {GetPlayerPosition(), GetPlayerDirection(), GetCameraPlane()}});
+    m_recordPath = path;
+    m_isRecording = true;
+    m_isReplaying = false;
+
+    // Fail now rather than after the session
+    return m_inputLog.Save(path);
+}
+
+bool RaycasterEngine::StopRecording()
+{
+    if (!m_isRecording) {
+        return false;
+    }
+
+    m_isRecording = false;
+    return m_inputLog.Save(m_recordPath);
+}
+
+bool RaycasterEngine::StartCapture(const std::string &path, const CaptureSettings &settings)
+{
+    if (!m_windowTarget) {
+        return false;
+    }
+
+    return m_capture.Open(path, m_windowTarget->GetWidth(), m_windowTarget->GetHeight(), settings);
+}
+
+bool RaycasterEngine::StopCapture()
+{
+    return m_capture.Close();
+}
+
+bool RaycasterEngine::LoadReplay(const std::string &path)
+{
+    InputLog log;
+
+    if (!log.Load(path)) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::LoadReplay(): Error loading input log " << path << std::endl;
+        #endif
+        return false;
+    }
+
+    const InputLogHeader &header = log.GetHeader();
+
+    if (header.tickRate != SIMULATION_RATE || header.mapHash != GetMapHash() ||
+        header.mapColumns != static_cast<std::uint32_t>(m_worldMap.GetColumns()) ||
+        header.mapRows != static_cast<std::uint32_t>(m_worldMap.GetRows())) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::LoadReplay(): " << path << " was recorded on another map or tick rate" << std::endl;
+        #endif
+        return false;
+    }
+
+    m_inputLog = std::move(log);
+    m_isRecording = false;
+    m_isReplaying = true;
+    m_replayTick = 0;
+
+    m_rotateCamera = header.flags & INPUT_LOG_CAMERA_ROTATION;
+    SetPlayerPosition(header.start.position);
+    SetPlayerDirection(header.start.direction);
+    SetCameraPlane(header.start.plane);
+    m_previousPose = header.start;
+
+    return true;
+}
+
+bool RaycasterEngine::StepReplay()
+{
+    if (!m_isReplaying || m_replayTick >= m_inputLog.GetTickCount()) {
+        return false;
+    }
+
+    StepSimulation(m_inputLog.GetButtons(m_replayTick++));
+    return true;
+}
+
+std::uint32_t RaycasterEngine::GetMapHash() const noexcept
+{
+    std::uint32_t hash = 2166136261u;
+
+    for (int x{0}; x < m_worldMap.GetColumns(); x++) {
+        for (int y{0}; y < m_worldMap.GetRows(); y++) {
+            hash = (hash ^ static_cast<std::uint32_t>(m_worldMap.GetCell(x, y))) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+void RaycasterEngine::HandleEvents()
+{
+    SDL_Event event;
+
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            // Movement keys are held down rather than repeated, and read by
+            // the next simulation ticks
+            const std::uint8_t button = GetKeyButton(event.key.keysym.sym);
+
+            if (event.type == SDL_KEYDOWN) {
+                m_heldButtons |= button;
+            } else {
+                m_heldButtons &= ~button;
+            }
+        }
+
+        if (event.type == SDL_KEYDOWN) {
+            switch (event.key.keysym.sym) {
+                case SDLK_F12:
+                    // Only has events to write in profiling builds
+                    if (!WriteProfileTrace(PROFILE_TRACE_PATH)) {
+                        #ifdef DEBUG_MODE
+                        std::cerr << "Error writing profile trace " << PROFILE_TRACE_PATH << std::endl;
+                        #endif
+                    }
+                    break;
+                case SDLK_ESCAPE:
+                    Quit();
+                    break;
+                default:
+                    break;
+            }
+        } else if (event.type == SDL_QUIT) {
+            Quit();
+        }
+    }
+}
+
+std::uint8_t RaycasterEngine::GetKeyButton(const int key) noexcept
+{
+    switch (key) {
+        case SDLK_UP:
+            return INPUT_FORWARD;
+        case SDLK_DOWN:
+            return INPUT_BACKWARD;
+        case SDLK_LEFT:
+            return INPUT_STRAFE_LEFT;
+        case SDLK_RIGHT:
+            return INPUT_STRAFE_RIGHT;
+        case SDLK_DELETE:
+            return INPUT_TURN_LEFT;
+        case SDLK_PAGEDOWN:
+            return INPUT_TURN_RIGHT;
+        default:
+            return 0;
+    }
+}
+
+void RaycasterEngine::RenderFrame(RenderTarget &target)
+{
+    RenderFrame(target, {GetPlayerPosition(), GetPlayerDirection(), GetCameraPlane()});
+}
+
+void RaycasterEngine::RenderFrame(RenderTarget &target, const CameraPose &pose)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const FrameBuffer frame = target.Lock();
+
+    if (!frame.pixels) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::RenderFrame(): Error locking render target" << std::endl;
+        #endif
+        return;
+    }
+
+    FrameBuffer drawn = frame;
+
+    if (m_dynamicResolution) {
+        const double scale = m_resolutionController.GetScale();
+        const int width = std::max(1, static_cast<int>(frame.width * scale + 0.5));
+        const int height = std::max(1, static_cast<int>(frame.height * scale + 0.5));
+
+        if (width != frame.width || height != frame.height) {
+            m_scaledFrame.resize(static_cast<std::size_t>(width) * height);
+            drawn = {m_scaledFrame.data(), width, height, width};
+        }
+    }
+
+    ApplyMapEdits();
+
+    // Both compare with the previous frame, so go before PrepareView()
+    ViewState &view = m_view;
+    const bool cachedHits = FindStaleColumns(view, pose, drawn);
+    const int castParity = cachedHits ? -1 : GetInterlaceParity(view, pose, drawn.width);
+
+    if (castParity >= 0) {
+        PrepareInterlacedView(view);
+    }
+    PrepareView(view, pose, drawn);
+    view.castParity = castParity;
+    view.cachedHits = cachedHits;
+    // Pixels drawn with the same texels and light as last frame's
+    view.keepWalls = cachedHits && view.drawVersion == m_drawVersion && m_textureCache->HoldsAll();
+    view.mapVersion = GetDrawnMap().GetVersion();
+    view.drawVersion = m_drawVersion;
+    m_drawnMapChanges = {0, 0, -1, -1};
+
+    const int staleColumns = cachedHits ? static_cast<int>(std::count(view.staleColumns.begin(), view.staleColumns.end(), 1)) : drawn.width;
+    // The same frame as the last, pixel for pixel
+    const bool unchanged = view.keepWalls && !staleColumns && IsSameSprites(m_sprites, m_lastFrameSprites);
+    const bool copyFrame = unchanged && m_lastFrameKept && m_lastFrame.size() == static_cast<std::size_t>(frame.width) * frame.height;
+
+    if (copyFrame) {
+        PROFILE_SCOPE(COPY);
+        for (int y{0}; y < frame.height; y++) {
+            std::copy_n(&m_lastFrame[static_cast<std::size_t>(y) * frame.width], frame.width, &frame.pixels[y * frame.pitch]);
+        }
+    } else {
+        UpdateTextures(pose.position);
+        UpdateStreamedWorld(pose);
+
+        if (m_threadPool) {
+            RenderViewParallel(view);
+        } else {
+            RenderViewSerial(view);
+        }
+
+        UseStreamedChunks(view);
+    }
+
+    view.hitsCurrent = true;
+    const int cachedColumns = cachedHits ? drawn.width - staleColumns : 0;
+    m_columnStats = {drawn.width - view.reprojectedColumns - cachedColumns, view.reprojectedColumns, cachedColumns,
+                     copyFrame ? 0 : view.keepWalls ? staleColumns : drawn.width, copyFrame};
+    view.reprojectedColumns = 0;
+    m_lastFrameSprites = m_sprites;
+
+    view.frame.pixels = nullptr;
+
+    if (drawn.pixels != frame.pixels && !copyFrame) {
+        if (m_threadPool) {
+            m_threadPool->ParallelFor(frame.height, RENDER_ROW_GRAIN, [&drawn, &frame](int begin, int end) {
+                PROFILE_SCOPE(SCALE);
+                ScaleFrame(drawn, frame, begin, end);
+            });
+        } else {
+            PROFILE_SCOPE(SCALE);
+            ScaleFrame(drawn, frame, 0, frame.height);
+        }
+    }
+
+    // A frame that came out the same as the last is kept, so if the next
+    // does too it can be copied rather than drawn
+    m_lastFrameKept = unchanged;
+    if (unchanged && !copyFrame) {
+        m_lastFrame.resize(static_cast<std::size_t>(frame.width) * frame.height);
+
+        for (int y{0}; y < frame.height; y++) {
+            std::copy_n(&frame.pixels[y * frame.pitch], frame.width, &m_lastFrame[static_cast<std::size_t>(y) * frame.width]);
+        }
+    }
+
+    target.Unlock();
+
+    if (m_dynamicResolution) {
+        m_resolutionController.AddFrameTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+// Views are drawn whole, one per task, so a thread keeps a view's buffers
+// in its cache from the cast through to the copy, and threads never wait on
+// each other within a view. Views are sorted by size, so the per-thread ray
+// tables are rarely rebuilt, and then by position along a Z-order curve, so
+// the run of views each thread is dealt looks at nearby parts of the map.
+// Batches with fewer views than threads split each view across the pool
+// instead.
+RaycasterEngine::BatchStats RaycasterEngine::RenderViews(std::vector<BatchView> &views)
 {
-    #ifdef DEBUG_MODE
-    std::cout << "RaycasterEngine constructor" << std::endl;
-    #endif
+    const auto batchStart = std::chrono::steady_clock::now();
+    const int threadCount = GetRenderThreadCount();
+    const int count = static_cast<int>(views.size());
+
+    while (static_cast<int>(m_batchViews.size()) < threadCount) {
+        m_batchViews.emplace_back(new ViewState);
+    }
+
+    std::vector<std::uint32_t> zOrders(count);
+    std::vector<int> order(count);
+
+    for (int i{0}; i < count; i++) {
+        const Point<double> position = views[i].pose.position;
+        const std::uint32_t cellX = static_cast<std::uint32_t>(std::min(std::max(position.x, 0.0), 65535.0));
+        const std::uint32_t cellY = static_cast<std::uint32_t>(std::min(std::max(position.y, 0.0), 65535.0));
+
+        // Interleave the bits of the cell coordinates
+        std::uint32_t zOrder{0};
+        for (int bit{0}; bit < 16; bit++) {
+            zOrder |= ((cellX >> bit) & 1) << (2 * bit);
+            zOrder |= ((cellY >> bit) & 1) << (2 * bit + 1);
+        }
+
+        zOrders[i] = zOrder;
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&views, &zOrders](const int a, const int b) {
+        const FrameBuffer &frameA = views[a].frame;
+        const FrameBuffer &frameB = views[b].frame;
+
+        if (frameA.width != frameB.width) {
+            return frameA.width < frameB.width;
+        }
+        if (frameA.height != frameB.height) {
+            return frameA.height < frameB.height;
+        }
+        return zOrders[a] < zOrders[b];
+    });
+
+    const bool viewPerThread = m_threadPool && count >= threadCount;
+
+    // The whole batch counts as one frame of the texture cache and
+    // streamed world. Chunks aren't prefetched for batches, whose views
+    // look in every direction.
+    m_textureCache->Update();
+    if (m_streamedWorld) {
+        m_streamedWorld->Update();
+    }
+    ApplyMapEdits();
+
+    const auto renderView = [this, &views, viewPerThread](const int index, ViewState &view) {
+        BatchView &batchView = views[index];
+        batchView.milliseconds = 0;
+
+        if (!batchView.frame.pixels || batchView.frame.width <= 0 || batchView.frame.height <= 0) {
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        PrepareView(view, batchView.pose, batchView.frame);
+
+        if (m_threadPool && !viewPerThread) {
+            RenderViewParallel(view);
+        } else {
+            RenderViewSerial(view);
+        }
+
+        UseStreamedChunks(view);
+        view.frame.pixels = nullptr;
+        batchView.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    if (viewPerThread) {
+        m_threadPool->ParallelFor(count, 1, [this, &order, &renderView](int begin, int end) {
+            ViewState &view = *m_batchViews[ThreadPool::GetCurrentThreadIndex()];
+
+            for (int i{begin}; i < end; i++) {
+                renderView(order[i], view);
+            }
+        });
+    } else {
+        for (const int index : order) {
+            renderView(index, *m_batchViews[0]);
+        }
+    }
+
+    BatchStats stats{0, 0, 0, 0, 0};
+    for (const BatchView &batchView : views) {
+        if (batchView.frame.pixels && batchView.frame.width > 0 && batchView.frame.height > 0) {
+            stats.views++;
+            stats.pixels += static_cast<std::uint64_t>(batchView.frame.width) * batchView.frame.height;
+        }
+    }
+
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+    if (stats.milliseconds > 0) {
+        stats.viewsPerSecond = stats.views / (stats.milliseconds / 1000);
+        stats.megapixelsPerSecond = stats.pixels / (stats.milliseconds * 1000);
+    }
+
+    return stats;
 }
 
-RaycasterEngine::~RaycasterEngine()
+void RaycasterEngine::PrepareView(ViewState &view, const CameraPose &pose, const FrameBuffer &frame)
+{
+    view.frame = frame;
+    view.pose = pose;
+    view.columnHits.resize(frame.width);
+    view.wallRows.resize(frame.width);
+    UpdateRayTable(view.rayTable, frame.width);
+
+    view.visibleSprites.clear();
+    ProjectSprites(pose, m_sprites, frame.width, frame.height, view.visibleSprites);
+    SortSpritesByDepth(view.visibleSprites, view.spriteScratch);
+
+    // Pad columns to whole cache lines so threads drawing neighbouring
+    // columns don't share lines
+    view.screenBufferStride = (frame.height + SCREEN_BUFFER_COLUMN_ALIGNMENT - 1) / SCREEN_BUFFER_COLUMN_ALIGNMENT * SCREEN_BUFFER_COLUMN_ALIGNMENT;
+    view.screenBuffer.resize(static_cast<std::size_t>(frame.width) * view.screenBufferStride);
+}
+
+bool RaycasterEngine::FindStaleColumns(ViewState &view, const CameraPose &pose, const FrameBuffer &frame)
 {
+    // Streamed worlds change as chunks load, with no record of where
+    if (!m_columnCaching || !view.hitsCurrent || m_streamedWorld || view.frame.width != frame.width ||
+        view.frame.height != frame.height || !IsSamePose(view.pose, pose)) {
+        return false;
+    }
+
+    view.staleColumns.assign(frame.width, 0);
 
+    if (view.mapVersion == GetDrawnMap().GetVersion()) {
+        return true;
+    }
+
+    // A ray can only have changed if it crosses an edited cell on its way
+    // to the wall it hit, or hit one
+    for (int column{0}; column < frame.width; column++) {
+        const RayHit &hit = view.columnHits[column];
+        const double cameraOffset = view.rayTable.cameraOffsets[column];
+        const Point<double> end{pose.position.x + (pose.direction.x + pose.plane.x * cameraOffset) * hit.perpWallDistance,
+                                pose.position.y + (pose.direction.y + pose.plane.y * cameraOffset) * hit.perpWallDistance};
+
+        view.staleColumns[column] = SegmentTouchesRegion(pose.position, end, m_drawnMapChanges);
+    }
+
+    return true;
 }
 
-void RaycasterEngine::Init()
+int RaycasterEngine::GetInterlaceParity(const ViewState &view, const CameraPose &pose, const int width) const noexcept
 {
-    #ifdef DEBUG_MODE
-    std::cout << "RaycasterEngine::Init()" << std::endl;
-    #endif
+    const CameraPose &previous = view.pose;
+
+    // Every column is cast after a frame of another size or map, and
+    // when there are too few columns to pair up
+    if (!m_interlacing || !view.hitsCurrent || view.frame.width != width ||
+        width < 2 || view.mapVersion != GetDrawnMap().GetVersion() ||
+        !(previous.direction.x * previous.plane.y - previous.plane.x * previous.direction.y)) {
+        return -1;
+    }
 
-    SDL_Init(SDL_INIT_EVERYTHING);
-    m_screen = SDL_SetVideoMode(PROJ_PLANE_WIDTH, PROJ_PLANE_HEIGHT, 32, SDL_SWSURFACE/* | SDL_FULLSCREEN*/);
-    SDL_WM_SetCaption("Raycaster Engine", NULL);
-    SDL_EnableKeyRepeat(100, SDL_DEFAULT_REPEAT_INTERVAL);
+    const double turn = std::atan2(std::abs(previous.direction.x * pose.direction.y - previous.direction.y * pose.direction.x),
+                                   previous.direction.x * pose.direction.x + previous.direction.y * pose.direction.y);
+    const double move = std::hypot(pose.position.x - previous.position.x, pose.position.y - previous.position.y);
+    // The plane's length is the field of view
+    const double planeChange = (pose.plane.x * pose.plane.x + pose.plane.y * pose.plane.y) /
+                               (previous.plane.x * previous.plane.x + previous.plane.y * previous.plane.y);
 
-    // Generate textures
-    for (int x{0}; x < TEXTURE_WIDTH; x++) {
-        for (int y{0}; y < TEXTURE_HEIGHT; y++) {
-            // XOR
-            int xorColour = (x * 256 / TEXTURE_WIDTH) ^ (y * 256 / TEXTURE_HEIGHT);
-            m_texture[0][TEXTURE_HEIGHT * y + x] = xorColour + 256 * xorColour + 65536 + xorColour;
-            // Red with black rectangles
-            m_texture[1][TEXTURE_HEIGHT * y + x] = 65536 * 192 * (x % 16 && y % 16);
-            // Vertical plasma lines
-            m_texture[2][TEXTURE_HEIGHT * y + x] = static_cast<int>(128.f + (128.f * sin(x / 8.f)));
+    if (turn > INTERLACE_MAX_TURN || move > INTERLACE_MAX_MOVE || std::abs(planeChange - 1) > 1e-9) {
+        return -1;
+    }
+
+    return view.castParity == 0 ? 1 : 0;
+}
+
+void RaycasterEngine::PrepareInterlacedView(ViewState &view)
+{
+    const int width = view.frame.width;
+
+    // Columns are rebuilt in parallel, from any column of the last frame
+    view.previousHits.swap(view.columnHits);
+    view.previousPose = view.pose;
+
+    for (int parity{0}; parity < 2; parity++) {
+        RayTable &table = view.parityTables[parity];
+
+        if (table.screenWidth != width) {
+            table.screenWidth = width;
+            table.cameraOffsets.clear();
+
+            for (int column{parity}; column < width; column += 2) {
+                table.cameraOffsets.push_back(view.rayTable.cameraOffsets[column]);
+            }
         }
     }
+
+    view.parityHits.resize((width + 1) / 2);
 }
 
-void RaycasterEngine::Cleanup()
+void RaycasterEngine::UpdateStreamedWorld(const CameraPose &pose)
 {
-    #ifdef DEBUG_MODE
-    std::cout << "RaycasterEngine::Init()" << std::endl;
-    #endif
+    if (m_streamedWorld) {
+        m_streamedWorld->Update();
+        m_streamedWorld->Prefetch(pose.position, pose.direction, WORLD_PREFETCH_DISTANCE);
+    }
 }
 
-void RaycasterEngine::Run()
+void RaycasterEngine::UseStreamedChunks(const ViewState &view)
 {
-    #ifdef DEBUG_MODE
-    std::cout << "RaycasterEngine::Run()" << std::endl;
-    #endif
+    if (!m_streamedWorld) {
+        return;
+    }
 
-    SDL_Event event;
+    // Every ray runs from the camera to its hit cell, and the hit cells
+    // of rays stopped by unloaded chunks are in those chunks
+    int minX = static_cast<int>(std::floor(view.pose.position.x));
+    int minY = static_cast<int>(std::floor(view.pose.position.y));
+    int maxX = minX;
+    int maxY = minY;
 
-    while (IsRunning()) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_KEYDOWN) {
-                switch (event.key.keysym.sym) {
-                    case SDLK_UP:
-                        #ifdef DEBUG_MODE
-                        std::cout << "Up key pressed" << std::endl;
-                        #endif
+    for (int column{0}; column < view.frame.width; column++) {
+        const RayHit &hit = view.columnHits[column];
 
-                        MovePlayer(MovementDirection::FORWARD, MOVEMENT_SPEED);
+        minX = std::min(minX, hit.cellX);
+        minY = std::min(minY, hit.cellY);
+        maxX = std::max(maxX, hit.cellX);
+        maxY = std::max(maxY, hit.cellY);
+    }
 
-                        if (IsPlayerInWall()) {
-                            MovePlayer(MovementDirection::BACKWARD, MOVEMENT_SPEED);
-                        }
+    m_streamedWorld->Use(minX, minY, maxX, maxY);
+}
 
-                        break;
-                    case SDLK_DOWN:
-                        #ifdef DEBUG_MODE
-                        std::cout << "Down key pressed" << std::endl;
-                        #endif
+void RaycasterEngine::RenderViewParallel(ViewState &view)
+{
+    // Interlaced columns are rebuilt against the columns cast either side,
+    // so those are all cast first
+    if (view.castParity >= 0) {
+        const int count = static_cast<int>(view.parityTables[view.castParity].cameraOffsets.size());
+
+        m_threadPool->ParallelFor(count, RENDER_COLUMN_GRAIN, [this, &view](int begin, int end) {
+            CastParityColumns(view, begin, end);
+        });
+    }
 
-                        MovePlayer(MovementDirection::BACKWARD, MOVEMENT_SPEED);
+    // Columns only read the pose, map and textures and write their own
+    // pixels, so ranges of them can be drawn on any thread
+    std::atomic<int> reprojected{0};
+    m_threadPool->ParallelFor(view.frame.width, RENDER_COLUMN_GRAIN, [this, &view, &reprojected](int begin, int end) {
+        const int count = RenderColumns(view, begin, end);
+        if (count) {
+            reprojected.fetch_add(count, std::memory_order_relaxed);
+        }
+    });
+    view.reprojectedColumns = reprojected.load();
+    m_threadPool->ParallelFor(view.frame.height, RENDER_ROW_GRAIN, [this, &view](int begin, int end) {
+        {
+            PROFILE_SCOPE(COPY);
+            CopyColumnsToRows(view.screenBuffer.data(), view.screenBufferStride, view.frame, begin, end);
+        }
 
-                        if (IsPlayerInWall()) {
-                            MovePlayer(MovementDirection::FORWARD, MOVEMENT_SPEED);
-                        }
-                        break;
-                    case SDLK_LEFT:
-                        #ifdef DEBUG_MODE
-                        std::cout << "Left key pressed" << std::endl;
-                        #endif
+        DrawFloorRows(view, begin, end);
+    });
 
-                        StrafePlayer(MovementDirection::LEFT, MOVEMENT_SPEED);
+    // Sprites test each column against its wall hit distance, so they
+    // are drawn in batches of columns once the walls are all cast
+    if (!view.visibleSprites.empty()) {
+        m_threadPool->ParallelFor(view.frame.width, SPRITE_COLUMN_GRAIN, [this, &view](int begin, int end) {
+            DrawSprites(view, begin, end);
+        });
+    }
+}
 
-                        if (IsPlayerInWall()) {
-                            StrafePlayer(MovementDirection::RIGHT, MOVEMENT_SPEED);
-                        }
-                        break;
-                    case SDLK_RIGHT:
-                        #ifdef DEBUG_MODE
-                        std::cout << "Right key pressed" << std::endl;
-                        #endif
+void RaycasterEngine::RenderViewSerial(ViewState &view)
+{
+    if (view.castParity >= 0) {
+        CastParityColumns(view, 0, static_cast<int>(view.parityTables[view.castParity].cameraOffsets.size()));
+    }
 
-                        StrafePlayer(MovementDirection::RIGHT, MOVEMENT_SPEED);
+    view.reprojectedColumns = RenderColumns(view, 0, view.frame.width);
 
-                        if (IsPlayerInWall()) {
-                            StrafePlayer(MovementDirection::LEFT, MOVEMENT_SPEED);
-                        }
-                        break;
-                    case SDLK_PAGEDOWN:
-                        #ifdef DEBUG_MODE
-                        std::cout << "Page Down key pressed" << std::endl;
-                        #endif
+    {
+        PROFILE_SCOPE(COPY);
+        CopyColumnsToRows(view.screenBuffer.data(), view.screenBufferStride, view.frame, 0, view.frame.height);
+    }
 
-                        TurnPlayer(MovementDirection::RIGHT, TURN_ANGLE);
-                        break;
-                    case SDLK_DELETE:
-                        #ifdef DEBUG_MODE
-                        std::cout << "Delete key pressed" << std::endl;
-                        #endif
+    DrawFloorRows(view, 0, view.frame.height);
+    DrawSprites(view, 0, view.frame.width);
+}
 
-                        TurnPlayer(MovementDirection::LEFT, TURN_ANGLE);
-                        break;
-                    case SDLK_ESCAPE:
-                        #ifdef DEBUG_MODE
-                        std::cout << "ESC key pressed" << std::endl;
-                        #endif
-                        Quit();
-                        break;
-                    default:
-                        break;
+void RaycasterEngine::CastParityColumns(ViewState &view, const int firstIndex, const int lastIndex)
+{
+    PROFILE_SCOPE(CAST);
+    const RayTable &table = view.parityTables[view.castParity];
+
+    if (m_streamedWorld) {
+        CastColumns(*m_streamedWorld, view.pose, table, firstIndex, lastIndex, &view.parityHits[firstIndex]);
+    } else {
+        CastColumns(m_castKernel, GetDrawnMap().GetView(), view.pose, table, firstIndex, lastIndex, &view.parityHits[firstIndex]);
+    }
+}
+
+int RaycasterEngine::RenderColumns(ViewState &view, const int firstColumn, const int lastColumn)
+{
+    int reprojected{0};
+
+    {
+        PROFILE_SCOPE(CAST);
+        if (view.castParity >= 0) {
+            reprojected = ReprojectColumns(view, firstColumn, lastColumn);
+        } else if (view.cachedHits) {
+            // Runs of columns whose rays crossed an edit are cast together
+            for (int column{firstColumn}; column < lastColumn;) {
+                if (!view.staleColumns[column]) {
+                    column++;
+                    continue;
                 }
-            } else if (event.type == SDL_QUIT) {
-                #ifdef DEBUG_MODE
-                std::cout << "Close button pressed" << std::endl;
-                #endif
-                Quit();
+
+                int end{column + 1};
+                while (end < lastColumn && view.staleColumns[end]) {
+                    end++;
+                }
+
+                CastColumns(m_castKernel, GetDrawnMap().GetView(), view.pose, view.rayTable, column, end, &view.columnHits[column]);
+                column = end;
             }
+        } else if (m_streamedWorld) {
+            CastColumns(*m_streamedWorld, view.pose, view.rayTable, firstColumn, lastColumn, &view.columnHits[firstColumn]);
+        } else {
+            CastColumns(m_castKernel, GetDrawnMap().GetView(), view.pose, view.rayTable, firstColumn, lastColumn, &view.columnHits[firstColumn]);
         }
+    }
 
-        if (m_rotateCamera) {
-            RotateCamera(MovementDirection::RIGHT, ROTATE_CAMERA_ANGLE);
+    PROFILE_SCOPE(DRAW);
+    for (int i{firstColumn}; i < lastColumn; i++) {
+        // Kept walls still have last frame's pixels and rows
+        if (!view.keepWalls || view.staleColumns[i]) {
+            DrawColumn(view, i, view.columnHits[i]);
         }
+    }
 
-        //std::cout << "x: " << GetPlayerPosition().x << "    y: " << GetPlayerPosition().y << std::endl << "x: " << GetPlayerDirection().x << "    y: " << GetPlayerDirection().y << std::endl << std::endl;
+    return reprojected;
+}
 
-        SDL_FillRect(GetScreen(), NULL, BACKGROUND_COLOUR);
-        if (SDL_MUSTLOCK(GetScreen())) {
-            SDL_LockSurface(GetScreen());
-        }
-
-        for (int i{0}; i < GetScreen()->w; i++) {
-            // Calculate camera offset on x axis
-            // This value is always between 1 and -1
-            double cameraOffsetX = 2 * i / static_cast<double>(GetScreen()->w) - 1;
-
-            // Ray is emitted from player position
-            Point<double> rayPosition = GetPlayerPosition();
-            // Calculate ray direction
-            Point<double> rayDirection;
-            rayDirection.x = GetPlayerDirection().x + GetCameraPlane().x * cameraOffsetX;
-            rayDirection.y = GetPlayerDirection().y + GetCameraPlane().y * cameraOffsetX;
-
-            //Wall curWall = GetWallForRay(rayPosition, rayDirection);
-
-            // Cell on 2D map grid where is the origin of the ray
-            // This is the position of the ray, which is the player position
-            Point<double> mapCell;
-            mapCell.x = static_cast<int>(rayPosition.x);
-            mapCell.y = static_cast<int>(rayPosition.y);
-
-            // Delta distance is the distance the ray needs to travel to get
-            // from one x-side to the next x-side, or from one y-side to the
-            // next y-side
-            Point<double> deltaDistance;
-            deltaDistance.x = sqrt(1 + (rayDirection.y * rayDirection.y) / (rayDirection.x * rayDirection.x));
-            deltaDistance.y = sqrt(1 + (rayDirection.x * rayDirection.x) / (rayDirection.y * rayDirection.y));
-
-            // Distance the ray must travel from its starting position
-            // (current player position on 2D map grid) to the first x-side and
-            // the first y-side
-            Point<double> sideDistance;
-
-            // Offset that specifies the direction the ray will travel (+1 or -1)
-            Point<double> step;
-
-            // If ray direction has a negative x-component,
-            // sideDistance.x = distance from starting position to first side on
-            // the left of the starting position.
-            if (rayDirection.x < 0) {
-                step.x = -1;
-                sideDistance.x = (rayPosition.x - mapCell.x) * deltaDistance.x;
-                // If ray direction has a positive x-component,
-                // sideDistance.x = distance from starting position to first side on
-                // the right of the starting position.
-            } else {
-                step.x = 1;
-                sideDistance.x = ((mapCell.x + 1.0f) - rayPosition.x) * deltaDistance.x;
-            }
+// The columns cast this frame take their hits. The others take the hit
+// of the previous frame's column that looked the same way, moved onto the
+// same face for the new pose. A moved hit is kept if it is on the face of
+// the cast columns either side of it, or on one of them and no farther
+// than the other, as there is then no room between them for a nearer
+// wall. The rest are cast one by one.
+int RaycasterEngine::ReprojectColumns(ViewState &view, const int firstColumn, const int lastColumn)
+{
+    const CameraPose &pose = view.pose;
+    const CameraPose &previous = view.previousPose;
+    const MapView map = GetDrawnMap().GetView();
+    const int width = view.frame.width;
+    const double halfWidth = width / 2.0;
+    // Solves ray directions for the previous camera as ProjectSprites()
+    // does sprite positions; GetInterlaceParity() checked it isn't zero
+    const double inverseDeterminant = 1 / (previous.direction.x * previous.plane.y - previous.plane.x * previous.direction.y);
+    int reprojected{0};
+
+    for (int column{firstColumn}; column < lastColumn; column++) {
+        RayHit &hit = view.columnHits[column];
+
+        if ((column & 1) == view.castParity) {
+            hit = view.parityHits[column / 2];
+            continue;
+        }
 
-            // If ray direction has a negative y-component,
-            // sideDistance.y = distance from starting position to first side
-            // above the starting position.
-            if (rayDirection.y < 0) {
-                step.y = -1;
-                sideDistance.y = (rayPosition.y - mapCell.y) * deltaDistance.y;
-                // If ray direction has a positive y-component,
-                // sideDistance.y = distance from starting position to first side
-                // below the starting position.
-            } else {
-                step.y = 1;
-                sideDistance.y = ((mapCell.y + 1.0f) - rayPosition.y) * deltaDistance.y;
-            }
+        const double cameraOffset = view.rayTable.cameraOffsets[column];
+        const Point<double> direction{pose.direction.x + pose.plane.x * cameraOffset, pose.direction.y + pose.plane.y * cameraOffset};
+        const double depth = (direction.x * previous.plane.y - previous.plane.x * direction.y) * inverseDeterminant;
+        const double across = (previous.direction.x * direction.y - direction.x * previous.direction.y) * inverseDeterminant;
+        const double source = depth > 0 ? std::floor(halfWidth * (1 + across / depth)) : -1;
+
+        const RayHit *left = column > 0 ? &view.parityHits[(column - 1) / 2] : nullptr;
+        const RayHit *right = column + 1 < width ? &view.parityHits[(column + 1) / 2] : nullptr;
+        RayHit moved;
+        bool found = source >= 0 && source < width;
+
+        if (found) {
+            const RayHit &previousHit = view.previousHits[static_cast<int>(source)];
+            found = m_streamedWorld ? ReprojectHit(*m_streamedWorld, pose.position, direction, previousHit, moved)
+                                    : ReprojectHit(map, pose.position, direction, previousHit, moved);
+        }
 
-            bool wallHit = false;
-            bool sideHit = false;
+        if (found && IsReprojectionVisible(moved, left, right)) {
+            hit = moved;
+            reprojected++;
+        } else {
+            hit = m_streamedWorld ? CastRay(*m_streamedWorld, pose.position, direction) : CastRay(map, pose.position, direction);
+        }
+    }
 
-            double perpWallDistance;
+    return reprojected;
+}
 
-            // Perform DDA algorithm
+void RaycasterEngine::DrawColumn(ViewState &view, const int column, const RayHit &hit)
+{
+    const bool sideHit = hit.sideHit;
+    unsigned int *pixels = &view.screenBuffer[column * view.screenBufferStride];
 
-            // The ray has hit a wall
-            while (!wallHit) {
-                if (sideDistance.x < sideDistance.y) {
-                    sideDistance.x += deltaDistance.x;
-                    mapCell.x += step.x;
-                    sideHit = false;
-                } else {
-                    sideDistance.y += deltaDistance.y;
-                    mapCell.y += step.y;
-                    sideHit = true;
-                }
+    Wall curWall;
+    curWall.height = GetHeightForWallDistance(hit.perpWallDistance, view.frame.height);
 
-                wallHit = GetWorldMapCell(mapCell);
-            }
+    const int OFFSET = (view.frame.height - curWall.height) / 2;
 
-            // Check if the ray has hit the side of a wall
-            if (!sideHit) {
-                perpWallDistance = std::abs((mapCell.x - rayPosition.x + (1 - step.x) / 2) / rayDirection.x);
-            } else {
-                perpWallDistance = std::abs((mapCell.y - rayPosition.y + (1 - step.y) / 2) / rayDirection.y);
-            }
+    // The floor and ceiling above and below are filled in by DrawFloorRows()
+    view.wallRows[column] = {OFFSET, OFFSET + curWall.height};
 
-            Wall curWall;
-            curWall.height = GetHeightForWallDistance(perpWallDistance);
+    if (!curWall.height) {
+        return;
+    }
 
-            if (!GetTexturesEnabled()) {
-                curWall.colour = GetWallColour(mapCell);
+    WallSpan span;
+    int mode{0};
 
-                if (sideHit) {
-                    curWall.colour *= WALL_SIDE_COLOUR_MULTIPLIER;
-                }
-            }
+    // Lit side walls take a darker light level rather than side shading
+    if (m_lighting) {
+        span.shade = &m_colourMap.GetTable(m_colourMap.GetLevel(hit.perpWallDistance, sideHit));
+        mode |= WALL_SPAN_LIT;
+    } else if (sideHit) {
+        mode |= WALL_SPAN_SIDE_SHADED;
+    }
 
-            //int numTexture = GetWorldMapCell(mapCell) - 1;
+    if (GetTexturesEnabled()) {
+        // The level is chosen from the wall's full height, before it is
+        // clipped to the screen
+        const int texture = (hit.cellValue - 1) % m_textureCache->GetTextureCount();
+        const MipLevel level = m_textureCache->Get(texture, GetTextureLevel(texture, view.frame.height / hit.perpWallDistance));
+        const int textureX = static_cast<int>(hit.wallX * static_cast<double>(level.width));
+
+        span.texels = &level.texels[textureX * level.height];
+        span.texelPitch = 1;
+        SetWallSpanTextureRows(span, level.height, curWall.height, view.frame.height);
+        mode |= WALL_SPAN_TEXTURED;
+    } else {
+        span.colour = m_flatColours[sideHit && !m_lighting][hit.cellValue];
+    }
 
-            double wallX;
-            if (sideHit) {
-                wallX = rayPosition.x + ((mapCell.y - rayPosition.y + (1 - step.y) / 2) / rayDirection.y) * rayDirection.x;
-            } else {
-                wallX = rayPosition.y + ((mapCell.x - rayPosition.x + (1 - step.x) / 2) / rayDirection.x) * rayDirection.y;
-            }
-            wallX -= floor(wallX);
+    GetWallSpanKernel(mode)(pixels + OFFSET, curWall.height, span);
+}
 
-            int textureX = static_cast<int>(wallX * static_cast<double>(TEXTURE_WIDTH));
-            if ((!sideHit && rayDirection.x > 0) || (sideHit && rayDirection.x < 0)) {
-                // Comment out this line - fix texture glitch?
-                //textureX = TEXTURE_WIDTH - textureX - 1;
-            }
+void RaycasterEngine::DrawFloorRows(const ViewState &view, const int firstRow, const int lastRow)
+{
+    PROFILE_SCOPE(FLOOR);
 
-            const int OFFSET = (GetScreen()->h - curWall.height) / 2;
+    // A wall at distance d is height / d pixels tall around the middle of
+    // the screen, so the floor seen on a row p pixels from the middle is at
+    // distance (height / 2) / p. Ceiling rows mirror the floor rows.
+    const double horizon = view.frame.height / 2.0;
 
-            for (int j{OFFSET}; j < OFFSET + curWall.height; j++) {
-                if (GetTexturesEnabled()) {
-                    int wallDistance = j * 256 - PROJ_PLANE_HEIGHT * 128 + curWall.height * 128;
-                    int textureY = ((wallDistance * TEXTURE_HEIGHT) / curWall.height) / 256;
-                    unsigned int colour = m_texture[GetWorldMapCell(mapCell) - 1][TEXTURE_HEIGHT * textureY + textureX];
+    for (int y{firstRow}; y < lastRow; y++) {
+        const double rowCentre = y + 0.5;
+        const double rowDistance = horizon / std::max(std::abs(rowCentre - horizon), 0.5);
 
-                    if (sideHit) {
-                        colour = (colour >> 1) & 8355711;
-                    }
+        if (rowCentre > horizon) {
+            m_lighting ? DrawFloorRow<true, true>(view, y, rowDistance) : DrawFloorRow<true, false>(view, y, rowDistance);
+        } else {
+            m_lighting ? DrawFloorRow<false, true>(view, y, rowDistance) : DrawFloorRow<false, false>(view, y, rowDistance);
+        }
+    }
+}
 
-                    SetPixel({i, j}, colour);
-                    //m_screenBuffer[i][j] = colour;
-                } else {
-                    SetPixel({i, j}, curWall.colour);
-                }
+// One scanline: the floor point under the leftmost column and its step per
+// column are worked out once, then texels are stepped across in 32.32 fixed
+// point. Only pixels outside the column's wall are written.
+template <bool FLOOR, bool LIT>
+void RaycasterEngine::DrawFloorRow(const ViewState &view, const int row, const double rowDistance)
+{
+    const std::int64_t ONE = std::int64_t{1} << 32;
+    const int width = view.frame.width;
+    unsigned int *pixels = &view.frame.pixels[row * view.frame.pitch];
+    const WallRows *walls = view.wallRows.data();
+    // The whole row is at the same distance, so at the same light level
+    const ShadeTable &shade = m_colourMap.GetTable(LIT ? m_colourMap.GetLevel(rowDistance, false) : 0);
+
+    if (!GetTexturesEnabled()) {
+        const unsigned int colour = LIT ? ShadeTexel(BACKGROUND_COLOUR, shade) : BACKGROUND_COLOUR;
+
+        for (int x{0}; x < width; x++) {
+            if (FLOOR ? row >= walls[x].bottom : row < walls[x].top) {
+                pixels[x] = colour;
             }
         }
+        return;
+    }
+
+    // Rays of the leftmost column and the step between columns, matching
+    // the camera offsets of the ray table
+    const CameraPose &pose = view.pose;
+    const Point<double> leftRay{pose.direction.x - pose.plane.x, pose.direction.y - pose.plane.y};
+    const Point<double> rayStep{2 * pose.plane.x / width, 2 * pose.plane.y / width};
+
+    std::int64_t floorX = static_cast<std::int64_t>((pose.position.x + rowDistance * leftRay.x) * ONE);
+    std::int64_t floorY = static_cast<std::int64_t>((pose.position.y + rowDistance * leftRay.y) * ONE);
+    const std::int64_t stepX = static_cast<std::int64_t>(rowDistance * rayStep.x * ONE);
+    const std::int64_t stepY = static_cast<std::int64_t>(rowDistance * rayStep.y * ONE);
+
+    // A cell of floor at rowDistance is about as many pixels across as a
+    // wall there is tall
+    const int texture = (FLOOR ? FLOOR_TEXTURE : CEILING_TEXTURE) % m_textureCache->GetTextureCount();
+    const MipLevel level = m_textureCache->Get(texture, GetTextureLevel(texture, view.frame.height / rowDistance));
+    const std::int64_t levelWidth = level.width;
+    const std::int64_t levelHeight = level.height;
+
+    for (int x{0}; x < width; x++, floorX += stepX, floorY += stepY) {
+        if (FLOOR ? row >= walls[x].bottom : row < walls[x].top) {
+            // Fraction of the cell times the texture size
+            const int textureX = static_cast<int>(((floorX & 0xFFFFFFFF) * levelWidth) >> 32);
+            const int textureY = static_cast<int>(((floorY & 0xFFFFFFFF) * levelHeight) >> 32);
+            const unsigned int colour = level.texels[level.height * textureX + textureY];
+            pixels[x] = LIT ? ShadeTexel(colour, shade) : colour;
+        }
+    }
+}
+
+void RaycasterEngine::DrawSprites(const ViewState &view, const int firstColumn, const int lastColumn)
+{
+    if (view.visibleSprites.empty()) {
+        return;
+    }
+
+    PROFILE_SCOPE(SPRITES);
 
-        if (SDL_MUSTLOCK(GetScreen())) {
-            SDL_LockSurface(GetScreen());
+    const std::int64_t ONE = std::int64_t{1} << 32;
+    const int height = view.frame.height;
+    const int pitch = view.frame.pitch;
+
+    for (const VisibleSprite &sprite : view.visibleSprites) {
+        const int first = std::max(firstColumn, sprite.firstColumn);
+        const int last = std::min(lastColumn, sprite.lastColumn);
+
+        if (first >= last || sprite.texture < 0 || sprite.texture >= m_textureCache->GetTextureCount()) {
+            continue;
         }
 
-        SDL_Flip(GetScreen());
+        const MipLevel level = m_textureCache->Get(sprite.texture, GetTextureLevel(sprite.texture, sprite.size));
+        const ShadeTable *shade = m_lighting ? &m_colourMap.GetTable(m_colourMap.GetLevel(sprite.depth, false)) : nullptr;
+
+        // Standing on the floor, centred on the horizon like a wall
+        const int top = (height - sprite.size) / 2;
+        const int firstRow = std::max(0, top);
+        const int lastRow = std::min(height, top + sprite.size);
+        const std::int64_t textureStep = (level.height * ONE + sprite.size - 1) / sprite.size;
+        const std::int64_t firstTextureY = (firstRow - top) * textureStep;
+
+        for (int x{first}; x < last; x++) {
+            // Hidden behind this column's wall
+            if (sprite.depth >= view.columnHits[x].perpWallDistance) {
+                continue;
+            }
+
+            const int textureX = std::min(level.width - 1, static_cast<int>((x - sprite.left) * level.width / sprite.size));
+            const unsigned int *texels = &level.texels[textureX * level.height];
+            unsigned int *pixel = &view.frame.pixels[firstRow * pitch + x];
+            std::int64_t textureY = firstTextureY;
 
-        m_prevFrameTime = m_curFrameTime;
-        m_curFrameTime = SDL_GetTicks();
-        double frameTime = (m_curFrameTime - m_prevFrameTime) / 1000.0f;
+            for (int y{firstRow}; y < lastRow; y++, pixel += pitch, textureY += textureStep) {
+                const unsigned int colour = texels[textureY >> 32];
+
+                // Transparency is decided before shading
+                if (colour) {
+                    *pixel = shade ? ShadeTexel(colour, *shade) : colour;
+                }
+            }
+        }
+    }
+}
 
-        std::cout << frameTime << std::endl;
+void RaycasterEngine::SetRenderThreadCount(const int count)
+{
+    if (count == 1) {
+        m_threadPool.reset();
+    } else if (!m_threadPool || count != m_threadPool->GetThreadCount()) {
+        m_threadPool.reset(new ThreadPool(count));
 
-        m_movementSpeed = frameTime * 5.0f;
-        m_rotateSpeed = frameTime * 3.0f;
+        if (m_threadPool->GetThreadCount() == 1) {
+            m_threadPool.reset();
+        }
     }
+}
 
-    SDL_Quit();
+void RaycasterEngine::CastRays(const std::vector<RayQuery> &queries, std::vector<RayQueryHit> &hits, const bool parallel)
+{
+    const MapView map = m_worldMap.GetView();
+    hits.resize(queries.size());
+
+    RunQueries(static_cast<int>(queries.size()), parallel, [&map, &queries, &hits](int begin, int end) {
+        Raycaster::CastRays(map, &queries[begin], end - begin, &hits[begin]);
+    });
 }
 
-void RaycasterEngine::SetPixel(const Point<int> coordinates, const unsigned int pixel)
+void RaycasterEngine::TestLineOfSight(const std::vector<SightQuery> &queries, std::vector<std::uint8_t> &visible, const bool parallel)
 {
-    unsigned int *pixels = reinterpret_cast<unsigned int*>(GetScreen()->pixels);
+    const MapView map = m_worldMap.GetView();
+    visible.resize(queries.size());
 
-    if (!pixels) {
-        #ifdef DEBUG_MODE
-        std::cerr << "RaycasterEngine::SetPixel(): Error retrieving SDL screen (null pointer)" << std::endl;
-        #endif
-        return;
+    RunQueries(static_cast<int>(queries.size()), parallel, [&map, &queries, &visible](int begin, int end) {
+        Raycaster::TestLineOfSight(map, &queries[begin], end - begin, &visible[begin]);
+    });
+}
 
-        //throw std::runtime_error("Error accessing SDL screen pixels");
+void RaycasterEngine::SweepCircles(const std::vector<SweepQuery> &queries, std::vector<SweepResult> &results, const bool parallel)
+{
+    const MapView map = m_worldMap.GetView();
+    results.resize(queries.size());
+
+    RunQueries(static_cast<int>(queries.size()), parallel, [&map, &queries, &results](int begin, int end) {
+        Raycaster::SweepCircles(map, &queries[begin], end - begin, &results[begin]);
+    });
+}
+
+void RaycasterEngine::RunQueries(const int count, const bool parallel, const std::function<void(int, int)> &task)
+{
+    if (parallel && m_threadPool) {
+        m_threadPool->ParallelFor(count, QUERY_GRAIN, task);
+    } else if (count > 0) {
+        task(0, count);
     }
+}
 
-    pixels[(coordinates.y * GetScreen()->w) + coordinates.x] = pixel;
+void RaycasterEngine::SetDynamicResolution(const bool enable)
+{
+    m_dynamicResolution = enable;
+    m_resolutionController.Reset();
 }
 
-unsigned int RaycasterEngine::GetWallColour(const Point<double> mapCell) noexcept
+void RaycasterEngine::SetEmptySpaceSkipping(const bool enable)
 {
-    const int cellValue = GetWorldMapCell(mapCell);
-    unsigned int wallColour;
+    m_skipEmptySpace = enable;
 
-    switch (cellValue) {
-        case 1:
-            wallColour = SDL_MapRGB(GetScreen()->format, 0xFF, 0, 0);
-            break;
-        case 2:
-            wallColour = SDL_MapRGB(GetScreen()->format, 0, 0xFF, 0);
-            break;
-        default:
-            wallColour = SDL_MapRGB(GetScreen()->format, 0, 0, 0xFF);
-            break;
+    if (enable) {
+        m_worldMap.BuildDistanceField();
+    } else {
+        m_worldMap.ClearDistanceField();
     }
 
-    return wallColour;
+    if (m_drawnMap) {
+        CopyDrawnMap();
+    }
 }
 
-int RaycasterEngine::GetHeightForWallDistance(const double distance) const
+void RaycasterEngine::SetPixel(const Point<int> coordinates, const unsigned int pixel)
 {
-    if (!distance) {
+    if (!m_view.frame.pixels) {
         #ifdef DEBUG_MODE
-        std::cerr << "RaycasterEngine::GetHeightForWallDistance(): distance cannot be zero (division be zero)" << std::endl;
+        std::cerr << "RaycasterEngine::SetPixel(): No frame is being drawn" << std::endl;
         #endif
-        return 0; // TODO: return error code
+        return;
+
+        //throw std::runtime_error("Error accessing SDL screen pixels");
     }
 
-    const int WALL_HEIGHT = std::abs(PROJ_PLANE_HEIGHT / distance);
-    return std::min(WALL_HEIGHT, PROJ_PLANE_HEIGHT);
+    m_view.screenBuffer[(coordinates.x * m_view.screenBufferStride) + coordinates.y] = pixel;
 }
 
-void RaycasterEngine::SetPlayerPosition(const Point<double> newPosition) noexcept
+unsigned int RaycasterEngine::GetWallColour(const Point<double> mapCell) noexcept
 {
-    m_playerPosition = newPosition;
+    return m_flatColours[0][GetWorldMapCell(mapCell)];
 }
 
-void RaycasterEngine::SetPlayerDirection(const Point<double> newDirection) noexcept
+int RaycasterEngine::GetHeightForWallDistance(const double distance, const int screenHeight) const
 {
-    m_playerDirection = newDirection;
-}
+    if (!distance) {
+        #ifdef DEBUG_MODE
+        std::cerr << "RaycasterEngine::GetHeightForWallDistance(): distance cannot be zero (division be zero)" << std::endl;
+        #endif
+        return 0; // TODO: return error code
+    }
 
-void RaycasterEngine::SetCameraPlane(const Point<double> newPlane) noexcept
-{
-    m_cameraPlane = newPlane;
+    const int WALL_HEIGHT = std::abs(screenHeight / distance);
+    return std::min(WALL_HEIGHT, screenHeight);
 }
 
 void RaycasterEngine::MovePlayer(const MovementDirection direction, const float speed) noexcept
@@ -401,23 +1551,8 @@ void RaycasterEngine::MovePlayer(const MovementDirection direction, const float
     }
 
     const float SPEED = (direction == MovementDirection::FORWARD) ? speed : -speed;
-    //const float SPEED = m_movementSpeed;
-
-    Point<double> predictedPosition;
-    predictedPosition.x = static_cast<int>(GetPlayerPosition().x - GetPlayerDirection().x * SPEED);
-    predictedPosition.y = static_cast<int>(GetPlayerPosition().y);
-
-    Point<double> newPlayerPosition = GetPlayerPosition();
-
-    if (!GetWorldMapCell(predictedPosition)) {
-        newPlayerPosition.x = GetPlayerPosition().x + GetPlayerDirection().x * SPEED;
-    }
-
-    if (!GetWorldMapCell({static_cast<int>(GetPlayerPosition().x), static_cast<int>(GetPlayerPosition().x - GetPlayerDirection().x * SPEED)})) {
-        newPlayerPosition.y = GetPlayerPosition().y + GetPlayerDirection().y * SPEED;
-    }
 
-    SetPlayerPosition(newPlayerPosition);
+    MovePlayerBy({GetPlayerDirection().x * SPEED, GetPlayerDirection().y * SPEED});
 }
 
 void RaycasterEngine::StrafePlayer(const MovementDirection direction, const float speed) noexcept
@@ -438,11 +1573,43 @@ void RaycasterEngine::StrafePlayer(const MovementDirection direction, const floa
 
     const float SPEED = (direction == MovementDirection::RIGHT) ? speed : -speed;
 
-    Point<double> newPlayerPosition;
-    newPlayerPosition.x = GetPlayerPosition().x + GetCameraPlane().x * SPEED;
-    newPlayerPosition.y = GetPlayerPosition().y + GetCameraPlane().y * SPEED;
+    MovePlayerBy({GetCameraPlane().x * SPEED, GetCameraPlane().y * SPEED});
+}
+
+void RaycasterEngine::MovePlayerBy(const Point<double> movement) noexcept
+{
+    MapView map = m_worldMap.GetView();
+    Point<double> origin{0, 0};
+
+    // A streamed world is swept through a copy of the cells around the
+    // player, cells past its edge reading as walls
+    const int windowSide = 2 * MOVE_WINDOW_RADIUS + 1;
+    std::uint8_t window[windowSide * windowSide];
+
+    if (m_streamedWorld) {
+        const int x = static_cast<int>(std::floor(GetPlayerPosition().x)) - MOVE_WINDOW_RADIUS;
+        const int y = static_cast<int>(std::floor(GetPlayerPosition().y)) - MOVE_WINDOW_RADIUS;
+
+        m_streamedWorld->CopyCells(x, y, windowSide, windowSide, window, windowSide);
+        map = {window, windowSide, windowSide, windowSide, 0, nullptr};
+        origin = {static_cast<double>(x), static_cast<double>(y)};
+    }
+
+    SweepQuery sweep{{GetPlayerPosition().x - origin.x, GetPlayerPosition().y - origin.y}, movement, PLAYER_RADIUS};
+    SweepResult result;
 
-    SetPlayerPosition(newPlayerPosition);
+    Raycaster::SweepCircles(map, &sweep, 1, &result);
+
+    // Slide along the wall with what is left of the movement
+    if (result.hit) {
+        const Point<double> left{movement.x * (1 - result.fraction), movement.y * (1 - result.fraction)};
+        const double into = left.x * result.normal.x + left.y * result.normal.y;
+
+        sweep = {result.position, {left.x - into * result.normal.x, left.y - into * result.normal.y}, PLAYER_RADIUS};
+        Raycaster::SweepCircles(map, &sweep, 1, &result);
+    }
+
+    SetPlayerPosition({result.position.x + origin.x, result.position.y + origin.y});
 }
 
 void RaycasterEngine::TurnPlayer(const MovementDirection direction, const float angle) noexcept
@@ -458,21 +1625,27 @@ void RaycasterEngine::TurnPlayer(const MovementDirection direction, const float
         return;
     }
 
-    const float ANGLE = (direction == MovementDirection::LEFT) ? angle : -angle;
+    const Rotation rotation = (direction == MovementDirection::LEFT) ? GetRotation(angle) : InvertRotation(GetRotation(angle));
 
-    double oldPlayerDirectionX = GetPlayerDirection().x;
+    SetPlayerDirection(Rotate(GetPlayerDirection(), rotation));
+    SetCameraPlane(Rotate(GetCameraPlane(), rotation));
+}
 
-    Point<double> newPlayerDirection;
-    newPlayerDirection.x = GetPlayerDirection().x * cos(ANGLE) - GetPlayerDirection().y * sin(ANGLE);
-    newPlayerDirection.y = oldPlayerDirectionX * sin(ANGLE) + GetPlayerDirection().y * cos(ANGLE);
-    SetPlayerDirection(newPlayerDirection);
+const Rotation& RaycasterEngine::GetRotation(const float angle) noexcept
+{
+    for (const CachedRotation &cached : m_rotations) {
+        if (cached.angle == angle) {
+            return cached.rotation;
+        }
+    }
 
-    double oldCameraPlaneX = GetCameraPlane().x;
-    Point<double> newCameraPlane;
+    // Not one of the turn angles; replace the oldest entry after them
+    CachedRotation &cached = m_rotations[m_nextRotation];
+    m_nextRotation = m_nextRotation + 1 < ROTATION_CACHE_SIZE ? m_nextRotation + 1 : PINNED_ROTATIONS;
 
-    newCameraPlane.x = GetCameraPlane().x * cos(ANGLE) - GetCameraPlane().y * sin(ANGLE);
-    newCameraPlane.y = oldCameraPlaneX * sin(ANGLE) + GetCameraPlane().y * cos(ANGLE);
-    SetCameraPlane(newCameraPlane);
+    cached.angle = angle;
+    cached.rotation = MakeRotation(angle);
+    return cached.rotation;
 }
 
 void RaycasterEngine::RotateCamera(const MovementDirection direction, const float angle) noexcept
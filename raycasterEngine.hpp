@@ -5,6 +5,27 @@
 #include <cmath>
 #include <SDL.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "chunkedWorld.hpp"
+#include "colourMap.hpp"
+#include "frameCapture.hpp"
+#include "framePipeline.hpp"
+#include "inputLog.hpp"
+#include "mapQuery.hpp"
+#include "point.hpp"
+#include "profiler.hpp"
+#include "rayCast.hpp"
+#include "renderTarget.hpp"
+#include "resolutionController.hpp"
+#include "sprite.hpp"
+#include "textureCache.hpp"
+#include "texturePack.hpp"
+#include "threadPool.hpp"
+#include "wallSpan.hpp"
+#include "worldMap.hpp"
 
 namespace Raycaster
 {
@@ -15,18 +36,42 @@ namespace Raycaster
         ~RaycasterEngine();
 
         void Init();
+        // Prepares the engine for offscreen rendering without SDL video
+        void InitHeadless();
         void Cleanup();
 
+        // Draws each frame on a thread of its own while the previous one is
+        // presented; see FramePipeline
         void Run();
+        void RenderFrame(RenderTarget &target);
+        void RenderFrame(RenderTarget &target, const CameraPose &pose);
+
+        // One camera of a RenderViews() batch and the frame it is drawn into
+        struct BatchView {
+            CameraPose pose;
+            FrameBuffer frame;
+            // Time taken to draw the view, set by RenderViews()
+            double milliseconds;
+        };
+
+        struct BatchStats {
+            int views;
+            std::uint64_t pixels;
+            double milliseconds;
+            double viewsPerSecond;
+            double megapixelsPerSecond;
+        };
+
+        // Draws every view with the shared map, textures, sprites and thread
+        // pool, ignoring the player's pose. Views with null pixels are
+        // skipped. See RenderViews() in the .cpp for the scheduling.
+        BatchStats RenderViews(std::vector<BatchView> &views);
 
         bool IsRunning() const noexcept { return m_isRunning; }
         void Quit() noexcept { m_isRunning = false; }
 
         template <typename T>
-        struct Point {
-            T x;
-            T y;
-        };
+        using Point = Raycaster::Point<T>;
 
         typedef struct {
             int height;
@@ -39,81 +84,407 @@ namespace Raycaster
 
         inline SDL_Surface* GetScreen() const { return m_screen; }
         inline void SetPixel(Point<int> coordinates, const unsigned int pixel);
+        // Flat colour of the wall in mapCell when textures are off
         inline unsigned int GetWallColour(const Point<double> mapCell) noexcept;
-        inline int GetHeightForWallDistance(const double distance) const;
+        inline int GetHeightForWallDistance(const double distance, const int screenHeight) const;
+
+        // Replaces the built-in map with one loaded from a binary or text
+        // map file; see WorldMap for the formats
+        bool LoadMap(const std::string &path);
+        inline const WorldMap& GetWorldMap() const noexcept { return m_worldMap; }
+
+        // Changes cells of the map, e.g. to open a door or knock down a
+        // wall. The map used for movement and queries changes at once;
+        // frames see the edits from the next one drawn. The distance field
+        // is only updated where distances change.
+        void EditMap(const std::vector<MapEdit> &edits);
+        void SetMapCell(const int x, const int y, const std::uint8_t value);
+        // Gives frames a copy of the map of their own, so EditMap() can be
+        // called while another thread draws. Run() turns it on. Only change
+        // it while no frame is being drawn.
+        void SetMapDoubleBuffering(const bool enable);
+        inline bool GetMapDoubleBuffering() const noexcept { return m_drawnMap != nullptr; }
 
-        inline int GetWorldMapCell(const Point<double> cell) const noexcept { return m_worldMap[static_cast<int>(cell.x)][static_cast<int>(cell.y)]; }
-        inline void SetPlayerPosition(const Point<double> newPosition) noexcept;
+        // Draws and moves through a streamed world instead of the map, or
+        // the map again if world is null. Map queries, replays and sprites
+        // still use the map. Chunks are loaded around the camera as frames
+        // are drawn; see ChunkedWorld.
+        void SetStreamedWorld(const std::shared_ptr<ChunkedWorld> &world);
+        inline const std::shared_ptr<ChunkedWorld>& GetStreamedWorld() const noexcept { return m_streamedWorld; }
+
+        // Cells outside the map read as walls
+        inline int GetWorldMapCell(const Point<double> cell) const noexcept
+        {
+            const int x = static_cast<int>(std::floor(cell.x));
+            const int y = static_cast<int>(std::floor(cell.y));
+            return m_streamedWorld ? m_streamedWorld->GetCell(x, y) : m_worldMap.GetCell(x, y);
+        }
+        inline void SetPlayerPosition(const Point<double> newPosition) noexcept { m_playerPosition = newPosition; }
         inline Point<double> GetPlayerPosition() const noexcept { return m_playerPosition; }
-        inline void SetPlayerDirection(const Point<double> newDirection) noexcept;
+        inline void SetPlayerDirection(const Point<double> newDirection) noexcept { m_playerDirection = newDirection; }
         inline Point<double> GetPlayerDirection() const noexcept { return m_playerDirection; }
-        inline void SetCameraPlane(const Point<double> newPlane) noexcept;
+        inline void SetCameraPlane(const Point<double> newPlane) noexcept { m_cameraPlane = newPlane; }
         inline Point<double> GetCameraPlane() const noexcept { return m_cameraPlane; }
         inline bool IsPlayerInWall() noexcept { return GetWorldMapCell(GetPlayerPosition()); }
 
+        // Batched map queries, see mapQuery.hpp. With parallel set a batch
+        // is split across the render thread pool, waiting for any frame
+        // being drawn with it to finish first.
+        void CastRays(const std::vector<RayQuery> &queries, std::vector<RayQueryHit> &hits, const bool parallel = false);
+        void TestLineOfSight(const std::vector<SightQuery> &queries, std::vector<std::uint8_t> &visible, const bool parallel = false);
+        void SweepCircles(const std::vector<SweepQuery> &queries, std::vector<SweepResult> &results, const bool parallel = false);
+
+        // Drawn every frame in front of the walls. Sprite textures index the
+        // wall textures; black texels are transparent.
+        inline std::vector<Sprite>& GetSprites() noexcept { return m_sprites; }
+        inline const std::vector<Sprite>& GetSprites() const noexcept { return m_sprites; }
+
         inline bool GetTexturesEnabled() const noexcept { return m_texturesEnabled; }
-        inline void SetTexturesEnabled(const bool enable) noexcept { m_texturesEnabled = enable; }
+        inline void SetTexturesEnabled(const bool enable) noexcept { m_texturesEnabled = enable; m_drawVersion++; }
+
+        // Replaces the built-in textures with a texture pack file, keeping
+        // at most cacheBytes of it in memory; see TextureCache. Wall cell
+        // value v uses texture (v - 1) modulo the pack's texture count.
+        bool LoadTextures(const std::string &path, const std::size_t cacheBytes = DEFAULT_TEXTURE_CACHE_BYTES);
+        inline TextureCache& GetTextureCache() noexcept { return *m_textureCache; }
+
+        // Draws distant walls, floors and sprites from smaller mip levels,
+        // which keeps the texels read per frame close to the pixels drawn
+        inline bool GetMipmapping() const noexcept { return m_mipmapping; }
+        inline void SetMipmapping(const bool enable) noexcept { m_mipmapping = enable; m_drawVersion++; }
 
         inline void MovePlayer(const MovementDirection direction, const float speed) noexcept;
         inline void StrafePlayer(const MovementDirection direction, const float speed) noexcept;
         inline void TurnPlayer(const MovementDirection direction, const float angle) noexcept;
         inline void RotateCamera(const MovementDirection direction, const float angle) noexcept;
+        // Moves the player as a circle of PLAYER_RADIUS, sliding along any
+        // wall in the way
+        void MovePlayerBy(const Point<double> movement) noexcept;
+
+        // Number of threads RenderFrame() splits the columns across;
+        // 0 uses every hardware thread
+        void SetRenderThreadCount(const int count);
+        inline int GetRenderThreadCount() const noexcept { return m_threadPool ? m_threadPool->GetThreadCount() : 1; }
+
+        // Ray traversal implementation; AUTO picks the fastest the CPU supports
+        inline CastKernel GetCastKernel() const noexcept { return m_castKernel; }
+        inline void SetCastKernel(const CastKernel kernel) noexcept { m_castKernel = kernel; }
+
+        // Lets rays cross open space using a distance field built from the
+        // map; hits are the same either way
+        void SetEmptySpaceSkipping(const bool enable);
+        inline bool GetEmptySpaceSkipping() const noexcept { return m_skipEmptySpace; }
+
+        // Casts every other column each frame, the even and odd ones in
+        // turn, and rebuilds the rest from the previous frame's hits moved
+        // to the new pose. Every column is cast after a big turn or move,
+        // or a map edit. Frames may differ from fully cast ones by a column
+        // at the edges of moving walls. RenderViews() doesn't interlace.
+        inline bool GetInterlacing() const noexcept { return m_interlacing; }
+        inline void SetInterlacing(const bool enable) noexcept { m_interlacing = enable; }
+
+        // Keeps each column's wall hit and pixels from frame to frame. A
+        // frame drawn from the same pose as the last casts and draws only
+        // the columns whose rays cross cells edited since, and when nothing
+        // changed at all the last frame is copied whole. Frames are the same
+        // either way. RenderViews() doesn't cache. On by default.
+        inline bool GetColumnCaching() const noexcept { return m_columnCaching; }
+        inline void SetColumnCaching(const bool enable) noexcept { m_columnCaching = enable; }
+
+        // How the columns of the last frame RenderFrame() drew got their
+        // hits and pixels; read while no frame is being drawn
+        struct ColumnStats {
+            int castColumns;
+            // Rebuilt by interlacing
+            int reprojectedColumns;
+            // Hits kept from the frame before
+            int cachedColumns;
+            // Walls drawn; the rest kept their pixels
+            int drawnColumns;
+            // Every pixel was copied from the frame before
+            bool copiedFrame;
+        };
+        inline ColumnStats GetColumnStats() const noexcept { return m_columnStats; }
+
+        // Draws frames at a fraction of the target's size, chosen each frame
+        // by the resolution controller to keep frame times within its
+        // budget, and scales them up to fill the target
+        inline bool GetDynamicResolution() const noexcept { return m_dynamicResolution; }
+        void SetDynamicResolution(const bool enable);
+        inline ResolutionController& GetResolutionController() noexcept { return m_resolutionController; }
+
+        // Fades walls, floors and sprites into fog with distance through
+        // the light levels of a ColourMap. On by default, except headless,
+        // where frames are compared by checksum with earlier builds.
+        inline bool GetLighting() const noexcept { return m_lighting; }
+        inline void SetLighting(const bool enable) noexcept { m_lighting = enable; m_drawVersion++; }
+        inline const LightSettings& GetLightSettings() const noexcept { return m_colourMap.GetSettings(); }
+        // Rebuilds the shade tables, so not while a frame is being drawn
+        inline void SetLightSettings(const LightSettings &settings) { m_colourMap.SetSettings(settings); m_drawVersion++; }
+
+        inline bool GetCameraRotationEnabled() const noexcept { return m_rotateCamera; }
+        inline void SetCameraRotationEnabled(const bool enable) noexcept { m_rotateCamera = enable; }
+
+        // Advances the game one fixed tick of 1 / SIMULATION_RATE seconds
+        // with buttons (InputButton bits) held. Run() steps as many ticks
+        // as real time has passed, so play doesn't depend on frame rate.
+        void StepSimulation(const std::uint8_t buttons);
+        // Player pose part way from the previous tick to the latest, by
+        // alpha from 0 to 1, for drawing between ticks
+        CameraPose GetInterpolatedPose(const double alpha) const noexcept;
+
+        // Logs the buttons of every tick from now on, with the current pose
+        // as the start, and writes them to path on StopRecording() or when
+        // Run() returns. Fails if path can't be written.
+        bool StartRecording(const std::string &path);
+        bool StopRecording();
+        // Restores the start of a recording made on the same map; Run() then
+        // plays its ticks instead of the keyboard and quits at the end
+        bool LoadReplay(const std::string &path);
+        inline bool IsReplaying() const noexcept { return m_isReplaying; }
+        inline std::size_t GetReplayTickCount() const noexcept { return m_isReplaying ? m_inputLog.GetTickCount() : 0; }
+        // Steps the simulation with the next recorded tick; false once the
+        // recording has run out
+        bool StepReplay();
+
+        // Writes every frame Run() presents to path (see FrameCapture::Open)
+        // until StopCapture() or Run() returns. Call after Init(); fails if
+        // path can't be opened.
+        bool StartCapture(const std::string &path, const CaptureSettings &settings = DEFAULT_CAPTURE_SETTINGS);
+        // Returns false if any frame couldn't be written
+        bool StopCapture();
+        inline CaptureStats GetCaptureStats() { return m_capture.GetStats(); }
 
     private:
+        void GenerateTextures();
+        // Fills m_flatColours
+        void BuildFlatColours();
+        // Starts a frame of the texture cache and queues the textures of
+        // walls around position, so they are loaded before they come into
+        // view
+        void UpdateTextures(const Point<double> position);
+        // Map frames are drawn from
+        inline const WorldMap& GetDrawnMap() const noexcept { return m_drawnMap ? *m_drawnMap : m_worldMap; }
+        // Brings the drawn map up to date with the edits made since the last
+        // frame; called as a frame starts
+        void ApplyMapEdits();
+        // Replaces the drawn map with a copy of the map, dropping its
+        // pending edits
+        void CopyDrawnMap();
+        // Mip level of texture to draw at drawnSize pixels tall
+        inline int GetTextureLevel(const int texture, const double drawnSize) const noexcept { return m_mipmapping ? m_textureCache->GetLevelFor(texture, drawnSize) : 0; }
+        void HandleEvents();
+        // InputButton bit bound to an SDL key, or 0
+        static std::uint8_t GetKeyButton(const int key) noexcept;
+        std::uint32_t GetMapHash() const noexcept;
+        struct WallRows;
+        struct ViewState;
+
+        // Sets up a view for drawing pose into frame
+        void PrepareView(ViewState &view, const CameraPose &pose, const FrameBuffer &frame);
+        // Starts a frame of the streamed world and queues the chunks ahead
+        // of the camera
+        void UpdateStreamedWorld(const CameraPose &pose);
+        // Marks the chunks a drawn view's rays reached as in use
+        void UseStreamedChunks(const ViewState &view);
+        // Draws a prepared view split across the thread pool
+        void RenderViewParallel(ViewState &view);
+        // Draws a prepared view on the calling thread alone
+        void RenderViewSerial(ViewState &view);
+        // Marks the columns whose hits can't be kept from the view's
+        // previous frame when drawing pose into frame; false if none can
+        bool FindStaleColumns(ViewState &view, const CameraPose &pose, const FrameBuffer &frame);
+        // Which columns to cast when interlacing a frame width wide from
+        // pose after the view's previous frame: 0 or 1 for the even or odd
+        // ones, or -1 for all of them
+        int GetInterlaceParity(const ViewState &view, const CameraPose &pose, const int width) const noexcept;
+        // Keeps the view's previous frame for rebuilding columns from and
+        // builds the ray tables of the even and odd columns; called before
+        // PrepareView()
+        void PrepareInterlacedView(ViewState &view);
+        // Casts columns [firstIndex, lastIndex) of the parity being cast
+        void CastParityColumns(ViewState &view, const int firstIndex, const int lastIndex);
+        // Returns how many of the columns were reprojected
+        int RenderColumns(ViewState &view, const int firstColumn, const int lastColumn);
+        int ReprojectColumns(ViewState &view, const int firstColumn, const int lastColumn);
+        void DrawColumn(ViewState &view, const int column, const RayHit &hit);
+        // Fills the floor and ceiling pixels of rows [firstRow, lastRow)
+        // around the walls drawn by DrawColumn()
+        void DrawFloorRows(const ViewState &view, const int firstRow, const int lastRow);
+        template <bool FLOOR, bool LIT>
+        void DrawFloorRow(const ViewState &view, const int row, const double rowDistance);
+        // Draws the visible sprites over columns [firstColumn, lastColumn)
+        // of the frame, after the walls and floor are in place
+        void DrawSprites(const ViewState &view, const int firstColumn, const int lastColumn);
+        void RunQueries(const int count, const bool parallel, const std::function<void(int, int)> &task);
+        // Rotation by angle to the left, computed on first use of the angle
+        const Rotation& GetRotation(const float angle) noexcept;
+
         Point<double> m_playerPosition;
         Point<double> m_playerDirection;
         Point<double> m_cameraPlane;
 
         SDL_Surface *m_screen;
+        std::unique_ptr<RenderTarget> m_windowTarget;
+        std::unique_ptr<ThreadPool> m_threadPool;
+
+        // Rows [top, bottom) of a column covered by its wall
+        struct WallRows {
+            int top;
+            int bottom;
+        };
+
+        // Everything a frame is drawn with other than the shared map,
+        // textures and sprites, so several views can be drawn at once
+        struct ViewState {
+            FrameBuffer frame{nullptr, 0, 0, 0};
+            CameraPose pose{};
+            RayTable rayTable{0, {}};
+            std::vector<RayHit> columnHits;
+            std::vector<WallRows> wallRows;
+            // The view's sprites in view, farthest first
+            std::vector<VisibleSprite> visibleSprites;
+            std::vector<VisibleSprite> spriteScratch;
+
+            // Frame is drawn column-major, column x starting at
+            // screenBuffer[x * screenBufferStride], then copied to the frame
+            std::vector<unsigned int> screenBuffer;
+            int screenBufferStride{0};
+
+            // Interlacing: the ray tables of the even and odd columns, the
+            // hits cast from one of them, the previous frame's hits and
+            // pose, which columns were cast (-1 for every one) and whether
+            // columnHits still show the map drawn
+            RayTable parityTables[2]{};
+            std::vector<RayHit> parityHits;
+            std::vector<RayHit> previousHits;
+            CameraPose previousPose{};
+            int castParity{-1};
+            std::uint64_t mapVersion{0};
+            bool hitsCurrent{false};
+            int reprojectedColumns{0};
+
+            // Column caching: whether hits are kept from the previous
+            // frame, which of them are cast again, whether walls that
+            // aren't keep their pixels, and m_drawVersion at the last frame
+            bool cachedHits{false};
+            std::vector<std::uint8_t> staleColumns;
+            bool keepWalls{false};
+            std::uint64_t drawVersion{0};
+        };
+
+        // Frame currently being drawn by RenderFrame()
+        ViewState m_view;
+        // One per pool thread for RenderViews()
+        std::vector<std::unique_ptr<ViewState>> m_batchViews;
+
+        std::vector<Sprite> m_sprites;
+        CastKernel m_castKernel;
+
+        ResolutionController m_resolutionController;
+        // Frame drawn at the controller's scale before it is scaled up
+        std::vector<unsigned int> m_scaledFrame;
 
         bool m_isRunning;
         bool m_rotateCamera;
         bool m_texturesEnabled;
+        bool m_skipEmptySpace;
+        bool m_dynamicResolution;
+        bool m_mipmapping;
+        bool m_lighting;
+        bool m_interlacing;
+        bool m_columnCaching;
+        ColumnStats m_columnStats;
+        // Counts changes to how hits are drawn: textures, mips and light
+        std::uint64_t m_drawVersion;
+        // Cells of the drawn map edited since RenderFrame() last drew
+        MapRegion m_drawnMapChanges;
+        // The last frame RenderFrame() drew and the sprites in it, kept
+        // once a frame came out the same as the one before
+        std::vector<unsigned int> m_lastFrame;
+        std::vector<Sprite> m_lastFrameSprites;
+        bool m_lastFrameKept;
+
+        ColourMap m_colourMap;
+        // Flat wall colour of every cell value, and the same for walls hit
+        // on their side
+        unsigned int m_flatColours[2][256];
+
+        // Buttons down on the keyboard, read by each tick
+        std::uint8_t m_heldButtons;
+        // Player pose before the latest tick
+        CameraPose m_previousPose;
 
-        double m_curFrameTime;
-        double m_prevFrameTime;
-        double m_movementSpeed;
-        double m_rotateSpeed;
+        InputLog m_inputLog;
+        std::string m_recordPath;
+        bool m_isRecording;
+        bool m_isReplaying;
+        std::size_t m_replayTick;
+
+        FrameCapture m_capture;
+
+        struct CachedRotation {
+            float angle;
+            Rotation rotation;
+        };
+
+        static const int ROTATION_CACHE_SIZE{4};
+        // Slots holding TURN_ANGLE and ROTATE_CAMERA_ANGLE
+        static const int PINNED_ROTATIONS{2};
+        CachedRotation m_rotations[ROTATION_CACHE_SIZE];
+        int m_nextRotation;
 
         static const int PROJ_PLANE_WIDTH{800};
         static const int PROJ_PLANE_HEIGHT{600};
+        // Size of the built-in textures
         static const int TEXTURE_WIDTH{64};
         static const int TEXTURE_HEIGHT{64};
         static const int WORLD_MAP_COLS{20};
         static const int WORLD_MAP_ROWS{20};
+        static const std::uint8_t DEFAULT_WORLD_MAP[WORLD_MAP_COLS][WORLD_MAP_ROWS];
         static const int BACKGROUND_COLOUR;
         static const int NUMBER_OF_TEXTURES{3};
+        static const int FLOOR_TEXTURE{1};
+        static const int CEILING_TEXTURE{0};
+        static const int RENDER_COLUMN_GRAIN{16};
+        static const int RENDER_ROW_GRAIN{16};
+        static const int SPRITE_COLUMN_GRAIN{64};
+        static const int QUERY_GRAIN{256};
+        // Cells around the camera whose wall textures are prefetched
+        static const int TEXTURE_PREFETCH_RADIUS{8};
+        // Cells ahead of the camera whose chunks are prefetched
+        static const int WORLD_PREFETCH_DISTANCE{256};
+        // Cells around the player copied for collisions in a streamed world,
+        // which bounds a single move to a little under this
+        static const int MOVE_WINDOW_RADIUS{8};
+        static const int SCREEN_BUFFER_COLUMN_ALIGNMENT{16};
+        // Back buffers between drawing and presenting in Run()
+        static const int PRESENT_BUFFER_COUNT{2};
+        // Simulation ticks per second, and most run between two frames
+        static const int SIMULATION_RATE{60};
+        static const int MAX_TICKS_PER_FRAME{5};
         static const float WALL_SIDE_COLOUR_MULTIPLIER;
         static const float MOVEMENT_SPEED;
         static const float TURN_ANGLE;
         static const float ROTATE_CAMERA_ANGLE;
+        static const float PLAYER_RADIUS;
+        // Largest turn (radians) and move (cells) between frames that
+        // interlacing rebuilds columns across
+        static const float INTERLACE_MAX_TURN;
+        static const float INTERLACE_MAX_MOVE;
+        // Written when F12 is pressed
+        static const char *const PROFILE_TRACE_PATH;
 
-        unsigned int m_texture[NUMBER_OF_TEXTURES][TEXTURE_WIDTH * TEXTURE_HEIGHT];
-        unsigned int m_screenBuffer[PROJ_PLANE_WIDTH][PROJ_PLANE_HEIGHT];
+        std::unique_ptr<TextureCache> m_textureCache;
 
-        int m_worldMap[WORLD_MAP_COLS][WORLD_MAP_ROWS] =
-        {
-            {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 3, 0, 3, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 3, 0, 3, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 1},
-            {1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 1},
-            {1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 0, 0, 0, 2, 2, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 2, 2, 0, 2, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 2, 2, 0, 2, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 2, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-            {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
-        };
+        WorldMap m_worldMap;
+        // With double buffering, the copy frames read and the edits it is
+        // still to get; m_drawnMapEdits is only touched by the drawing side
+        std::unique_ptr<WorldMap> m_drawnMap;
+        std::mutex m_mapEditMutex;
+        std::vector<MapEdit> m_pendingMapEdits;
+        std::vector<MapEdit> m_drawnMapEdits;
+        std::shared_ptr<ChunkedWorld> m_streamedWorld;
     };
 }
 
@@ -0,0 +1,239 @@
+#include "renderTarget.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace Raycaster;
+
+namespace
+{
+    // Square tile copied at a time; 16 pixels is one cache line of a row
+    // and of a column
+    const int COPY_TILE_SIZE{16};
+
+    inline void CopyBlock(const unsigned int *columns, const int columnStride, unsigned int *rows, const int pitch,
+                          const int width, const int height) noexcept
+    {
+        for (int y{0}; y < height; y++) {
+            for (int x{0}; x < width; x++) {
+                rows[y * pitch + x] = columns[x * columnStride + y];
+            }
+        }
+    }
+
+    inline void CopyBlock4x4(const unsigned int *columns, const int columnStride, unsigned int *rows, const int pitch) noexcept
+    {
+        #ifdef __SSE2__
+        const __m128i column0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns));
+        const __m128i column1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + columnStride));
+        const __m128i column2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + 2 * columnStride));
+        const __m128i column3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + 3 * columnStride));
+
+        // Interleave pairs of columns, then pairs of pairs
+        const __m128i low01 = _mm_unpacklo_epi32(column0, column1);
+        const __m128i low23 = _mm_unpacklo_epi32(column2, column3);
+        const __m128i high01 = _mm_unpackhi_epi32(column0, column1);
+        const __m128i high23 = _mm_unpackhi_epi32(column2, column3);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rows), _mm_unpacklo_epi64(low01, low23));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rows + pitch), _mm_unpackhi_epi64(low01, low23));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rows + 2 * pitch), _mm_unpacklo_epi64(high01, high23));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rows + 3 * pitch), _mm_unpackhi_epi64(high01, high23));
+        #else
+        CopyBlock(columns, columnStride, rows, pitch, 4, 4);
+        #endif
+    }
+}
+
+void Raycaster::CopyColumnsToRows(const unsigned int *columns, const int columnStride, const FrameBuffer &frame,
+                                  const int firstRow, const int lastRow) noexcept
+{
+    for (int tileY{firstRow}; tileY < lastRow; tileY += COPY_TILE_SIZE) {
+        const int tileHeight = std::min(COPY_TILE_SIZE, lastRow - tileY);
+
+        for (int tileX{0}; tileX < frame.width; tileX += COPY_TILE_SIZE) {
+            const int tileWidth = std::min(COPY_TILE_SIZE, frame.width - tileX);
+            const unsigned int *source = columns + tileX * columnStride + tileY;
+            unsigned int *destination = frame.pixels + tileY * frame.pitch + tileX;
+
+            if (tileWidth < COPY_TILE_SIZE || tileHeight < COPY_TILE_SIZE) {
+                CopyBlock(source, columnStride, destination, frame.pitch, tileWidth, tileHeight);
+                continue;
+            }
+
+            for (int x{0}; x < COPY_TILE_SIZE; x += 4) {
+                for (int y{0}; y < COPY_TILE_SIZE; y += 4) {
+                    CopyBlock4x4(source + x * columnStride + y, columnStride, destination + y * frame.pitch + x, frame.pitch);
+                }
+            }
+        }
+    }
+}
+
+void Raycaster::CopyFrame(const FrameBuffer &source, const FrameBuffer &destination) noexcept
+{
+    const int width = std::min(source.width, destination.width);
+    const int height = std::min(source.height, destination.height);
+
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    if (source.pitch == width && destination.pitch == width) {
+        std::memcpy(destination.pixels, source.pixels, static_cast<std::size_t>(width) * height * sizeof(unsigned int));
+        return;
+    }
+
+    for (int y{0}; y < height; y++) {
+        std::memcpy(destination.pixels + y * destination.pitch, source.pixels + y * source.pitch, width * sizeof(unsigned int));
+    }
+}
+
+void Raycaster::ScaleFrame(const FrameBuffer &source, const FrameBuffer &destination, const int firstRow, const int lastRow) noexcept
+{
+    if (source.width <= 0 || source.height <= 0 || destination.width <= 0 || destination.height <= 0) {
+        return;
+    }
+
+    // Sample at pixel centres so the edges aren't favoured
+    const std::uint32_t stepX = static_cast<std::uint32_t>((static_cast<std::uint64_t>(source.width) << 16) / destination.width);
+    const std::uint32_t firstX = stepX / 2;
+    int previousRow{-1};
+
+    for (int y{firstRow}; y < lastRow; y++) {
+        const int sourceRow = static_cast<int>((2 * static_cast<std::int64_t>(y) + 1) * source.height / (2 * destination.height));
+        unsigned int *row = destination.pixels + y * destination.pitch;
+
+        if (sourceRow == previousRow) {
+            std::memcpy(row, row - destination.pitch, destination.width * sizeof(unsigned int));
+            continue;
+        }
+
+        const unsigned int *sourcePixels = source.pixels + sourceRow * source.pitch;
+        std::uint32_t sourceX = firstX;
+
+        for (int x{0}; x < destination.width; x++) {
+            row[x] = sourcePixels[sourceX >> 16];
+            sourceX += stepX;
+        }
+
+        previousRow = sourceRow;
+    }
+}
+
+MemoryRenderTarget::MemoryRenderTarget(const int width, const int height) :
+    m_width{width},
+    m_height{height},
+    m_pixels(static_cast<std::size_t>(width) * height, 0)
+{
+
+}
+
+FrameBuffer MemoryRenderTarget::Lock()
+{
+    return {m_pixels.data(), m_width, m_height, m_width};
+}
+
+void MemoryRenderTarget::SwapPixels(std::vector<unsigned int> &pixels) noexcept
+{
+    m_pixels.swap(pixels);
+}
+
+std::uint64_t MemoryRenderTarget::Checksum() const noexcept
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned int pixel : m_pixels) {
+        for (int byte{0}; byte < 4; byte++) {
+            hash ^= (pixel >> (byte * 8)) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+SurfaceRenderTarget::SurfaceRenderTarget(SDL_Surface *surface) :
+    m_surface{surface},
+    m_isLocked{false},
+    m_isShadowLocked{false}
+{
+
+}
+
+bool SurfaceRenderTarget::IsDirect() const noexcept
+{
+    const SDL_PixelFormat *format = m_surface->format;
+
+    return format->BytesPerPixel == 4 && format->Rmask == 0xFF0000 && format->Gmask == 0x00FF00 && format->Bmask == 0x0000FF;
+}
+
+FrameBuffer SurfaceRenderTarget::Lock()
+{
+    if (m_surface->format->BytesPerPixel != 4) {
+        return {nullptr, 0, 0, 0};
+    }
+
+    if (!IsDirect()) {
+        m_shadow.resize(static_cast<std::size_t>(m_surface->w) * m_surface->h);
+        m_isShadowLocked = true;
+        return {m_shadow.data(), m_surface->w, m_surface->h, m_surface->w};
+    }
+
+    if (SDL_MUSTLOCK(m_surface)) {
+        if (SDL_LockSurface(m_surface) < 0) {
+            return {nullptr, 0, 0, 0};
+        }
+        m_isLocked = true;
+    }
+
+    return {reinterpret_cast<unsigned int*>(m_surface->pixels), m_surface->w, m_surface->h, m_surface->pitch / 4};
+}
+
+void SurfaceRenderTarget::Unlock()
+{
+    if (m_isShadowLocked) {
+        m_isShadowLocked = false;
+
+        if (SDL_MUSTLOCK(m_surface)) {
+            if (SDL_LockSurface(m_surface) < 0) {
+                return;
+            }
+            m_isLocked = true;
+        }
+
+        ConvertToSurface();
+    }
+
+    if (m_isLocked) {
+        SDL_UnlockSurface(m_surface);
+        m_isLocked = false;
+    }
+}
+
+void SurfaceRenderTarget::ConvertToSurface() noexcept
+{
+    const SDL_PixelFormat *format = m_surface->format;
+    const int pitch = m_surface->pitch / 4;
+
+    for (int y{0}; y < m_surface->h; y++) {
+        const unsigned int *source = &m_shadow[static_cast<std::size_t>(y) * m_surface->w];
+        unsigned int *destination = reinterpret_cast<unsigned int*>(m_surface->pixels) + y * pitch;
+
+        for (int x{0}; x < m_surface->w; x++) {
+            const unsigned int pixel = source[x];
+            destination[x] = (((pixel >> 16) & 0xFF) << format->Rshift) |
+                             (((pixel >> 8) & 0xFF) << format->Gshift) |
+                             ((pixel & 0xFF) << format->Bshift);
+        }
+    }
+}
+
+void SurfaceRenderTarget::Present()
+{
+    SDL_Flip(m_surface);
+}
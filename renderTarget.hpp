@@ -0,0 +1,106 @@
+#ifndef RENDER_TARGET_HPP
+#define RENDER_TARGET_HPP
+
+#include <vector>
+#include <cstdint>
+#include <SDL.h>
+
+namespace Raycaster
+{
+    // View of a locked frame. Pixels are 32-bit 0x00RRGGBB values addressed
+    // as pixels[y * pitch + x], with the pitch counted in pixels.
+    struct FrameBuffer {
+        unsigned int *pixels;
+        int width;
+        int height;
+        int pitch;
+    };
+
+    // Copies rows [firstRow, lastRow) of a column-major image, where column x
+    // starts at columns[x * columnStride], into a row-major frame. Works in
+    // cache-sized tiles of 4x4 SIMD transposes.
+    void CopyColumnsToRows(const unsigned int *columns, const int columnStride, const FrameBuffer &frame,
+                           const int firstRow, const int lastRow) noexcept;
+
+    // Copies the area two frames have in common, one memcpy per row or one
+    // for the lot when neither has padding
+    void CopyFrame(const FrameBuffer &source, const FrameBuffer &destination) noexcept;
+
+    // Stretches source over the whole of destination, nearest neighbour,
+    // writing destination rows [firstRow, lastRow). Source columns are
+    // stepped across in 16.16 fixed point, and rows that sample the same
+    // source row as the one above are copied from it.
+    void ScaleFrame(const FrameBuffer &source, const FrameBuffer &destination, const int firstRow, const int lastRow) noexcept;
+
+    // Destination the engine draws a frame into
+    class RenderTarget
+    {
+    public:
+        virtual ~RenderTarget() {}
+
+        virtual int GetWidth() const noexcept = 0;
+        virtual int GetHeight() const noexcept = 0;
+
+        // Returns a frame with a null pixel pointer if the pixels can't be accessed
+        virtual FrameBuffer Lock() = 0;
+        virtual void Unlock() = 0;
+        virtual void Present() {}
+    };
+
+    // Plain memory buffer, needs no SDL video subsystem
+    class MemoryRenderTarget : public RenderTarget
+    {
+    public:
+        MemoryRenderTarget(const int width, const int height);
+
+        int GetWidth() const noexcept override { return m_width; }
+        int GetHeight() const noexcept override { return m_height; }
+
+        FrameBuffer Lock() override;
+        void Unlock() override {}
+
+        const unsigned int* GetPixels() const noexcept { return m_pixels.data(); }
+        // Trades pixel storage with pixels, which must hold width * height
+        // pixels, to hand a frame on without copying it
+        void SwapPixels(std::vector<unsigned int> &pixels) noexcept;
+
+        // 64-bit FNV-1a hash of the pixel contents
+        std::uint64_t Checksum() const noexcept;
+
+    private:
+        int m_width;
+        int m_height;
+        std::vector<unsigned int> m_pixels;
+    };
+
+    // SDL video surface, presented with SDL_Flip. Frames are drawn straight
+    // into a 32-bit surface whose pixels are 0x00RRGGBB; other 32-bit
+    // layouts are drawn into a buffer of that format and converted when
+    // unlocked.
+    class SurfaceRenderTarget : public RenderTarget
+    {
+    public:
+        explicit SurfaceRenderTarget(SDL_Surface *surface);
+
+        int GetWidth() const noexcept override { return m_surface->w; }
+        int GetHeight() const noexcept override { return m_surface->h; }
+
+        // Whether frames are drawn into the surface pixels without conversion
+        bool IsDirect() const noexcept;
+
+        FrameBuffer Lock() override;
+        void Unlock() override;
+        void Present() override;
+
+    private:
+        void ConvertToSurface() noexcept;
+
+        SDL_Surface *m_surface;
+        bool m_isLocked;
+        // Frame drawn for a surface that isn't direct
+        std::vector<unsigned int> m_shadow;
+        bool m_isShadowLocked;
+    };
+}
+
+#endif // RENDER_TARGET_HPP
@@ -0,0 +1,62 @@
+#include "resolutionController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Raycaster;
+
+namespace
+{
+    // 60 frames per second, drawn at between a quarter and all of the
+    // output size along each axis
+    const ResolutionSettings DEFAULT_RESOLUTION_SETTINGS{1000.0 / 60, 0.25, 1.0, 0.05, 0.1};
+}
+
+ResolutionController::ResolutionController() :
+    ResolutionController(DEFAULT_RESOLUTION_SETTINGS)
+{
+
+}
+
+ResolutionController::ResolutionController(const ResolutionSettings &settings) :
+    m_settings{settings},
+    m_scale{0},
+    m_cost{0}
+{
+    Reset();
+}
+
+void ResolutionController::SetSettings(const ResolutionSettings &settings) noexcept
+{
+    m_settings = settings;
+    Reset();
+}
+
+void ResolutionController::Reset() noexcept
+{
+    m_settings.maxScale = std::max(m_settings.maxScale, m_settings.minScale);
+    m_settings.smoothing = std::min(std::max(m_settings.smoothing, 0.0), 1.0);
+    m_scale = m_settings.maxScale;
+    m_cost = 0;
+}
+
+void ResolutionController::AddFrameTime(const double milliseconds) noexcept
+{
+    const double cost = milliseconds / (m_scale * m_scale);
+    m_cost = m_cost ? m_cost + m_settings.smoothing * (cost - m_cost) : cost;
+
+    if (m_cost <= 0 || m_settings.targetMs <= 0) {
+        return;
+    }
+
+    const double wanted = std::sqrt(m_settings.targetMs / m_cost);
+    const double step = m_settings.scaleStep;
+
+    if (step > 0 && std::abs(wanted - m_scale) < step) {
+        return;
+    }
+
+    // Round down so the new scale is inside the budget
+    const double scale = step > 0 ? std::floor(wanted / step) * step : wanted;
+    m_scale = std::min(std::max(scale, m_settings.minScale), m_settings.maxScale);
+}
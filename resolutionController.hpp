@@ -0,0 +1,51 @@
+#ifndef RESOLUTION_CONTROLLER_HPP
+#define RESOLUTION_CONTROLLER_HPP
+
+namespace Raycaster
+{
+    struct ResolutionSettings {
+        // Frame time to stay within, in milliseconds
+        double targetMs;
+        // Fraction of the output size drawn along each axis
+        double minScale;
+        double maxScale;
+        // Scales are multiples of this, and only change once the wanted
+        // scale is a whole step away, so small wobbles in frame time don't
+        // resize every frame
+        double scaleStep;
+        // Weight of the newest frame in the smoothed cost, 0 to 1
+        double smoothing;
+    };
+
+    // Picks the scale of the next frame from the times of earlier ones.
+    // Drawing costs about the same per pixel whatever the resolution, so
+    // each frame's time is divided by its pixel count (scale squared) and
+    // smoothed, and the next scale is the one whose pixel count that cost
+    // fits into the target. Working from the cost per pixel rather than the
+    // frame time means a change of scale doesn't look like a change of load.
+    class ResolutionController
+    {
+    public:
+        ResolutionController();
+        explicit ResolutionController(const ResolutionSettings &settings);
+
+        const ResolutionSettings& GetSettings() const noexcept { return m_settings; }
+        // Starts again from the largest scale
+        void SetSettings(const ResolutionSettings &settings) noexcept;
+
+        double GetScale() const noexcept { return m_scale; }
+        // Smoothed milliseconds per frame at full scale
+        double GetFullScaleMs() const noexcept { return m_cost; }
+
+        // Time taken by a frame drawn at GetScale()
+        void AddFrameTime(const double milliseconds) noexcept;
+        void Reset() noexcept;
+
+    private:
+        ResolutionSettings m_settings;
+        double m_scale;
+        double m_cost;
+    };
+}
+
+#endif // RESOLUTION_CONTROLLER_HPP
@@ -0,0 +1,102 @@
+#include "sprite.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace Raycaster;
+
+namespace
+{
+    const int RADIX_BITS{8};
+    const int RADIX_BUCKETS{1 << RADIX_BITS};
+    const int RADIX_PASSES{32 / RADIX_BITS};
+
+    // Inverted so that ascending keys are descending depths
+    inline std::uint32_t GetSortKey(const VisibleSprite &sprite) noexcept
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &sprite.depth, sizeof(bits));
+        return ~bits;
+    }
+}
+
+void Raycaster::ProjectSprites(const CameraPose &pose, const std::vector<Sprite> &sprites,
+                               const int screenWidth, const int screenHeight, std::vector<VisibleSprite> &visible)
+{
+    // Sprite positions relative to the camera are solved for the direction
+    // and plane vectors: offset = depth * direction + across * plane. The
+    // column whose ray passes through the sprite is then at camera offset
+    // across / depth.
+    const double determinant = pose.direction.x * pose.plane.y - pose.plane.x * pose.direction.y;
+    if (!determinant) {
+        return;
+    }
+
+    const double inverseDeterminant = 1 / determinant;
+    const double halfWidth = screenWidth / 2.0;
+
+    for (const Sprite &sprite : sprites) {
+        const double offsetX = sprite.position.x - pose.position.x;
+        const double offsetY = sprite.position.y - pose.position.y;
+        const double depth = (offsetX * pose.plane.y - pose.plane.x * offsetY) * inverseDeterminant;
+
+        if (depth < SPRITE_NEAR_DEPTH) {
+            continue;
+        }
+
+        const double across = (pose.direction.x * offsetY - offsetX * pose.direction.y) * inverseDeterminant;
+        const double centre = halfWidth * (1 + across / depth);
+        // Same scale as a wall at this distance
+        const double size = screenHeight / depth;
+        const double left = centre - size / 2;
+
+        if (left + size <= 0 || left >= screenWidth || size < 1) {
+            continue;
+        }
+
+        VisibleSprite projected;
+        projected.depth = static_cast<float>(depth);
+        projected.texture = sprite.texture;
+        projected.firstColumn = std::max(0, static_cast<int>(std::ceil(left)));
+        projected.lastColumn = std::min(screenWidth, static_cast<int>(std::ceil(left + size)));
+        projected.left = left;
+        projected.size = static_cast<int>(size);
+
+        if (projected.firstColumn < projected.lastColumn) {
+            visible.push_back(projected);
+        }
+    }
+}
+
+void Raycaster::SortSpritesByDepth(std::vector<VisibleSprite> &sprites, std::vector<VisibleSprite> &scratch)
+{
+    scratch.resize(sprites.size());
+
+    for (int pass{0}; pass < RADIX_PASSES; pass++) {
+        const int shift = pass * RADIX_BITS;
+        std::size_t counts[RADIX_BUCKETS] = {};
+
+        for (const VisibleSprite &sprite : sprites) {
+            counts[(GetSortKey(sprite) >> shift) & (RADIX_BUCKETS - 1)]++;
+        }
+
+        // Nothing to reorder when every key shares this digit
+        if (std::find(counts, counts + RADIX_BUCKETS, sprites.size()) != counts + RADIX_BUCKETS) {
+            continue;
+        }
+
+        std::size_t offset{0};
+        for (std::size_t &count : counts) {
+            const std::size_t bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+
+        for (const VisibleSprite &sprite : sprites) {
+            scratch[counts[(GetSortKey(sprite) >> shift) & (RADIX_BUCKETS - 1)]++] = sprite;
+        }
+
+        sprites.swap(scratch);
+    }
+}
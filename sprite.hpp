@@ -0,0 +1,50 @@
+#ifndef SPRITE_HPP
+#define SPRITE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "point.hpp"
+#include "rayCast.hpp"
+
+namespace Raycaster
+{
+    // Billboard standing on the floor of the cell it is in, one cell wide
+    // and one tall, always facing the camera
+    struct Sprite {
+        Point<double> position;
+        int texture;
+    };
+
+    // Sprite in view, placed on a screen of the size it was projected for
+    struct VisibleSprite {
+        // Distance along the view direction, the same measure as a wall
+        // hit's perpWallDistance
+        float depth;
+        int texture;
+        // Columns [firstColumn, lastColumn) it covers, clipped to the screen
+        int firstColumn;
+        int lastColumn;
+        // Unclipped left edge and size in pixels; it is as tall as wide
+        double left;
+        int size;
+    };
+
+    // Sprites closer than this are dropped rather than drawn huge
+    const double SPRITE_NEAR_DEPTH{0.05};
+
+    // Appends the sprites in front of the camera that cover any column of
+    // the screen to visible. Sprites behind the camera or off either edge
+    // are rejected with a few multiplies each, so the cost of drawing
+    // depends on the sprites in view only.
+    void ProjectSprites(const CameraPose &pose, const std::vector<Sprite> &sprites,
+                        const int screenWidth, const int screenHeight, std::vector<VisibleSprite> &visible);
+
+    // Orders sprites farthest first, so drawing in order lets nearer
+    // sprites cover farther ones. LSD radix sort on the depth bits, which
+    // order like the depths themselves as they are positive; scratch is
+    // reused between calls.
+    void SortSpritesByDepth(std::vector<VisibleSprite> &sprites, std::vector<VisibleSprite> &scratch);
+}
+
+#endif // SPRITE_HPP
@@ -0,0 +1,676 @@
+// Stage microbenchmarks
+//
+// Times the stages of drawing a frame one at a time, outside the engine:
+// the DDA cast with and without the distance field, textured wall spans,
+// lit wall spans, clearing a frame, the column-to-row transpose and the
+// copy to the screen. The map stages run over every generated map and
+// resolution; maps are long corridors, open fields whose pillar spacing
+// sets how far rays travel, and dense mazes, each at a few sizes. The
+// other stages run once per resolution.
+//
+// Times are per ray or per pixel, the best of --repeats rounds over the
+// whole matrix, and are written as JSON. --write-baseline saves them;
+// --baseline compares with a run saved on the same machine and fails if any
+// case got more than --threshold slower or is missing from it.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "colourMap.hpp"
+#include "rayCast.hpp"
+#include "renderTarget.hpp"
+#include "wallSpan.hpp"
+#include "worldMap.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    struct Resolution {
+        int width;
+        int height;
+    };
+
+    const Resolution DEFAULT_RESOLUTIONS[] = {{320, 200}, {800, 600}, {1920, 1080}};
+    const int DEFAULT_MAP_SIZES[] = {64, 256, 1024};
+    const char *const FIXTURE_NAMES[] = {"corridors", "field8", "field64", "maze"};
+    const double CAMERA_PLANE_LENGTH = 0.66;
+    const double PI = 3.14159265358979323846;
+    const int TEXTURE_SIZE = 64;
+    // Column-major buffer columns start on this many pixels, as the engine's
+    const int COLUMN_ALIGNMENT = 16;
+    // Shortest run timed, so small cases aren't timed over a few
+    // microseconds
+    const double MIN_RUN_NANOSECONDS = 5e6;
+    const int MAX_RUN_CALLS = 1 << 16;
+
+    struct Options {
+        std::vector<Resolution> resolutions;
+        std::vector<int> mapSizes;
+        std::vector<std::string> fixtures;
+        int poses;
+        int repeats;
+        CastKernel kernel;
+        double threshold;
+        std::string jsonPath;
+        std::string baselinePath;
+        std::string writeBaselinePath;
+    };
+
+    struct Result {
+        std::string stage;
+        std::string fixture;
+        int mapSize;
+        Resolution resolution;
+        // Mean wall distance of the rays, for the map stages
+        double meanDistance;
+        // Per ray for the casts, per pixel for the rest
+        double nanoseconds;
+    };
+
+    void PrintUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--resolution WxH]... [--size N]... [--fixture corridors|field8|field64|maze]..."
+                  << " [--poses N] [--repeats N] [--kernel auto|scalar|sse2|avx2]"
+                  << " [--json file] [--baseline file] [--threshold F] [--write-baseline file]" << std::endl;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+
+            if (!std::strcmp(argv[i], "--resolution") && hasValue) {
+                Resolution resolution{0, 0};
+                if (std::sscanf(argv[++i], "%dx%d", &resolution.width, &resolution.height) != 2) {
+                    return false;
+                }
+                options.resolutions.push_back(resolution);
+            } else if (!std::strcmp(argv[i], "--size") && hasValue) {
+                options.mapSizes.push_back(std::atoi(argv[++i]));
+            } else if (!std::strcmp(argv[i], "--fixture") && hasValue) {
+                options.fixtures.push_back(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--poses") && hasValue) {
+                options.poses = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--repeats") && hasValue) {
+                options.repeats = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--threshold") && hasValue) {
+                options.threshold = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--json") && hasValue) {
+                options.jsonPath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--baseline") && hasValue) {
+                options.baselinePath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--write-baseline") && hasValue) {
+                options.writeBaselinePath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--kernel") && hasValue) {
+                const char *name = argv[++i];
+                const CastKernel kernels[] = {CastKernel::AUTO, CastKernel::SCALAR, CastKernel::SSE2, CastKernel::AVX2};
+                bool found = false;
+
+                for (const CastKernel kernel : kernels) {
+                    if (!std::strcmp(name, GetCastKernelName(kernel))) {
+                        options.kernel = kernel;
+                        found = true;
+                    }
+                }
+
+                if (!found || !IsCastKernelSupported(options.kernel)) {
+                    std::cerr << "Unsupported cast kernel: " << name << std::endl;
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+
+        if (options.resolutions.empty()) {
+            options.resolutions.assign(std::begin(DEFAULT_RESOLUTIONS), std::end(DEFAULT_RESOLUTIONS));
+        }
+        if (options.mapSizes.empty()) {
+            options.mapSizes.assign(std::begin(DEFAULT_MAP_SIZES), std::end(DEFAULT_MAP_SIZES));
+        }
+        if (options.fixtures.empty()) {
+            options.fixtures.assign(std::begin(FIXTURE_NAMES), std::end(FIXTURE_NAMES));
+        }
+
+        for (const Resolution &resolution : options.resolutions) {
+            if (resolution.width <= 0 || resolution.height <= 0) {
+                return false;
+            }
+        }
+        for (const int size : options.mapSizes) {
+            if (size < 8) {
+                return false;
+            }
+        }
+        for (const std::string &fixture : options.fixtures) {
+            if (std::find(std::begin(FIXTURE_NAMES), std::end(FIXTURE_NAMES), fixture) == std::end(FIXTURE_NAMES)) {
+                return false;
+            }
+        }
+
+        return options.poses > 0 && options.repeats > 0 && options.threshold >= 0;
+    }
+
+    // Small deterministic generator so every run builds and casts the same
+    std::uint64_t NextRandom(std::uint64_t &state)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 11;
+    }
+
+    double NextUnit(std::uint64_t &state)
+    {
+        return NextRandom(state) * (1.0 / 9007199254740992.0);
+    }
+
+    // Corridors two cells wide running the length of the map, one wall
+    // apart, so rays along them go the whole way and rays across stop at
+    // once
+    void BuildCorridors(WorldMap &map, const int size)
+    {
+        map.Create(size, size);
+
+        for (int y{2}; y < size; y += 3) {
+            for (int x{0}; x < size; x++) {
+                map.SetCell(x, y, 1 + (x / 8) % 3);
+            }
+        }
+    }
+
+    // Open field with single-cell pillars every spacing cells
+    void BuildField(WorldMap &map, const int size, const int spacing)
+    {
+        map.Create(size, size);
+
+        for (int x{spacing / 2}; x < size; x += spacing) {
+            for (int y{spacing / 2}; y < size; y += spacing) {
+                map.SetCell(x, y, 1 + (x + y) % 3);
+            }
+        }
+    }
+
+    // Perfect maze of one-cell passages on the odd cells, carved by a
+    // depth-first walk
+    void BuildMaze(WorldMap &map, const int size)
+    {
+        map.Create(size, size);
+
+        for (int x{0}; x < size; x++) {
+            for (int y{0}; y < size; y++) {
+                map.SetCell(x, y, 1 + (x + y) % 3);
+            }
+        }
+
+        const int rooms = (size - 1) / 2;
+        std::vector<bool> visited(static_cast<std::size_t>(rooms) * rooms, false);
+        std::vector<int> stack{0};
+        std::uint64_t state{0x2545f4914f6cdd1dULL};
+        const int steps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+        visited[0] = true;
+        map.SetCell(1, 1, 0);
+
+        while (!stack.empty()) {
+            const int room = stack.back();
+            const int x = room / rooms;
+            const int y = room % rooms;
+            int next[4];
+            int count{0};
+
+            for (const auto &step : steps) {
+                const int nextX = x + step[0];
+                const int nextY = y + step[1];
+                if (nextX >= 0 && nextX < rooms && nextY >= 0 && nextY < rooms && !visited[nextX * rooms + nextY]) {
+                    next[count++] = nextX * rooms + nextY;
+                }
+            }
+
+            if (!count) {
+                stack.pop_back();
+                continue;
+            }
+
+            const int chosen = next[NextRandom(state) % count];
+            const int chosenX = chosen / rooms;
+            const int chosenY = chosen % rooms;
+            visited[chosen] = true;
+            map.SetCell(x + chosenX + 1, y + chosenY + 1, 0);
+            map.SetCell(2 * chosenX + 1, 2 * chosenY + 1, 0);
+            stack.push_back(chosen);
+        }
+    }
+
+    void BuildFixture(WorldMap &map, const std::string &fixture, const int size)
+    {
+        if (fixture == "corridors") {
+            BuildCorridors(map, size);
+        } else if (fixture == "field8") {
+            BuildField(map, size, 8);
+        } else if (fixture == "field64") {
+            BuildField(map, size, 64);
+        } else {
+            BuildMaze(map, size);
+        }
+    }
+
+    std::vector<CameraPose> GeneratePoses(const WorldMap &map, const int count)
+    {
+        std::vector<CameraPose> poses;
+        std::uint64_t state{0x853c49e6748fea9bULL};
+
+        while (static_cast<int>(poses.size()) < count) {
+            const Point<double> position{NextUnit(state) * map.GetColumns(), NextUnit(state) * map.GetRows()};
+            const double angle = NextUnit(state) * 2 * PI;
+            const Point<double> direction{std::cos(angle), std::sin(angle)};
+
+            if (!map.GetCell(static_cast<int>(position.x), static_cast<int>(position.y))) {
+                poses.push_back({position, direction, {direction.y * CAMERA_PLANE_LENGTH, -direction.x * CAMERA_PLANE_LENGTH}});
+            }
+        }
+
+        return poses;
+    }
+
+    // Column-major texels of a TEXTURE_SIZE square brick-like texture
+    std::vector<unsigned int> GenerateTexture()
+    {
+        std::vector<unsigned int> texels(TEXTURE_SIZE * TEXTURE_SIZE);
+
+        for (int x{0}; x < TEXTURE_SIZE; x++) {
+            for (int y{0}; y < TEXTURE_SIZE; y++) {
+                const bool mortar = y % 16 == 0 || (x + (y / 16 % 2) * 16) % 32 == 0;
+                texels[x * TEXTURE_SIZE + y] = mortar ? 0xC0C0C0 : ((0x80 + x * 2) << 16) | ((0x20 + y) << 8) | 0x18;
+            }
+        }
+
+        return texels;
+    }
+
+    // Column-major buffer the wall stages draw into, one column per screen
+    // column
+    struct ScreenColumns {
+        std::vector<unsigned int> pixels;
+        int stride;
+    };
+
+    // A generated map and the poses cast from it
+    struct Scene {
+        std::string fixture;
+        int size;
+        WorldMap map;
+        std::vector<CameraPose> poses;
+    };
+
+    // A scene's rays at one resolution, cast once so the wall stages draw
+    // the same spans on every call
+    struct SceneView {
+        const Scene *scene;
+        Resolution resolution;
+        RayTable table;
+        std::vector<RayHit> hits;
+        ScreenColumns columns;
+    };
+
+    // The buffers of the stages that take a whole frame
+    struct FrameView {
+        Resolution resolution;
+        ScreenColumns columns;
+        std::unique_ptr<MemoryRenderTarget> back;
+        std::unique_ptr<MemoryRenderTarget> screen;
+        unsigned int colour;
+    };
+
+    // One stage at one point of the matrix. Calling run does units rays or
+    // pixels of work.
+    struct Case {
+        Result result;
+        std::function<void()> run;
+        double units;
+        int calls;
+    };
+
+    ScreenColumns CreateScreenColumns(const Resolution &resolution)
+    {
+        ScreenColumns columns;
+        columns.stride = (resolution.height + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+        columns.pixels.assign(static_cast<std::size_t>(columns.stride) * resolution.width, 0);
+        return columns;
+    }
+
+    // Draws the wall span of every hit into columns as the engine's
+    // DrawColumn() does, and returns the pixels drawn
+    std::uint64_t DrawSpans(const SceneView &view, const bool lit, const std::vector<unsigned int> &texture,
+                            const ColourMap &colourMap, ScreenColumns &columns)
+    {
+        const int width = view.resolution.width;
+        const int height = view.resolution.height;
+        std::uint64_t pixels{0};
+
+        for (std::size_t i{0}; i < view.hits.size(); i++) {
+            const RayHit &hit = view.hits[i];
+            const int wallHeight = std::min(static_cast<int>(height / hit.perpWallDistance), height);
+
+            if (wallHeight <= 0) {
+                continue;
+            }
+
+            WallSpan span;
+            int mode{WALL_SPAN_TEXTURED};
+
+            if (lit) {
+                span.shade = &colourMap.GetTable(colourMap.GetLevel(hit.perpWallDistance, hit.sideHit));
+                mode |= WALL_SPAN_LIT;
+            } else if (hit.sideHit) {
+                mode |= WALL_SPAN_SIDE_SHADED;
+            }
+
+            const int textureX = static_cast<int>(hit.wallX * TEXTURE_SIZE);
+            span.texels = &texture[textureX * TEXTURE_SIZE];
+            span.texelPitch = 1;
+            SetWallSpanTextureRows(span, TEXTURE_SIZE, wallHeight, height);
+
+            unsigned int *column = &columns.pixels[(i % width) * columns.stride];
+            GetWallSpanKernel(mode)(column + (height - wallHeight) / 2, wallHeight, span);
+            pixels += wallHeight;
+        }
+
+        return pixels;
+    }
+
+    void CastView(const CastKernel kernel, const MapView &map, SceneView &view)
+    {
+        const int width = view.resolution.width;
+
+        for (std::size_t i{0}; i < view.scene->poses.size(); i++) {
+            CastColumns(kernel, map, view.scene->poses[i], view.table, 0, width, &view.hits[i * width]);
+        }
+    }
+
+    void AddSceneCases(const CastKernel kernel, SceneView &view, const std::vector<unsigned int> &texture,
+                       const ColourMap &colourMap, std::vector<Case> &cases)
+    {
+        const MapView skipMap = view.scene->map.GetView();
+        MapView plainMap = skipMap;
+        plainMap.distances = nullptr;
+
+        UpdateRayTable(view.table, view.resolution.width);
+        view.hits.resize(view.scene->poses.size() * view.resolution.width);
+        view.columns = CreateScreenColumns(view.resolution);
+        CastView(kernel, plainMap, view);
+
+        double totalDistance{0};
+        for (const RayHit &hit : view.hits) {
+            totalDistance += hit.perpWallDistance;
+        }
+
+        const Result result{"", view.scene->fixture, view.scene->size, view.resolution, totalDistance / view.hits.size(), 0};
+        const double rays = static_cast<double>(view.hits.size());
+        const double pixels = std::max<double>(static_cast<double>(DrawSpans(view, false, texture, colourMap, view.columns)), 1);
+        SceneView *state = &view;
+
+        cases.push_back({result, [=] { CastView(kernel, plainMap, *state); }, rays, 1});
+        cases.back().result.stage = "dda";
+        cases.push_back({result, [=] { CastView(kernel, skipMap, *state); }, rays, 1});
+        cases.back().result.stage = "dda_skip";
+        cases.push_back({result, [=, &texture, &colourMap] { DrawSpans(*state, false, texture, colourMap, state->columns); }, pixels, 1});
+        cases.back().result.stage = "span";
+        cases.push_back({result, [=, &texture, &colourMap] { DrawSpans(*state, true, texture, colourMap, state->columns); }, pixels, 1});
+        cases.back().result.stage = "shade";
+    }
+
+    void AddFrameCases(FrameView &view, std::vector<Case> &cases)
+    {
+        const int width = view.resolution.width;
+        const int height = view.resolution.height;
+
+        view.columns = CreateScreenColumns(view.resolution);
+        for (std::size_t i{0}; i < view.columns.pixels.size(); i++) {
+            view.columns.pixels[i] = static_cast<unsigned int>(i * 2654435761u) & 0xFFFFFF;
+        }
+        view.back.reset(new MemoryRenderTarget(width, height));
+        view.screen.reset(new MemoryRenderTarget(width, height));
+        view.colour = 0;
+
+        const Result result{"", "", 0, view.resolution, 0, 0};
+        const double pixels = static_cast<double>(width) * height;
+        FrameView *state = &view;
+
+        // A new colour each call, so no fill can be skipped
+        cases.push_back({result, [=] {
+            const FrameBuffer frame = state->back->Lock();
+            std::fill(frame.pixels, frame.pixels + static_cast<std::size_t>(width) * height, state->colour++);
+        }, pixels, 1});
+        cases.back().result.stage = "clear";
+        cases.push_back({result, [=] {
+            CopyColumnsToRows(state->columns.pixels.data(), state->columns.stride, state->back->Lock(), 0, height);
+        }, pixels, 1});
+        cases.back().result.stage = "transpose";
+        cases.push_back({result, [=] { CopyFrame(state->back->Lock(), state->screen->Lock()); }, pixels, 1});
+        cases.back().result.stage = "blit";
+    }
+
+    double TimeCalls(const Case &stageCase)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i{0}; i < stageCase.calls; i++) {
+            stageCase.run();
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Times every case once a round, over repeats rounds, and keeps each
+    // case's best time per unit. Timing a case in every round rather than
+    // in one go means a busy spell on the machine slows one of its runs
+    // rather than all of them. A run calls the case enough times to take
+    // at least MIN_RUN_NANOSECONDS.
+    void TimeCases(const int repeats, std::vector<Case> &cases)
+    {
+        // Finding the number of calls warms the caches and isn't counted
+        for (Case &stageCase : cases) {
+            while (TimeCalls(stageCase) < MIN_RUN_NANOSECONDS && stageCase.calls < MAX_RUN_CALLS) {
+                stageCase.calls *= 2;
+            }
+            stageCase.result.nanoseconds = std::numeric_limits<double>::max();
+        }
+
+        for (int round{0}; round < repeats; round++) {
+            for (Case &stageCase : cases) {
+                const double nanoseconds = TimeCalls(stageCase) / (stageCase.calls * stageCase.units);
+                stageCase.result.nanoseconds = std::min(stageCase.result.nanoseconds, nanoseconds);
+            }
+        }
+    }
+
+    std::string GetResultName(const Result &result)
+    {
+        std::ostringstream name;
+        name << result.stage << "/";
+        if (!result.fixture.empty()) {
+            name << result.fixture << "/" << result.mapSize << "/";
+        }
+        name << result.resolution.width << "x" << result.resolution.height;
+        return name.str();
+    }
+
+    // One result a line, which ReadBaseline() relies on
+    void WriteJson(std::ostream &stream, const CastKernel kernel, const Options &options, const std::vector<Result> &results)
+    {
+        stream << "{" << std::endl
+               << "  \"kernel\": \"" << GetCastKernelName(kernel) << "\"," << std::endl
+               << "  \"poses\": " << options.poses << "," << std::endl
+               << "  \"repeats\": " << options.repeats << "," << std::endl
+               << "  \"results\": [" << std::endl;
+
+        for (std::size_t i{0}; i < results.size(); i++) {
+            const Result &result = results[i];
+            stream << std::fixed << std::setprecision(4)
+                   << "    {\"name\": \"" << GetResultName(result) << "\", \"stage\": \"" << result.stage
+                   << "\", \"fixture\": \"" << result.fixture << "\", \"map_size\": " << result.mapSize
+                   << ", \"width\": " << result.resolution.width << ", \"height\": " << result.resolution.height
+                   << ", \"mean_distance\": " << result.meanDistance << ", \"ns\": " << result.nanoseconds << "}"
+                   << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+
+        stream << "  ]" << std::endl << "}" << std::endl;
+    }
+
+    // Reads the kernel and every result's time back from WriteJson() output
+    bool ReadBaseline(const std::string &path, std::string &kernel, std::map<std::string, double> &times)
+    {
+        std::ifstream file(path);
+        if (!file) {
+            return false;
+        }
+
+        const std::string KERNEL_KEY = "\"kernel\": \"";
+        const std::string NAME_KEY = "\"name\": \"";
+        const std::string TIME_KEY = "\"ns\": ";
+        std::string line;
+
+        while (std::getline(file, line)) {
+            const std::size_t kernelStart = line.find(KERNEL_KEY);
+            const std::size_t nameStart = line.find(NAME_KEY);
+            const std::size_t timeStart = line.find(TIME_KEY);
+
+            if (kernelStart != std::string::npos) {
+                const std::size_t start = kernelStart + KERNEL_KEY.size();
+                kernel = line.substr(start, line.find('"', start) - start);
+            } else if (nameStart != std::string::npos && timeStart != std::string::npos) {
+                const std::size_t start = nameStart + NAME_KEY.size();
+                times[line.substr(start, line.find('"', start) - start)] = std::atof(line.c_str() + timeStart + TIME_KEY.size());
+            }
+        }
+
+        return !times.empty();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options{{}, {}, {}, 16, 5, CastKernel::AUTO, 0.25, "", "", ""};
+
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const CastKernel kernel = (options.kernel == CastKernel::AUTO) ? GetBestCastKernel() : options.kernel;
+    const std::vector<unsigned int> texture = GenerateTexture();
+    const ColourMap colourMap;
+
+    // Cases point into the scenes and views, so they are made up front and
+    // never move
+    std::vector<std::unique_ptr<Scene>> scenes;
+    std::vector<std::unique_ptr<SceneView>> sceneViews;
+    std::vector<std::unique_ptr<FrameView>> frameViews;
+    std::vector<Case> cases;
+
+    for (const std::string &fixture : options.fixtures) {
+        for (const int size : options.mapSizes) {
+            scenes.emplace_back(new Scene{fixture, size, {}, {}});
+            Scene &scene = *scenes.back();
+            BuildFixture(scene.map, fixture, size);
+            scene.map.BuildDistanceField();
+            scene.poses = GeneratePoses(scene.map, options.poses);
+
+            for (const Resolution &resolution : options.resolutions) {
+                sceneViews.emplace_back(new SceneView{&scene, resolution, {0, {}}, {}, {}});
+                AddSceneCases(kernel, *sceneViews.back(), texture, colourMap, cases);
+            }
+        }
+    }
+
+    for (const Resolution &resolution : options.resolutions) {
+        frameViews.emplace_back(new FrameView{resolution, {}, nullptr, nullptr, 0});
+        AddFrameCases(*frameViews.back(), cases);
+    }
+
+    TimeCases(options.repeats, cases);
+
+    std::vector<Result> results;
+    for (const Case &stageCase : cases) {
+        results.push_back(stageCase.result);
+    }
+
+    if (options.jsonPath.empty()) {
+        WriteJson(std::cout, kernel, options, results);
+    } else {
+        std::ofstream file(options.jsonPath);
+        WriteJson(file, kernel, options, results);
+        if (!file) {
+            std::cerr << "Error writing " << options.jsonPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (!options.writeBaselinePath.empty()) {
+        std::ofstream file(options.writeBaselinePath);
+        WriteJson(file, kernel, options, results);
+        if (!file) {
+            std::cerr << "Error writing " << options.writeBaselinePath << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.baselinePath.empty()) {
+        return 0;
+    }
+
+    std::string baselineKernel;
+    std::map<std::string, double> baseline;
+    if (!ReadBaseline(options.baselinePath, baselineKernel, baseline)) {
+        std::cerr << "Error reading baseline " << options.baselinePath << std::endl;
+        return 1;
+    }
+
+    // Cast times of different kernels can't be compared
+    if (baselineKernel != GetCastKernelName(kernel)) {
+        std::cerr << "Baseline was recorded with the " << baselineKernel << " kernel; run with --kernel "
+                  << baselineKernel << std::endl;
+        return 1;
+    }
+
+    int compared{0};
+    int missing{0};
+    int regressions{0};
+
+    // A case the baseline lacks is a failure too, or a baseline of another
+    // matrix would pass without checking anything
+    for (const Result &result : results) {
+        const std::string name = GetResultName(result);
+        const auto found = baseline.find(name);
+        if (found == baseline.end() || found->second <= 0) {
+            missing++;
+            std::cerr << "missing from baseline " << name << std::endl;
+            continue;
+        }
+
+        const double change = result.nanoseconds / found->second - 1;
+        compared++;
+
+        if (change > options.threshold) {
+            regressions++;
+            std::cerr << std::fixed << std::setprecision(4) << "regression " << name << " " << result.nanoseconds
+                      << " ns vs " << found->second << " ns (+" << std::setprecision(1) << change * 100 << "%)" << std::endl;
+        }
+    }
+
+    std::cerr << "compared " << compared << " cases with the baseline, " << missing << " missing, "
+              << regressions << " regressions" << std::endl;
+    return regressions || missing || !compared ? 1 : 0;
+}
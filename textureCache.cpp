@@ -0,0 +1,211 @@
+#include "textureCache.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    // Slots start on a cache line
+    const std::size_t SLOT_ALIGNMENT_TEXELS{16};
+}
+
+TextureCache::TextureCache(const std::shared_ptr<const TexturePack> &pack, const std::size_t budgetBytes) :
+    m_pack{pack},
+    m_slotTexels{(pack->GetLargestTexelCount() + SLOT_ALIGNMENT_TEXELS - 1) / SLOT_ALIGNMENT_TEXELS * SLOT_ALIGNMENT_TEXELS},
+    m_slotCount{0},
+    m_holdsAll{false},
+    m_textureSlots{new std::atomic<int>[pack->GetTextureCount()]},
+    m_requested{new std::atomic<bool>[pack->GetTextureCount()]},
+    m_frame{0},
+    m_misses{0},
+    m_loads{0},
+    m_evictions{0},
+    m_stopping{false}
+{
+    const int count = pack->GetTextureCount();
+
+    if (m_slotTexels) {
+        const std::size_t fit = budgetBytes / (m_slotTexels * sizeof(unsigned int));
+        m_slotCount = static_cast<int>(std::max<std::size_t>(1, std::min<std::size_t>(fit, count)));
+    }
+    m_holdsAll = m_slotCount >= count;
+
+    m_atlas.resize(m_slotCount * m_slotTexels);
+    m_slotUsed.reset(new std::atomic<std::uint32_t>[m_slotCount]);
+    m_slotTextures.assign(m_slotCount, -1);
+
+    for (int slot{m_slotCount - 1}; slot >= 0; slot--) {
+        m_slotUsed[slot].store(0);
+        m_freeSlots.push_back(slot);
+    }
+
+    for (int texture{0}; texture < count; texture++) {
+        m_averageColours.push_back(pack->GetInfo(texture).averageColour);
+        m_textureSlots[texture].store(-1);
+        m_requested[texture].store(false);
+    }
+
+    if (m_holdsAll) {
+        for (int texture{0}; texture < count; texture++) {
+            m_requested[texture].store(true);
+            m_freeSlots.pop_back();
+
+            if (pack->ReadTexture(texture, &m_atlas[texture * m_slotTexels])) {
+                Publish(texture, texture);
+            }
+        }
+        return;
+    }
+
+    m_loadThread = std::thread(&TextureCache::LoadLoop, this);
+}
+
+TextureCache::~TextureCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    if (m_loadThread.joinable()) {
+        m_loadThread.join();
+    }
+}
+
+int TextureCache::GetLevelFor(const int texture, const double drawnSize) const noexcept
+{
+    const TextureInfo &info = m_pack->GetInfo(texture);
+    int level{0};
+
+    while (level + 1 < info.levels && (info.height >> (level + 1)) >= drawnSize) {
+        level++;
+    }
+
+    return level;
+}
+
+void TextureCache::Prefetch(const int texture)
+{
+    if (texture >= 0 && texture < GetTextureCount()) {
+        Request(texture, false);
+    }
+}
+
+void TextureCache::Request(const int texture, const bool missed)
+{
+    // Checked before the exchange, so drawing threads reading a texture
+    // that is already queued only share the flag's cache line
+    if (m_requested[texture].load(std::memory_order_relaxed) || m_requested[texture].exchange(true)) {
+        return;
+    }
+
+    if (missed) {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Textures already being drawn go ahead of prefetches
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (missed) {
+            m_requests.push_front(texture);
+        } else {
+            m_requests.push_back(texture);
+        }
+    }
+    m_wake.notify_one();
+}
+
+void TextureCache::Update()
+{
+    if (m_holdsAll) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const std::uint32_t frame = m_frame.load(std::memory_order_relaxed) + 1;
+    m_frame.store(frame, std::memory_order_relaxed);
+
+    const int wanted = static_cast<int>(m_requests.size()) - static_cast<int>(m_freeSlots.size());
+    if (wanted <= 0) {
+        return;
+    }
+
+    // Least recently drawn first, leaving those of the last frame alone
+    std::vector<int> candidates;
+    for (int slot{0}; slot < m_slotCount; slot++) {
+        if (m_slotTextures[slot] >= 0 && m_slotUsed[slot].load(std::memory_order_relaxed) < frame - 1) {
+            candidates.push_back(slot);
+        }
+    }
+
+    const int evicted = std::min(wanted, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + evicted, candidates.end(), [this](const int a, const int b) {
+        return m_slotUsed[a].load(std::memory_order_relaxed) < m_slotUsed[b].load(std::memory_order_relaxed);
+    });
+
+    for (int i{0}; i < evicted; i++) {
+        const int slot = candidates[i];
+        const int texture = m_slotTextures[slot];
+
+        m_textureSlots[texture].store(-1, std::memory_order_relaxed);
+        m_requested[texture].store(false, std::memory_order_relaxed);
+        m_slotTextures[slot] = -1;
+        m_freeSlots.push_back(slot);
+    }
+
+    m_evictions += evicted;
+
+    if (evicted) {
+        lock.unlock();
+        m_wake.notify_one();
+    }
+}
+
+TextureCacheStats TextureCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return {m_slotCount, m_slotCount - static_cast<int>(m_freeSlots.size()), m_atlas.size() * sizeof(unsigned int),
+            m_misses.load(std::memory_order_relaxed), m_loads, m_evictions};
+}
+
+void TextureCache::Publish(const int slot, const int texture)
+{
+    m_slotTextures[slot] = texture;
+    m_slotUsed[slot].store(m_frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_loads++;
+
+    // Release, so a thread that sees the slot sees its texels
+    m_textureSlots[texture].store(slot, std::memory_order_release);
+}
+
+void TextureCache::LoadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stopping || (!m_requests.empty() && !m_freeSlots.empty()); });
+
+        if (m_stopping) {
+            return;
+        }
+
+        const int texture = m_requests.front();
+        const int slot = m_freeSlots.back();
+        m_requests.pop_front();
+        m_freeSlots.pop_back();
+
+        // The slot is free, so no drawing thread reads it while it fills
+        lock.unlock();
+        const bool read = m_pack->ReadTexture(texture, &m_atlas[slot * m_slotTexels]);
+        lock.lock();
+
+        if (read) {
+            Publish(slot, texture);
+        } else {
+            // Drawn in its average colour from now on
+            m_freeSlots.push_back(slot);
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "texturePack.hpp"
+
+namespace Raycaster
+{
+    // Memory kept for resident textures unless asked otherwise
+    const std::size_t DEFAULT_TEXTURE_CACHE_BYTES{64 << 20};
+
+    // One mip level of a texture; column x starts at texels[x * height]
+    struct MipLevel {
+        const unsigned int *texels;
+        int width;
+        int height;
+    };
+
+    struct TextureCacheStats {
+        int slots;
+        int residentTextures;
+        std::size_t bytes;
+        // Lookups of textures that weren't resident, loads made and
+        // textures evicted to make room, since the cache was created
+        std::uint64_t misses;
+        std::uint64_t loads;
+        std::uint64_t evictions;
+    };
+
+    // Keeps a bounded set of a pack's textures resident for drawing.
+    //
+    // Memory is one atlas of equal slots, each big enough for the mip
+    // levels of the pack's largest texture, so a budget gives a fixed slot
+    // count however many textures the pack has. Get() is lock-free and can
+    // be called from many drawing threads at once. A texture that isn't
+    // resident is queued for a loader thread and drawn in its average
+    // colour until it arrives.
+    //
+    // Slots only change hands in Update(), which must be called between
+    // frames with no Get() running: it evicts the least recently drawn
+    // textures to make room for the queued ones, never one drawn in the
+    // frame just finished. The loader fills free slots in the meantime.
+    class TextureCache
+    {
+    public:
+        // Packs that fit in the budget are loaded whole up front
+        TextureCache(const std::shared_ptr<const TexturePack> &pack, const std::size_t budgetBytes);
+        ~TextureCache();
+
+        TextureCache(const TextureCache&) = delete;
+        TextureCache& operator=(const TextureCache&) = delete;
+
+        int GetTextureCount() const noexcept { return m_pack->GetTextureCount(); }
+        const TextureInfo& GetInfo(const int texture) const noexcept { return m_pack->GetInfo(texture); }
+        bool HoldsAll() const noexcept { return m_holdsAll; }
+
+        // Level to draw a texture at when its height covers drawnSize
+        // pixels: the largest level with at least one texel per pixel
+        int GetLevelFor(const int texture, const double drawnSize) const noexcept;
+
+        // Level of a valid texture, or its average colour as a 1x1 level
+        // while it loads
+        MipLevel Get(const int texture, const int level) noexcept
+        {
+            const int slot = m_textureSlots[texture].load(std::memory_order_acquire);
+
+            if (slot < 0) {
+                Request(texture, true);
+                return {&m_averageColours[texture], 1, 1};
+            }
+
+            // Only written when it changes, so threads drawing from the
+            // same slot don't fight over its cache line every column
+            const std::uint32_t frame = m_frame.load(std::memory_order_relaxed);
+            if (m_slotUsed[slot].load(std::memory_order_relaxed) != frame) {
+                m_slotUsed[slot].store(frame, std::memory_order_relaxed);
+            }
+
+            const TextureInfo &info = m_pack->GetInfo(texture);
+            return {&m_atlas[slot * m_slotTexels + info.levelOffsets[level]],
+                    std::max(1, info.width >> level), std::max(1, info.height >> level)};
+        }
+
+        // Queues a texture expected to be drawn soon; ignored if it is
+        // resident or queued already
+        void Prefetch(const int texture);
+
+        // Starts a new frame; see above
+        void Update();
+
+        TextureCacheStats GetStats();
+
+    private:
+        void Request(const int texture, const bool missed);
+        // Makes a slot filled with texture visible to Get()
+        void Publish(const int slot, const int texture);
+        void LoadLoop();
+
+        std::shared_ptr<const TexturePack> m_pack;
+        std::size_t m_slotTexels;
+        int m_slotCount;
+        bool m_holdsAll;
+
+        std::vector<unsigned int> m_atlas;
+        std::vector<unsigned int> m_averageColours;
+
+        // Slot of each texture, or -1
+        std::unique_ptr<std::atomic<int>[]> m_textureSlots;
+        // Set while a texture is queued or resident
+        std::unique_ptr<std::atomic<bool>[]> m_requested;
+        // Frame each slot was last drawn from
+        std::unique_ptr<std::atomic<std::uint32_t>[]> m_slotUsed;
+        std::atomic<std::uint32_t> m_frame;
+        std::atomic<std::uint64_t> m_misses;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        // Texture in each slot, or -1; guarded by m_mutex
+        std::vector<int> m_slotTextures;
+        std::vector<int> m_freeSlots;
+        std::deque<int> m_requests;
+        std::uint64_t m_loads;
+        std::uint64_t m_evictions;
+        bool m_stopping;
+
+        std::thread m_loadThread;
+    };
+}
+
+#endif // TEXTURE_CACHE_HPP
@@ -0,0 +1,79 @@
+// Texture converter
+//
+// Packs binary PPM (P6) images into a texture pack, building the mip
+// levels the engine draws distant walls with. Texture i of the pack is
+// image i on the command line, drawn on walls of cell value i + 1.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texturePack.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    // Reads a P6 image with 8-bit channels into 0x00RRGGBB texels, row by row
+    bool ReadPpm(const std::string &path, int &width, int &height, std::vector<unsigned int> &texels)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string magic;
+        int maxValue;
+
+        if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255 ||
+            width <= 0 || height <= 0 || width > MAX_TEXTURE_SIDE || height > MAX_TEXTURE_SIDE) {
+            return false;
+        }
+
+        // One whitespace byte separates the header from the pixels
+        file.get();
+
+        std::vector<unsigned char> bytes(static_cast<std::size_t>(width) * height * 3);
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+            return false;
+        }
+
+        texels.resize(static_cast<std::size_t>(width) * height);
+        for (std::size_t i{0}; i < texels.size(); i++) {
+            texels[i] = bytes[i * 3] << 16 | bytes[i * 3 + 1] << 8 | bytes[i * 3 + 2];
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <output pack> <image.ppm>..." << std::endl;
+        return 1;
+    }
+
+    TexturePack pack;
+    std::vector<unsigned int> texels;
+
+    for (int i{2}; i < argc; i++) {
+        int width;
+        int height;
+
+        if (!ReadPpm(argv[i], width, height, texels)) {
+            std::cerr << "Error reading image " << argv[i] << std::endl;
+            return 1;
+        }
+
+        if (!pack.Add(width, height, texels.data())) {
+            std::cerr << "Texture sides must be powers of two up to " << MAX_TEXTURE_SIDE << ": " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!pack.Save(argv[1])) {
+        std::cerr << "Error writing texture pack " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::cout << pack.GetTextureCount() << " textures written to " << argv[1] << std::endl;
+    return 0;
+}
@@ -0,0 +1,353 @@
+#include "texturePack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAYCASTER_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Raycaster;
+
+namespace
+{
+    const char PACK_MAGIC[4] = {'R', 'C', 'T', 'X'};
+    const std::uint32_t PACK_VERSION{1};
+    const std::size_t PACK_HEADER_SIZE{32};
+    const std::size_t TABLE_ENTRY_SIZE{32};
+    const std::size_t DATA_ALIGNMENT{64};
+    // Keeps the table of a corrupt file from asking for gigabytes
+    const std::uint32_t MAX_TEXTURES{1 << 16};
+
+    std::uint32_t ReadUint32(const unsigned char *bytes) noexcept
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+    }
+
+    std::uint64_t ReadUint64(const unsigned char *bytes) noexcept
+    {
+        return ReadUint32(bytes) | (static_cast<std::uint64_t>(ReadUint32(bytes + 4)) << 32);
+    }
+
+    void WriteUint32(unsigned char *bytes, const std::uint32_t value) noexcept
+    {
+        for (int i{0}; i < 4; i++) {
+            bytes[i] = (value >> (i * 8)) & 0xFF;
+        }
+    }
+
+    void WriteUint64(unsigned char *bytes, const std::uint64_t value) noexcept
+    {
+        WriteUint32(bytes, static_cast<std::uint32_t>(value));
+        WriteUint32(bytes + 4, static_cast<std::uint32_t>(value >> 32));
+    }
+
+    void DecodeTexels(const unsigned char *bytes, const std::size_t count, unsigned int *texels) noexcept
+    {
+        for (std::size_t i{0}; i < count; i++) {
+            texels[i] = ReadUint32(bytes + i * 4);
+        }
+    }
+
+    bool IsValidSide(const std::uint32_t side) noexcept
+    {
+        return side > 0 && side <= static_cast<std::uint32_t>(MAX_TEXTURE_SIDE) && !(side & (side - 1));
+    }
+
+    // Fills in the levels and their offsets for a texture of the given size
+    void SetLevels(TextureInfo &info, const int width, const int height) noexcept
+    {
+        info.width = width;
+        info.height = height;
+        info.levels = 1;
+
+        while ((width >> info.levels) || (height >> info.levels)) {
+            info.levels++;
+        }
+
+        info.texelCount = 0;
+        for (int level{0}; level < info.levels; level++) {
+            info.levelOffsets[level] = info.texelCount;
+            info.texelCount += static_cast<std::size_t>(std::max(1, width >> level)) * std::max(1, height >> level);
+        }
+    }
+
+    // Average of up to four texels, each channel rounded
+    unsigned int AverageTexels(const unsigned int *texels, const int count) noexcept
+    {
+        unsigned int red{0};
+        unsigned int green{0};
+        unsigned int blue{0};
+
+        for (int i{0}; i < count; i++) {
+            red += (texels[i] >> 16) & 0xFF;
+            green += (texels[i] >> 8) & 0xFF;
+            blue += texels[i] & 0xFF;
+        }
+
+        const unsigned int half = count / 2;
+        return ((red + half) / count) << 16 | ((green + half) / count) << 8 | (blue + half) / count;
+    }
+}
+
+TexturePack::TexturePack() :
+    m_largestTexelCount{0},
+    m_mapping{nullptr},
+    m_mappingSize{0}
+{
+
+}
+
+TexturePack::~TexturePack()
+{
+    Release();
+}
+
+bool TexturePack::Add(const int width, const int height, const unsigned int *texels)
+{
+    if (m_mapping || !m_path.empty() || !IsValidSide(width) || !IsValidSide(height)) {
+        return false;
+    }
+
+    TextureInfo info;
+    SetLevels(info, width, height);
+    info.dataOffset = m_texels.size();
+
+    m_texels.resize(m_texels.size() + info.texelCount);
+    unsigned int *levelTexels = &m_texels[info.dataOffset];
+
+    for (int x{0}; x < width; x++) {
+        for (int y{0}; y < height; y++) {
+            levelTexels[x * height + y] = texels[y * width + x];
+        }
+    }
+
+    // Each level averages blocks of 2x2 texels of the one before, or 2x1
+    // once a side is down to 1
+    for (int level{1}; level < info.levels; level++) {
+        const unsigned int *previous = levelTexels;
+        const int previousHeight = std::max(1, height >> (level - 1));
+        const int levelWidth = std::max(1, width >> level);
+        const int levelHeight = std::max(1, height >> level);
+        const int stepX = (width >> (level - 1)) > 1 ? 2 : 1;
+        const int stepY = previousHeight > 1 ? 2 : 1;
+
+        levelTexels = &m_texels[info.dataOffset + info.levelOffsets[level]];
+
+        for (int x{0}; x < levelWidth; x++) {
+            for (int y{0}; y < levelHeight; y++) {
+                unsigned int block[4];
+                int count{0};
+
+                for (int dx{0}; dx < stepX; dx++) {
+                    for (int dy{0}; dy < stepY; dy++) {
+                        block[count++] = previous[(x * stepX + dx) * previousHeight + y * stepY + dy];
+                    }
+                }
+
+                levelTexels[x * levelHeight + y] = AverageTexels(block, count);
+            }
+        }
+    }
+
+    info.averageColour = levelTexels[0];
+    m_largestTexelCount = std::max(m_largestTexelCount, info.texelCount);
+    m_textures.push_back(info);
+
+    return true;
+}
+
+bool TexturePack::Load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    unsigned char header[PACK_HEADER_SIZE];
+
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        std::memcmp(header, PACK_MAGIC, sizeof(PACK_MAGIC)) || ReadUint32(header + 4) != PACK_VERSION) {
+        return false;
+    }
+
+    const std::uint32_t count = ReadUint32(header + 8);
+    const std::uint32_t tableOffset = ReadUint32(header + 12);
+
+    file.seekg(0, std::ios::end);
+    const std::uint64_t fileSize = static_cast<std::uint64_t>(file.tellg());
+
+    if (count > MAX_TEXTURES || tableOffset < PACK_HEADER_SIZE ||
+        tableOffset + static_cast<std::uint64_t>(count) * TABLE_ENTRY_SIZE > fileSize) {
+        return false;
+    }
+
+    std::vector<unsigned char> table(count * TABLE_ENTRY_SIZE);
+    file.seekg(tableOffset);
+    if (!file.read(reinterpret_cast<char*>(table.data()), table.size())) {
+        return false;
+    }
+
+    std::vector<TextureInfo> textures(count);
+    std::size_t largestTexelCount{0};
+
+    for (std::uint32_t i{0}; i < count; i++) {
+        const unsigned char *entry = &table[i * TABLE_ENTRY_SIZE];
+        const std::uint32_t width = ReadUint32(entry);
+        const std::uint32_t height = ReadUint32(entry + 4);
+
+        if (!IsValidSide(width) || !IsValidSide(height)) {
+            return false;
+        }
+
+        TextureInfo &info = textures[i];
+        SetLevels(info, width, height);
+        info.averageColour = ReadUint32(entry + 12);
+        info.dataOffset = ReadUint64(entry + 16);
+
+        const std::uint64_t size = ReadUint64(entry + 24);
+        if (ReadUint32(entry + 8) != static_cast<std::uint32_t>(info.levels) || size != info.texelCount * 4 ||
+            info.dataOffset % DATA_ALIGNMENT || info.dataOffset > fileSize || size > fileSize - info.dataOffset) {
+            return false;
+        }
+
+        largestTexelCount = std::max(largestTexelCount, info.texelCount);
+    }
+
+    file.close();
+
+    #ifdef RAYCASTER_MMAP
+    // Texels are copied out of the mapping as textures are loaded, so pages
+    // of textures never drawn are never read
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    #endif
+
+    Release();
+    m_textures = std::move(textures);
+    m_largestTexelCount = largestTexelCount;
+
+    #ifdef RAYCASTER_MMAP
+    m_mapping = mapping;
+    m_mappingSize = fileSize;
+    #else
+    m_path = path;
+    #endif
+
+    return true;
+}
+
+bool TexturePack::Save(const std::string &path) const
+{
+    const std::size_t tableEnd = PACK_HEADER_SIZE + m_textures.size() * TABLE_ENTRY_SIZE;
+    std::vector<unsigned char> header(tableEnd, 0);
+    std::vector<std::uint64_t> offsets;
+    std::uint64_t offset = (tableEnd + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+
+    std::memcpy(header.data(), PACK_MAGIC, sizeof(PACK_MAGIC));
+    WriteUint32(&header[4], PACK_VERSION);
+    WriteUint32(&header[8], m_textures.size());
+    WriteUint32(&header[12], PACK_HEADER_SIZE);
+
+    for (std::size_t i{0}; i < m_textures.size(); i++) {
+        const TextureInfo &info = m_textures[i];
+        unsigned char *entry = &header[PACK_HEADER_SIZE + i * TABLE_ENTRY_SIZE];
+
+        WriteUint32(entry, info.width);
+        WriteUint32(entry + 4, info.height);
+        WriteUint32(entry + 8, info.levels);
+        WriteUint32(entry + 12, info.averageColour);
+        WriteUint64(entry + 16, offset);
+        WriteUint64(entry + 24, info.texelCount * 4);
+
+        offsets.push_back(offset);
+        offset = (offset + info.texelCount * 4 + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    std::vector<unsigned int> texels;
+    std::vector<unsigned char> bytes;
+    std::uint64_t written = header.size();
+
+    for (std::size_t i{0}; i < m_textures.size() && file; i++) {
+        texels.resize(m_textures[i].texelCount);
+        bytes.assign(offsets[i] - written, 0);
+
+        if (!ReadTexture(i, texels.data())) {
+            return false;
+        }
+
+        // Padding up to the aligned start, then the texels
+        for (const unsigned int texel : texels) {
+            unsigned char word[4];
+            WriteUint32(word, texel);
+            bytes.insert(bytes.end(), word, word + 4);
+        }
+
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        written += bytes.size();
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool TexturePack::ReadTexture(const int texture, unsigned int *texels) const
+{
+    if (texture < 0 || texture >= GetTextureCount()) {
+        return false;
+    }
+
+    const TextureInfo &info = m_textures[texture];
+
+    if (m_mapping) {
+        DecodeTexels(static_cast<const unsigned char*>(m_mapping) + info.dataOffset, info.texelCount, texels);
+        return true;
+    }
+
+    if (m_path.empty()) {
+        std::copy(&m_texels[info.dataOffset], &m_texels[info.dataOffset] + info.texelCount, texels);
+        return true;
+    }
+
+    std::vector<unsigned char> bytes(info.texelCount * 4);
+    {
+        std::lock_guard<std::mutex> lock(m_fileMutex);
+        std::ifstream file(m_path, std::ios::binary);
+        file.seekg(info.dataOffset);
+
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+            return false;
+        }
+    }
+
+    DecodeTexels(bytes.data(), info.texelCount, texels);
+    return true;
+}
+
+void TexturePack::Release() noexcept
+{
+    #ifdef RAYCASTER_MMAP
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+    #endif
+
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+    m_path.clear();
+    m_textures.clear();
+    m_texels.clear();
+    m_largestTexelCount = 0;
+}
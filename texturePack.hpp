@@ -0,0 +1,103 @@
+#ifndef TEXTURE_PACK_HPP
+#define TEXTURE_PACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Raycaster
+{
+    // Largest texture side, which keeps a texture's texel count in an int
+    const int MAX_TEXTURE_SIDE{4096};
+    const int MAX_TEXTURE_LEVELS{13};
+
+    struct TextureInfo {
+        // Sides of level 0, powers of two; level l is (width >> l) by
+        // (height >> l), neither side below 1
+        int width;
+        int height;
+        int levels;
+        // Colour of the smallest level, drawn while the texture loads
+        unsigned int averageColour;
+        // Where each level starts in the texture's texels
+        std::size_t levelOffsets[MAX_TEXTURE_LEVELS];
+        // Texels in all levels together
+        std::size_t texelCount;
+        // Byte offset of the texels in the file, or texel offset in memory
+        std::uint64_t dataOffset;
+    };
+
+    // Set of textures with their mip levels precomputed, built in memory
+    // or loaded from a file. Texels are 0x00RRGGBB and stored column by
+    // column, column x of a level starting at texel x * height, so a wall
+    // column reads consecutive texels.
+    //
+    // Files are memory-mapped where possible, otherwise read on demand. All
+    // header fields are little-endian, 32-bit unless noted:
+    //
+    //     0   magic "RCTX"
+    //     4   version (1)
+    //     8   textures
+    //     12  offset of the table (32)
+    //
+    // followed by a table of 32 bytes per texture:
+    //
+    //     0   width
+    //     4   height
+    //     8   levels
+    //     12  average colour
+    //     16  offset of the texels (64-bit, 64-byte aligned)
+    //     24  size of the texels in bytes (64-bit)
+    //
+    // and then the texels of every texture, level 0 first, as 32-bit
+    // little-endian words.
+    class TexturePack
+    {
+    public:
+        TexturePack();
+        ~TexturePack();
+
+        TexturePack(const TexturePack&) = delete;
+        TexturePack& operator=(const TexturePack&) = delete;
+
+        // Adds a texture given row by row, texel (x, y) at
+        // texels[y * width + x], and builds its mip levels. Fails if the
+        // sides aren't powers of two up to MAX_TEXTURE_SIDE, or the pack
+        // was loaded from a file.
+        bool Add(const int width, const int height, const unsigned int *texels);
+
+        // The pack is unchanged if loading fails
+        bool Load(const std::string &path);
+        bool Save(const std::string &path) const;
+
+        int GetTextureCount() const noexcept { return static_cast<int>(m_textures.size()); }
+        const TextureInfo& GetInfo(const int texture) const noexcept { return m_textures[texture]; }
+        // Texels in the largest texture's levels together
+        std::size_t GetLargestTexelCount() const noexcept { return m_largestTexelCount; }
+
+        // Copies all levels of a texture into texels, which must hold
+        // GetInfo(texture).texelCount. Safe to call from any thread.
+        bool ReadTexture(const int texture, unsigned int *texels) const;
+
+    private:
+        void Release() noexcept;
+
+        std::vector<TextureInfo> m_textures;
+        std::size_t m_largestTexelCount;
+
+        // Texels of textures added in memory
+        std::vector<unsigned int> m_texels;
+
+        // Backing for memory-mapped packs
+        void *m_mapping;
+        std::size_t m_mappingSize;
+
+        // Packs that can't be mapped are read from the file as needed
+        std::string m_path;
+        mutable std::mutex m_fileMutex;
+    };
+}
+
+#endif // TEXTURE_PACK_HPP
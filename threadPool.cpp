@@ -0,0 +1,159 @@
+#include "threadPool.hpp"
+
+#include <algorithm>
+
+using namespace Raycaster;
+
+namespace
+{
+    thread_local int t_threadIndex{0};
+}
+
+ThreadPool::ThreadPool(const int threadCount) :
+    m_task{nullptr},
+    m_pendingRanges{0},
+    m_generation{0},
+    m_stopping{false}
+{
+    int count = threadCount;
+    if (count <= 0) {
+        count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    for (int i{0}; i < count; i++) {
+        m_queues.emplace_back(new WorkQueue);
+    }
+
+    // Queue 0 belongs to the thread calling ParallelFor()
+    for (int i{1}; i < count; i++) {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeWorkers.notify_all();
+
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(const int count, const int grainSize, const std::function<void(int, int)> &task)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // The caller runs tasks as thread 0
+    t_threadIndex = 0;
+
+    const int grain = std::max(1, grainSize);
+    const int numberOfRanges = (count + grain - 1) / grain;
+
+    if (m_workers.empty() || numberOfRanges == 1) {
+        task(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(m_callMutex);
+
+    // Deal out contiguous runs of chunks so each thread starts on
+    // neighbouring indices
+    const int threadCount = GetThreadCount();
+    m_task = &task;
+    m_pendingRanges.store(numberOfRanges);
+
+    for (int t{0}; t < threadCount; t++) {
+        const int first = numberOfRanges * t / threadCount;
+        const int last = numberOfRanges * (t + 1) / threadCount;
+
+        std::lock_guard<std::mutex> lock(m_queues[t]->mutex);
+        for (int r{first}; r < last; r++) {
+            m_queues[t]->ranges.push_back({r * grain, std::min(count, (r + 1) * grain)});
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation++;
+    }
+    m_wakeWorkers.notify_all();
+
+    RunRanges(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_rangesDone.wait(lock, [this] { return m_pendingRanges.load() == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::WorkerLoop(const int index)
+{
+    std::uint64_t seenGeneration{0};
+    t_threadIndex = index;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeWorkers.wait(lock, [this, seenGeneration] { return m_stopping || m_generation != seenGeneration; });
+
+            if (m_stopping) {
+                return;
+            }
+            seenGeneration = m_generation;
+        }
+
+        RunRanges(index);
+    }
+}
+
+bool ThreadPool::PopRange(const int index, Range &range)
+{
+    // Own queue first, taken from the front to keep walking forward
+    {
+        WorkQueue &own = *m_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.ranges.empty()) {
+            range = own.ranges.front();
+            own.ranges.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the back of the other queues
+    const int threadCount = GetThreadCount();
+    for (int offset{1}; offset < threadCount; offset++) {
+        WorkQueue &victim = *m_queues[(index + offset) % threadCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.back();
+            victim.ranges.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::RunRanges(const int index)
+{
+    Range range;
+
+    while (PopRange(index, range)) {
+        (*m_task)(range.begin, range.end);
+
+        if (m_pendingRanges.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rangesDone.notify_all();
+        }
+    }
+}
+
+int ThreadPool::GetCurrentThreadIndex() noexcept
+{
+    return t_threadIndex;
+}
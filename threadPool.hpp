@@ -0,0 +1,73 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Raycaster
+{
+    // Persistent pool of worker threads. ParallelFor() splits an index range
+    // into chunks which are dealt out to per-thread queues; a thread that runs
+    // out of work steals chunks from the back of another thread's queue, so
+    // uneven chunk costs balance out.
+    class ThreadPool
+    {
+    public:
+        // threadCount includes the calling thread; 0 uses every hardware thread
+        explicit ThreadPool(const int threadCount);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int GetThreadCount() const noexcept { return static_cast<int>(m_queues.size()); }
+
+        // Calls task(begin, end) for consecutive chunks of [0, count) and
+        // blocks until every chunk has run. Calls from different threads
+        // take turns. Must not be called from a task.
+        void ParallelFor(const int count, const int grainSize, const std::function<void(int, int)> &task);
+
+        // Index of the calling thread within the pool while it runs a task:
+        // 0 for the thread that called ParallelFor(), 1 and up for workers.
+        // Lets tasks pick per-thread scratch space.
+        static int GetCurrentThreadIndex() noexcept;
+
+    private:
+        struct Range {
+            int begin;
+            int end;
+        };
+
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<Range> ranges;
+        };
+
+        void WorkerLoop(const int index);
+        bool PopRange(const int index, Range &range);
+        void RunRanges(const int index);
+
+        std::vector<std::unique_ptr<WorkQueue>> m_queues;
+        std::vector<std::thread> m_workers;
+
+        // Held for the whole of a ParallelFor()
+        std::mutex m_callMutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeWorkers;
+        std::condition_variable m_rangesDone;
+
+        const std::function<void(int, int)> *m_task;
+        std::atomic<int> m_pendingRanges;
+        std::uint64_t m_generation;
+        bool m_stopping;
+    };
+}
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,113 @@
+#ifndef WALL_SPAN_HPP
+#define WALL_SPAN_HPP
+
+#include <algorithm>
+#include <cstdint>
+
+#include "colourMap.hpp"
+
+namespace Raycaster
+{
+    // Vertical run of wall pixels, drawn into a column-major buffer
+    struct WallSpan {
+        // Colour of an untextured wall, already side shaded by the caller
+        unsigned int colour;
+        // Texel column of the wall; row r is texels[r * texelPitch]
+        const unsigned int *texels;
+        int texelPitch;
+        // Texel row of the first pixel and its step per pixel, as 32.32
+        // fixed point. Rows above the texture's top edge are negative.
+        std::int64_t textureY;
+        std::int64_t textureStep;
+        // Light level of a lit span
+        const ShadeTable *shade;
+    };
+
+    // Bits selecting the kernel a span is drawn with. A new mode gets a bit
+    // and a kernel specialisation of its own, so spans not using it keep
+    // running the same code.
+    enum WallSpanMode {
+        WALL_SPAN_TEXTURED = 1 << 0,
+        WALL_SPAN_SIDE_SHADED = 1 << 1,
+        // Shaded through a light level's table; side walls get a darker
+        // level instead of WALL_SPAN_SIDE_SHADED
+        WALL_SPAN_LIT = 1 << 2,
+        WALL_SPAN_MODES = 1 << 3
+    };
+
+    typedef void (*WallSpanKernel)(unsigned int *pixels, const int count, const WallSpan &span);
+
+    inline unsigned int ShadeSideTexel(const unsigned int colour) noexcept
+    {
+        return (colour >> 1) & 8355711;
+    }
+
+    template <bool SIDE_SHADED, bool LIT>
+    inline unsigned int ShadeSpanTexel(unsigned int colour, const WallSpan &span) noexcept
+    {
+        if (SIDE_SHADED) {
+            colour = ShadeSideTexel(colour);
+        }
+        if (LIT) {
+            colour = ShadeTexel(colour, *span.shade);
+        }
+
+        return colour;
+    }
+
+    template <bool TEXTURED, bool SIDE_SHADED, bool LIT>
+    void DrawWallSpan(unsigned int *pixels, const int count, const WallSpan &span)
+    {
+        if (!TEXTURED) {
+            std::fill(pixels, pixels + count, LIT ? ShadeTexel(span.colour, *span.shade) : span.colour);
+            return;
+        }
+
+        const unsigned int *texels = span.texels;
+        const int texelPitch = span.texelPitch;
+        std::int64_t textureY = span.textureY;
+        int j{0};
+
+        // Rows above the top edge of the texture repeat its first row
+        for (; j < count && textureY < 0; j++, textureY += span.textureStep) {
+            pixels[j] = ShadeSpanTexel<SIDE_SHADED, LIT>(texels[0], span);
+        }
+
+        for (; j < count; j++, textureY += span.textureStep) {
+            pixels[j] = ShadeSpanTexel<SIDE_SHADED, LIT>(texels[static_cast<int>(textureY >> 32) * texelPitch], span);
+        }
+    }
+
+    inline WallSpanKernel GetWallSpanKernel(const int mode) noexcept
+    {
+        static const WallSpanKernel KERNELS[WALL_SPAN_MODES] = {
+            DrawWallSpan<false, false, false>,
+            DrawWallSpan<true, false, false>,
+            DrawWallSpan<false, true, false>,
+            DrawWallSpan<true, true, false>,
+            DrawWallSpan<false, false, true>,
+            DrawWallSpan<true, false, true>,
+            DrawWallSpan<false, true, true>,
+            DrawWallSpan<true, true, true>
+        };
+
+        return KERNELS[mode];
+    }
+
+    // Sets the texture stepping for a wall wallHeight pixels tall, centred
+    // on a screen screenHeight pixels tall. Pixel k of the wall samples row
+    // (2k - p) * textureHeight / (2 * wallHeight), rounded down, where p is
+    // 1 when the heights differ by an odd number of pixels. The start and
+    // step are rounded up, so the error stays below the smallest gap to the
+    // next row and every pixel picks the same row as an exact divide.
+    inline void SetWallSpanTextureRows(WallSpan &span, const int textureHeight, const int wallHeight, const int screenHeight) noexcept
+    {
+        const std::int64_t ONE = std::int64_t{1} << 32;
+        const int oddOffset = (screenHeight - wallHeight) & 1;
+
+        span.textureStep = (textureHeight * ONE + wallHeight - 1) / wallHeight;
+        span.textureY = -(oddOffset * textureHeight * (ONE / 2) / wallHeight);
+    }
+}
+
+#endif // WALL_SPAN_HPP
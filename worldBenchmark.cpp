@@ -0,0 +1,201 @@
+// Headless streamed world benchmark
+//
+// Flies the camera across a ChunkedWorld far bigger than the chunk budget,
+// turning a quarter turn every --turn-frames frames, and reports frame
+// times with the world's chunk stats. Chunks are generated from --seed, or
+// with --file written to a chunk file first and read back from it, which
+// for large sides takes side * side bytes of disk.
+//
+// Chunks load on a thread of their own while frames are drawn, so frame
+// times and misses vary from run to run and no checksum is given.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "chunkedWorld.hpp"
+#include "raycasterEngine.hpp"
+#include "renderTarget.hpp"
+
+using namespace Raycaster;
+
+namespace
+{
+    const double CAMERA_PLANE_LENGTH = 0.66;
+    const double PI = 3.14159265358979323846;
+
+    struct Options {
+        int width;
+        int height;
+        int frames;
+        int threads;
+        int side;
+        double budgetMb;
+        double speed;
+        int turnFrames;
+        std::uint32_t seed;
+        std::string filePath;
+        bool printFrames;
+    };
+
+    void PrintUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--width N] [--height N] [--frames N] [--threads N]"
+                  << " [--side N] [--budget-mb N] [--speed N] [--turn-frames N] [--seed N]"
+                  << " [--file world.rcck] [--quiet]" << std::endl;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+
+            if (!std::strcmp(argv[i], "--width") && hasValue) {
+                options.width = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--height") && hasValue) {
+                options.height = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--frames") && hasValue) {
+                options.frames = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+                options.threads = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--side") && hasValue) {
+                options.side = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--budget-mb") && hasValue) {
+                options.budgetMb = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--speed") && hasValue) {
+                options.speed = std::atof(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--turn-frames") && hasValue) {
+                options.turnFrames = std::atoi(argv[++i]);
+            } else if (!std::strcmp(argv[i], "--seed") && hasValue) {
+                options.seed = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (!std::strcmp(argv[i], "--file") && hasValue) {
+                options.filePath = argv[++i];
+            } else if (!std::strcmp(argv[i], "--quiet")) {
+                options.printFrames = false;
+            } else {
+                return false;
+            }
+        }
+
+        return options.width > 0 && options.height > 0 && options.frames > 0 && options.threads >= 0 &&
+               options.side > 0 && options.side <= MAX_WORLD_SIDE && options.budgetMb > 0 && options.speed >= 0 &&
+               options.turnFrames > 0;
+    }
+
+    // Moves forward from the centre of the world, turning left a quarter
+    // turn every turnFrames frames, so the path is a square spiral outwards
+    CameraPose SetCameraForFrame(RaycasterEngine &engine, const Options &options, const int frame)
+    {
+        const double centre = options.side / 2.0 + 0.5;
+        double x = centre;
+        double y = centre;
+        int leg{0};
+
+        for (; (leg + 1) * options.turnFrames <= frame; leg++) {
+            const double length = options.turnFrames * options.speed * (leg / 2 + 1);
+            x += length * std::cos(leg * PI / 2);
+            y += length * std::sin(leg * PI / 2);
+        }
+
+        const double along = (frame - leg * options.turnFrames) * options.speed * (leg / 2 + 1);
+        const RaycasterEngine::Point<double> direction{std::cos(leg * PI / 2), std::sin(leg * PI / 2)};
+
+        engine.SetPlayerPosition({x + along * direction.x, y + along * direction.y});
+        engine.SetPlayerDirection(direction);
+        engine.SetCameraPlane({direction.y * CAMERA_PLANE_LENGTH, -direction.x * CAMERA_PLANE_LENGTH});
+
+        return {engine.GetPlayerPosition(), engine.GetPlayerDirection(), engine.GetCameraPlane()};
+    }
+
+    double Percentile(const std::vector<double> &sorted, const double percentile)
+    {
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+        return sorted[std::max<std::size_t>(rank, 1) - 1];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options{800, 600, 1200, 1, 1 << 20, 16, 0.5, 200, 1, "", true};
+
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<ChunkSource> source(new GeneratedChunkSource(options.seed));
+
+    if (!options.filePath.empty()) {
+        std::unique_ptr<ChunkFile> file(new ChunkFile);
+
+        if (!ChunkFile::Write(options.filePath, options.side, options.side, *source) || !file->Open(options.filePath)) {
+            std::cerr << "Error writing chunk file " << options.filePath << std::endl;
+            return 1;
+        }
+        source = std::move(file);
+    }
+
+    std::shared_ptr<ChunkedWorld> world(new ChunkedWorld(std::move(source), options.side, options.side,
+                                                         static_cast<std::size_t>(options.budgetMb * (1 << 20))));
+
+    std::unique_ptr<RaycasterEngine> engine(new RaycasterEngine);
+    engine->InitHeadless();
+    engine->SetRenderThreadCount(options.threads);
+    SetCameraForFrame(*engine, options, 0);
+    engine->SetStreamedWorld(world);
+
+    MemoryRenderTarget target(options.width, options.height);
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+
+    for (int frame{0}; frame < options.frames; frame++) {
+        const CameraPose pose = SetCameraForFrame(*engine, options, frame);
+        const auto start = std::chrono::steady_clock::now();
+
+        engine->RenderFrame(target, pose);
+
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        frameTimes.push_back(milliseconds);
+
+        if (options.printFrames) {
+            std::cout << "frame " << frame << " " << std::fixed << std::setprecision(3) << milliseconds << " ms" << std::endl;
+        }
+    }
+
+    const int threadCount = engine->GetRenderThreadCount();
+    engine->Cleanup();
+    const ChunkedWorldStats stats = world->GetStats();
+
+    double totalTime = 0;
+    for (const double frameTime : frameTimes) {
+        totalTime += frameTime;
+    }
+
+    std::vector<double> sorted(frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "resolution " << options.width << "x" << options.height << std::endl
+              << "threads " << threadCount << std::endl
+              << "world " << options.side << "x" << options.side << (options.filePath.empty() ? " generated" : " file") << std::endl
+              << "frames " << options.frames << std::endl
+              << "fps " << options.frames / (totalTime / 1000.0) << std::endl
+              << "p50_ms " << Percentile(sorted, 50) << std::endl
+              << "p99_ms " << Percentile(sorted, 99) << std::endl
+              << "max_ms " << sorted.back() << std::endl
+              << "chunk_buffers " << stats.chunkBuffers << std::endl
+              << "resident_chunks " << stats.residentChunks << std::endl
+              << "chunk_mb " << stats.bytes / static_cast<double>(1 << 20) << std::endl
+              << "chunk_misses " << stats.misses << std::endl
+              << "chunk_loads " << stats.loads << std::endl
+              << "chunk_evictions " << stats.evictions << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,558 @@
+#include "worldMap.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAYCASTER_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Raycaster;
+
+// Taken by reference by std::fill(), so they need a definition
+const int WorldMap::BORDER;
+const std::uint8_t WorldMap::BORDER_CELL;
+
+namespace
+{
+    const char BINARY_MAGIC[4] = {'R', 'C', 'M', 'P'};
+    const std::uint32_t BINARY_VERSION{1};
+    const std::size_t BINARY_HEADER_SIZE{64};
+    const std::size_t BLOCK_ALIGNMENT{64};
+    // Largest map side accepted from a file, keeps the cell index in an int
+    const int MAX_MAP_SIDE{1 << 15};
+
+    struct BinaryHeader {
+        std::uint32_t version;
+        std::uint32_t columns;
+        std::uint32_t rows;
+        std::uint32_t border;
+        std::uint32_t stride;
+        std::uint32_t blockOffset;
+        std::uint32_t blockSize;
+    };
+
+    std::uint32_t ReadUint32(const unsigned char *bytes) noexcept
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+    }
+
+    void WriteUint32(unsigned char *bytes, const std::uint32_t value) noexcept
+    {
+        for (int i{0}; i < 4; i++) {
+            bytes[i] = (value >> (i * 8)) & 0xFF;
+        }
+    }
+
+    bool ParseHeader(const unsigned char *bytes, BinaryHeader &header) noexcept
+    {
+        if (std::memcmp(bytes, BINARY_MAGIC, sizeof(BINARY_MAGIC))) {
+            return false;
+        }
+
+        header.version = ReadUint32(bytes + 4);
+        header.columns = ReadUint32(bytes + 8);
+        header.rows = ReadUint32(bytes + 12);
+        header.border = ReadUint32(bytes + 16);
+        header.stride = ReadUint32(bytes + 20);
+        header.blockOffset = ReadUint32(bytes + 24);
+        header.blockSize = ReadUint32(bytes + 28);
+
+        return header.version == BINARY_VERSION;
+    }
+
+    bool IsValidSize(const long long columns, const long long rows) noexcept
+    {
+        return columns > 0 && rows > 0 && columns <= MAX_MAP_SIDE && rows <= MAX_MAP_SIDE;
+    }
+}
+
+WorldMap::WorldMap() :
+    m_cells{nullptr},
+    m_columns{0},
+    m_rows{0},
+    m_stride{0},
+    m_distances{nullptr},
+    m_mapping{nullptr},
+    m_mappingSize{0},
+    m_version{0}
+{
+
+}
+
+WorldMap::~WorldMap()
+{
+    Release();
+}
+
+WorldMap::WorldMap(WorldMap &&other) noexcept :
+    WorldMap()
+{
+    *this = std::move(other);
+}
+
+WorldMap& WorldMap::operator=(WorldMap &&other) noexcept
+{
+    if (this != &other) {
+        Release();
+
+        m_cells = other.m_cells;
+        m_columns = other.m_columns;
+        m_rows = other.m_rows;
+        m_stride = other.m_stride;
+        m_storage = std::move(other.m_storage);
+        m_distances = other.m_distances;
+        m_distanceStorage = std::move(other.m_distanceStorage);
+        m_mapping = other.m_mapping;
+        m_mappingSize = other.m_mappingSize;
+        m_version = other.m_version;
+
+        other.m_cells = nullptr;
+        other.m_columns = other.m_rows = other.m_stride = 0;
+        other.m_storage.clear();
+        other.m_distances = nullptr;
+        other.m_distanceStorage.clear();
+        other.m_mapping = nullptr;
+        other.m_mappingSize = 0;
+    }
+
+    return *this;
+}
+
+void WorldMap::Create(const int columns, const int rows)
+{
+    WorldMap map;
+    std::uint8_t *block = AllocateBlock(map.m_storage, GetBlockSize(columns, rows));
+    map.Adopt(block, columns, rows);
+
+    // Border columns in full, then the top and bottom of every other column
+    const int stride = map.m_stride;
+    std::fill(block, block + BORDER * stride, BORDER_CELL);
+    std::fill(block + (columns + BORDER) * stride, block + (columns + 2 * BORDER) * stride, BORDER_CELL);
+
+    for (int x{BORDER}; x < columns + BORDER; x++) {
+        std::fill(block + x * stride, block + x * stride + BORDER, BORDER_CELL);
+        std::fill(block + x * stride + rows + BORDER, block + (x + 1) * stride, BORDER_CELL);
+    }
+
+    *this = std::move(map);
+}
+
+void WorldMap::CopyFrom(const WorldMap &other)
+{
+    if (this == &other) {
+        return;
+    }
+
+    WorldMap map;
+
+    if (other.m_cells) {
+        const std::size_t blockSize = GetBlockSize(other.m_columns, other.m_rows);
+        const std::size_t start = BORDER * other.m_stride + BORDER;
+
+        std::uint8_t *block = AllocateBlock(map.m_storage, blockSize);
+        std::copy(other.m_cells - start, other.m_cells - start + blockSize, block);
+        map.Adopt(block, other.m_columns, other.m_rows);
+
+        if (other.m_distances) {
+            std::uint8_t *distances = AllocateBlock(map.m_distanceStorage, blockSize);
+            std::copy(other.m_distances - start, other.m_distances - start + blockSize, distances);
+            map.m_distances = distances + start;
+        }
+    }
+
+    map.m_version = other.m_version;
+    *this = std::move(map);
+}
+
+bool WorldMap::Load(const std::string &path)
+{
+    char magic[sizeof(BINARY_MAGIC)] = {};
+
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.read(magic, sizeof(magic))) {
+            return false;
+        }
+    }
+
+    if (!std::memcmp(magic, BINARY_MAGIC, sizeof(BINARY_MAGIC))) {
+        return LoadBinary(path);
+    }
+
+    return LoadText(path);
+}
+
+bool WorldMap::LoadBinary(const std::string &path)
+{
+    #ifdef RAYCASTER_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) || static_cast<std::size_t>(status.st_size) < BINARY_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    // Private writable mapping: pages are shared with the page cache until
+    // SetCell() writes to one
+    const std::size_t size = status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    unsigned char *bytes = static_cast<unsigned char*>(mapping);
+    #else
+    std::ifstream file(path, std::ios::binary);
+    std::vector<std::uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::size_t size = contents.size();
+    unsigned char *bytes = contents.data();
+
+    if (size < BINARY_HEADER_SIZE) {
+        return false;
+    }
+    #endif
+
+    BinaryHeader header;
+    const bool valid = ParseHeader(bytes, header) &&
+        IsValidSize(header.columns, header.rows) &&
+        header.border == BORDER &&
+        header.stride == header.rows + 2 * BORDER &&
+        header.blockOffset % BLOCK_ALIGNMENT == 0 && header.blockOffset >= BINARY_HEADER_SIZE &&
+        header.blockSize == GetBlockSize(header.columns, header.rows) &&
+        static_cast<std::uint64_t>(header.blockOffset) + header.blockSize <= size &&
+        HasClosedBorder(bytes + header.blockOffset, header.columns, header.rows);
+
+    if (!valid) {
+        #ifdef RAYCASTER_MMAP
+        munmap(mapping, size);
+        #endif
+        return false;
+    }
+
+    WorldMap map;
+
+    #ifdef RAYCASTER_MMAP
+    map.m_mapping = mapping;
+    map.m_mappingSize = size;
+    map.Adopt(bytes + header.blockOffset, header.columns, header.rows);
+    #else
+    std::uint8_t *block = AllocateBlock(map.m_storage, header.blockSize);
+    std::copy(bytes + header.blockOffset, bytes + header.blockOffset + header.blockSize, block);
+    map.Adopt(block, header.columns, header.rows);
+    #endif
+
+    *this = std::move(map);
+    return true;
+}
+
+bool WorldMap::LoadText(const std::string &path)
+{
+    std::ifstream file(path);
+    long long columns{0};
+    long long rows{0};
+
+    if (!(file >> columns >> rows) || !IsValidSize(columns, rows)) {
+        return false;
+    }
+
+    WorldMap map;
+    map.Create(columns, rows);
+
+    for (int x{0}; x < columns; x++) {
+        for (int y{0}; y < rows; y++) {
+            int value;
+            if (!(file >> value) || value < 0 || value > std::numeric_limits<std::uint8_t>::max()) {
+                return false;
+            }
+            map.SetCell(x, y, value);
+        }
+    }
+
+    *this = std::move(map);
+    return true;
+}
+
+bool WorldMap::SaveBinary(const std::string &path) const
+{
+    if (!m_cells) {
+        return false;
+    }
+
+    unsigned char header[BINARY_HEADER_SIZE] = {};
+    std::memcpy(header, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    WriteUint32(header + 4, BINARY_VERSION);
+    WriteUint32(header + 8, m_columns);
+    WriteUint32(header + 12, m_rows);
+    WriteUint32(header + 16, BORDER);
+    WriteUint32(header + 20, m_stride);
+    WriteUint32(header + 24, BINARY_HEADER_SIZE);
+    WriteUint32(header + 28, GetBlockSize(m_columns, m_rows));
+
+    const std::uint8_t *block = m_cells - (BORDER * m_stride + BORDER);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(block), GetBlockSize(m_columns, m_rows));
+
+    return static_cast<bool>(file);
+}
+
+void WorldMap::SetCell(const int x, const int y, const std::uint8_t value)
+{
+    const MapEdit edit{x, y, value};
+    ApplyEdits(&edit, 1);
+}
+
+MapRegion WorldMap::ApplyEdits(const MapEdit *edits, const int count)
+{
+    MapRegion region{0, 0, -1, -1};
+    m_openedCells.clear();
+    m_closedCells.clear();
+
+    for (int i{0}; i < count; i++) {
+        const MapEdit &edit = edits[i];
+
+        if (!IsInside(edit.x, edit.y) || m_cells[edit.x * m_stride + edit.y] == edit.value) {
+            continue;
+        }
+
+        std::uint8_t &cell = m_cells[edit.x * m_stride + edit.y];
+        const bool wasWall = cell != 0;
+        cell = edit.value;
+
+        if (region.maxX < region.minX) {
+            region = {edit.x, edit.y, edit.x, edit.y};
+        } else {
+            region = {std::min(region.minX, edit.x), std::min(region.minY, edit.y),
+                      std::max(region.maxX, edit.x), std::max(region.maxY, edit.y)};
+        }
+
+        // A cell can change more than once in a batch, so each list is
+        // checked against the cell's final value below
+        const int index = (edit.x + BORDER) * m_stride + edit.y + BORDER;
+        if (wasWall != (edit.value != 0)) {
+            (wasWall ? m_openedCells : m_closedCells).push_back(index);
+        }
+    }
+
+    if (region.maxX < region.minX) {
+        return region;
+    }
+
+    m_version++;
+
+    if (m_distances) {
+        UpdateDistances(m_openedCells, m_closedCells);
+    }
+
+    return region;
+}
+
+void WorldMap::BuildDistanceField()
+{
+    if (!m_cells) {
+        return;
+    }
+
+    const std::size_t blockSize = GetBlockSize(m_columns, m_rows);
+    std::uint8_t *distances = AllocateBlock(m_distanceStorage, blockSize);
+    const std::uint8_t *cells = m_cells - (BORDER * m_stride + BORDER);
+    const int stride = m_stride;
+    const int MAX_DISTANCE = std::numeric_limits<std::uint8_t>::max();
+
+    for (std::size_t i{0}; i < blockSize; i++) {
+        distances[i] = cells[i] ? 0 : MAX_DISTANCE;
+    }
+
+    // Two-pass chamfer transform with unit steps to all 8 neighbours, which
+    // is exact for chessboard distance. The border is all walls, so every
+    // map cell has its neighbours in the block.
+    for (int x{BORDER}; x < m_columns + BORDER; x++) {
+        for (int y{BORDER}; y < m_rows + BORDER; y++) {
+            std::uint8_t *cell = distances + x * stride + y;
+            const int nearest = std::min({cell[-stride - 1], cell[-stride], cell[-stride + 1], cell[-1]});
+            *cell = std::min<int>(*cell, nearest + 1);
+        }
+    }
+
+    for (int x{m_columns + BORDER - 1}; x >= BORDER; x--) {
+        for (int y{m_rows + BORDER - 1}; y >= BORDER; y--) {
+            std::uint8_t *cell = distances + x * stride + y;
+            const int nearest = std::min({cell[stride + 1], cell[stride], cell[stride - 1], cell[1]});
+            *cell = std::min<int>(*cell, nearest + 1);
+        }
+    }
+
+    m_distances = distances + BORDER * stride + BORDER;
+}
+
+// Walls that open can only raise distances, and only of cells whose nearest
+// wall they were. Along the shortest path from a wall, distances go up by
+// exactly one a step, so following those steps out from the opened cells
+// finds every such cell. Their distances are reset, then lowered again from
+// their neighbours and from the closed cells in order of distance, which
+// stops wherever a distance no longer changes.
+void WorldMap::UpdateDistances(const std::vector<int> &opened, const std::vector<int> &closed)
+{
+    const int MAX_DISTANCE = std::numeric_limits<std::uint8_t>::max();
+    const int stride = m_stride;
+    const int neighbours[8] = {-stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1};
+    const std::uint8_t *cells = m_cells - (BORDER * stride + BORDER);
+    std::uint8_t *distances = m_distances - (BORDER * stride + BORDER);
+
+    m_distanceBuckets.resize(MAX_DISTANCE);
+    m_raisedCells.clear();
+
+    // Raised cells are marked with 0, which no open cell is otherwise, and
+    // carry their old distance in the queue
+    for (const int index : opened) {
+        if (!cells[index] && distances[index] == 0) {
+            m_raisedCells.push_back({index, 0});
+        }
+    }
+
+    for (std::size_t i{0}; i < m_raisedCells.size(); i++) {
+        const int index = m_raisedCells[i].first;
+        const int next = m_raisedCells[i].second + 1;
+
+        for (const int offset : neighbours) {
+            const int neighbour = index + offset;
+
+            if (!cells[neighbour] && distances[neighbour] == next) {
+                m_raisedCells.push_back({neighbour, next});
+                distances[neighbour] = 0;
+            }
+        }
+    }
+
+    for (const int index : closed) {
+        if (cells[index] && distances[index]) {
+            distances[index] = 0;
+            m_distanceBuckets[0].push_back(index);
+        }
+    }
+
+    for (const auto &raised : m_raisedCells) {
+        distances[raised.first] = MAX_DISTANCE;
+    }
+
+    for (const auto &raised : m_raisedCells) {
+        int nearest{MAX_DISTANCE};
+
+        for (const int offset : neighbours) {
+            nearest = std::min(nearest, distances[raised.first + offset] + 1);
+        }
+
+        distances[raised.first] = nearest;
+        if (nearest < MAX_DISTANCE) {
+            m_distanceBuckets[nearest].push_back(raised.first);
+        }
+    }
+
+    // Cells are taken in order of distance, so each is final when taken;
+    // entries left behind by a later lowering are skipped
+    for (int distance{0}; distance < MAX_DISTANCE; distance++) {
+        std::vector<int> &bucket = m_distanceBuckets[distance];
+
+        for (std::size_t i{0}; i < bucket.size(); i++) {
+            const int index = bucket[i];
+            if (distances[index] != distance) {
+                continue;
+            }
+
+            for (const int offset : neighbours) {
+                const int neighbour = index + offset;
+
+                if (!cells[neighbour] && distances[neighbour] > distance + 1) {
+                    distances[neighbour] = distance + 1;
+                    if (distance + 1 < MAX_DISTANCE) {
+                        m_distanceBuckets[distance + 1].push_back(neighbour);
+                    }
+                }
+            }
+        }
+
+        bucket.clear();
+    }
+}
+
+void WorldMap::ClearDistanceField() noexcept
+{
+    m_distances = nullptr;
+    m_distanceStorage.clear();
+}
+
+void WorldMap::Release() noexcept
+{
+    #ifdef RAYCASTER_MMAP
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+    #endif
+
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+    m_storage.clear();
+    m_distances = nullptr;
+    m_distanceStorage.clear();
+    m_cells = nullptr;
+    m_columns = m_rows = m_stride = 0;
+}
+
+void WorldMap::Adopt(std::uint8_t *block, const int columns, const int rows)
+{
+    m_columns = columns;
+    m_rows = rows;
+    m_stride = rows + 2 * BORDER;
+    m_cells = block + BORDER * m_stride + BORDER;
+}
+
+std::uint8_t* WorldMap::AllocateBlock(std::vector<std::uint8_t> &storage, const std::size_t size)
+{
+    storage.assign(size + BLOCK_ALIGNMENT - 1, 0);
+
+    // A vector only guarantees the alignment of new
+    const std::size_t misalignment = reinterpret_cast<std::uintptr_t>(storage.data()) % BLOCK_ALIGNMENT;
+    return storage.data() + (misalignment ? BLOCK_ALIGNMENT - misalignment : 0);
+}
+
+std::size_t WorldMap::GetBlockSize(const int columns, const int rows) noexcept
+{
+    const std::size_t cells = static_cast<std::size_t>(columns + 2 * BORDER) * (rows + 2 * BORDER);
+
+    // Room for a 4-byte read at the last cell, rounded to whole cache lines
+    return (cells + 3 + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+bool WorldMap::HasClosedBorder(const std::uint8_t *block, const int columns, const int rows) noexcept
+{
+    const int stride = rows + 2 * BORDER;
+    const auto isOpen = [](const std::uint8_t cell) { return cell == 0; };
+
+    if (std::any_of(block, block + BORDER * stride, isOpen) ||
+        std::any_of(block + (columns + BORDER) * stride, block + (columns + 2 * BORDER) * stride, isOpen)) {
+        return false;
+    }
+
+    for (int x{BORDER}; x < columns + BORDER; x++) {
+        if (std::any_of(block + x * stride, block + x * stride + BORDER, isOpen) ||
+            std::any_of(block + x * stride + rows + BORDER, block + (x + 1) * stride, isOpen)) {
+            return false;
+        }
+    }
+
+    return true;
+}
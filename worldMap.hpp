@@ -0,0 +1,145 @@
+#ifndef WORLD_MAP_HPP
+#define WORLD_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rayCast.hpp"
+
+namespace Raycaster
+{
+    struct MapEdit {
+        int x;
+        int y;
+        std::uint8_t value;
+    };
+
+    // Inclusive range of cells; empty when maxX < minX
+    struct MapRegion {
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    // Grid of map cells: 0 is open space, anything else is the wall type.
+    //
+    // Cells are bytes stored column by column in a single 64-byte aligned
+    // block, with a border of walls around the map. A ray cast from inside
+    // the map always stops in the border, so the DDA loop needs no bounds
+    // check per step.
+    //
+    // Binary maps are memory-mapped: the file holds the block exactly as it
+    // is laid out in memory, after a 64-byte header. All header fields are
+    // 32-bit little-endian:
+    //
+    //     0   magic "RCMP"
+    //     4   version (1)
+    //     8   columns
+    //     12  rows
+    //     16  border
+    //     20  stride (rows + 2 * border)
+    //     24  offset of the cell block (64)
+    //     28  size of the cell block in bytes
+    //
+    // Text maps start with the number of columns and rows, followed by one
+    // line of rows cell values per column.
+    class WorldMap
+    {
+    public:
+        WorldMap();
+        ~WorldMap();
+
+        WorldMap(const WorldMap&) = delete;
+        WorldMap& operator=(const WorldMap&) = delete;
+        WorldMap(WorldMap &&other) noexcept;
+        WorldMap& operator=(WorldMap &&other) noexcept;
+
+        // Replaces the map with an open area enclosed by the border
+        void Create(const int columns, const int rows);
+        // Replaces the map with a copy of other held in memory, distance
+        // field included
+        void CopyFrom(const WorldMap &other);
+
+        // Loads a binary map if the file starts with the binary magic,
+        // otherwise a text map. The map is unchanged if loading fails.
+        bool Load(const std::string &path);
+        bool LoadBinary(const std::string &path);
+        bool LoadText(const std::string &path);
+        bool SaveBinary(const std::string &path) const;
+
+        int GetColumns() const noexcept { return m_columns; }
+        int GetRows() const noexcept { return m_rows; }
+        bool IsMapped() const noexcept { return m_mapping != nullptr; }
+
+        bool IsInside(const int x, const int y) const noexcept { return x >= 0 && y >= 0 && x < m_columns && y < m_rows; }
+
+        // Cells outside the map read as BORDER_CELL
+        int GetCell(const int x, const int y) const noexcept { return IsInside(x, y) ? m_cells[x * m_stride + y] : BORDER_CELL; }
+        // Ignored outside the map
+        void SetCell(const int x, const int y, const std::uint8_t value);
+        // Sets cells in order, skipping those outside the map, and updates
+        // the distance field around the cells that changed. Returns the
+        // region of changed cells.
+        MapRegion ApplyEdits(const MapEdit *edits, const int count);
+        // Counts the calls to ApplyEdits() and SetCell() that changed a cell
+        std::uint64_t GetVersion() const noexcept { return m_version; }
+
+        // Chessboard distance field used by the cast kernels to skip open
+        // space (see MapView). Edits update it in place, touching only the
+        // cells whose distance changes.
+        void BuildDistanceField();
+        void ClearDistanceField() noexcept;
+        bool HasDistanceField() const noexcept { return m_distances != nullptr; }
+        int GetDistance(const int x, const int y) const noexcept { return (IsInside(x, y) && m_distances) ? m_distances[x * m_stride + y] : 0; }
+
+        MapView GetView() const noexcept { return {m_cells, m_columns, m_rows, m_stride, BORDER, m_distances}; }
+
+        static const int BORDER{1};
+        static const std::uint8_t BORDER_CELL{1};
+
+    private:
+        void Release() noexcept;
+        void Adopt(std::uint8_t *block, const int columns, const int rows);
+
+        // Sizes storage for a cell block and returns its aligned start
+        static std::uint8_t* AllocateBlock(std::vector<std::uint8_t> &storage, const std::size_t size);
+        // Bytes in the cell block of a map, including the border and the
+        // slack that lets vector kernels read whole words at the last cell
+        static std::size_t GetBlockSize(const int columns, const int rows) noexcept;
+        static bool HasClosedBorder(const std::uint8_t *block, const int columns, const int rows) noexcept;
+        // Brings the distance field up to date after the cells at the given
+        // block indices changed between wall and open
+        void UpdateDistances(const std::vector<int> &opened, const std::vector<int> &closed);
+
+        // Points at cell (0, 0), inside the border
+        std::uint8_t *m_cells;
+        int m_columns;
+        int m_rows;
+        int m_stride;
+
+        // Backing for maps built in memory, over-allocated for alignment
+        std::vector<std::uint8_t> m_storage;
+
+        // Laid out like m_cells, or null
+        std::uint8_t *m_distances;
+        std::vector<std::uint8_t> m_distanceStorage;
+
+        // Backing for memory-mapped maps
+        void *m_mapping;
+        std::size_t m_mappingSize;
+
+        std::uint64_t m_version;
+
+        // Scratch for ApplyEdits(), kept to save allocating for every edit
+        std::vector<int> m_openedCells;
+        std::vector<int> m_closedCells;
+        std::vector<std::pair<int, int>> m_raisedCells;
+        std::vector<std::vector<int>> m_distanceBuckets;
+    };
+}
+
+#endif // WORLD_MAP_HPP